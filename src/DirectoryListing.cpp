@@ -0,0 +1,226 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "DirectoryListing.h"
+
+// Std
+#include <algorithm>
+
+// Qt
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QHash>
+
+using namespace Konsole;
+
+// changed() is emitted at most once in this many milliseconds, as a
+// directory being written to, e.g. by a build, changes all the time
+static const int CHANGE_INTERVAL = 250;
+
+namespace Konsole {
+// The listings in use, by canonical path, and the watcher which tells them
+// that their directory changed.
+class DirectoryListingCache
+{
+public:
+    DirectoryListingCache() :
+        _watcher(nullptr)
+    {
+    }
+
+    ~DirectoryListingCache()
+    {
+        destroyWatcher();
+    }
+
+    // returns the watcher, which is created on first use, or nullptr if
+    // there is no application to watch in
+    QFileSystemWatcher *watcher();
+    // destroys the watcher, which must not outlive the application; the
+    // listings are then read every time
+    void destroyWatcher();
+
+    QHash<QString, QWeakPointer<DirectoryListing>> listings;
+
+private:
+    QFileSystemWatcher *_watcher;
+};
+}
+
+Q_GLOBAL_STATIC(DirectoryListingCache, theDirectoryListingCache)
+
+static void destroyDirectoryWatcher()
+{
+    if (!theDirectoryListingCache.isDestroyed()) {
+        theDirectoryListingCache->destroyWatcher();
+    }
+}
+
+QFileSystemWatcher *DirectoryListingCache::watcher()
+{
+    if (_watcher != nullptr || QCoreApplication::instance() == nullptr) {
+        return _watcher;
+    }
+
+    _watcher = new QFileSystemWatcher();
+    QObject::connect(_watcher, &QFileSystemWatcher::directoryChanged, [this](const QString &path) {
+        DirectoryListing *listing = listings.value(path).data();
+        if (listing != nullptr) {
+            listing->_outdated = true;
+            // the path is no longer watched once the directory is gone
+            listing->_watched = _watcher->directories().contains(path);
+            listing->notifyChanged();
+        }
+    });
+    qAddPostRoutine(destroyDirectoryWatcher);
+    return _watcher;
+}
+
+void DirectoryListingCache::destroyWatcher()
+{
+    if (_watcher == nullptr) {
+        return;
+    }
+
+    delete _watcher;
+    _watcher = nullptr;
+    for (const auto &weakListing : qAsConst(listings)) {
+        const QSharedPointer<DirectoryListing> listing = weakListing.toStrongRef();
+        if (!listing.isNull()) {
+            listing->_watched = false;
+            listing->_outdated = true;
+        }
+    }
+}
+
+QSharedPointer<DirectoryListing> DirectoryListing::forDirectory(const QString &path)
+{
+    const QString canonicalPath = QDir(path).canonicalPath();
+
+    QSharedPointer<DirectoryListing> listing = theDirectoryListingCache->listings.value(canonicalPath).toStrongRef();
+    if (listing.isNull()) {
+        listing.reset(new DirectoryListing(canonicalPath));
+        theDirectoryListingCache->listings.insert(canonicalPath, listing);
+    }
+    return listing;
+}
+
+DirectoryListing::DirectoryListing(const QString &canonicalPath) :
+    QObject(),
+    _canonicalPath(canonicalPath),
+    _entries(QStringList()),
+    _outdated(true),
+    _watched(false),
+    _changeTimer(),
+    _changePending(false)
+{
+    _changeTimer.setSingleShot(true);
+    _changeTimer.setInterval(CHANGE_INTERVAL);
+    connect(&_changeTimer, &QTimer::timeout, this, [this]() {
+        if (_changePending) {
+            _changePending = false;
+            notifyChanged();
+        }
+    });
+}
+
+DirectoryListing::~DirectoryListing()
+{
+    if (theDirectoryListingCache.isDestroyed()) {
+        return;
+    }
+
+    theDirectoryListingCache->listings.remove(_canonicalPath);
+    if (_watched) {
+        theDirectoryListingCache->watcher()->removePath(_canonicalPath);
+    }
+}
+
+void DirectoryListing::notifyChanged()
+{
+    // the changes during the interval are reported at its end
+    if (_changeTimer.isActive()) {
+        _changePending = true;
+        return;
+    }
+    emit changed();
+    _changeTimer.start();
+}
+
+QString DirectoryListing::path() const
+{
+    return _canonicalPath + QLatin1Char('/');
+}
+
+void DirectoryListing::update()
+{
+    if (!_outdated) {
+        return;
+    }
+
+    // watch before reading, so that no change goes unnoticed; if watching
+    // fails, for instance because the inotify limit was reached, the
+    // directory is read every time, as without the cache
+    if (!_watched && !_canonicalPath.isEmpty()) {
+        QFileSystemWatcher *watcher = theDirectoryListingCache->watcher();
+        _watched = watcher != nullptr && watcher->addPath(_canonicalPath);
+    }
+    _outdated = !_watched;
+
+    // a directory which does not exist has no canonical path
+    if (_canonicalPath.isEmpty()) {
+        _entries.clear();
+        return;
+    }
+
+    _entries = QDir(_canonicalPath).entryList(QDir::Dirs | QDir::Files, QDir::Unsorted);
+    std::sort(_entries.begin(), _entries.end());
+}
+
+bool DirectoryListing::containsPrefixOf(const QString &text)
+{
+    update();
+
+    // look for each prefix of the text in turn; once no entry starts with a
+    // prefix, none can be equal to a longer one
+    for (int length = 1; length <= text.size(); length++) {
+        const QStringRef prefix = text.leftRef(length);
+        const auto it = std::lower_bound(_entries.cbegin(), _entries.cend(), prefix,
+                                         [](const QString &entry, const QStringRef &prefix) {
+            return entry < prefix;
+        });
+        if (it == _entries.cend() || !it->startsWith(prefix)) {
+            return false;
+        }
+        if (it->size() == length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QStringList DirectoryListing::entries()
+{
+    update();
+    return _entries;
+}
@@ -0,0 +1,101 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef DIRECTORYLISTING_H
+#define DIRECTORYLISTING_H
+
+// Qt
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+/**
+ * The entries of a directory, as used by FileFilter to recognize file names.
+ *
+ * Listings are cached and shared between all sessions in the same directory.
+ * The directory is watched for changes (with inotify on Linux) and only read
+ * again after it has changed, so processing filters does not list it each
+ * time.  The entries are kept sorted, which makes finding those which a text
+ * starts with a matter of a few binary searches, even in directories with
+ * tens of thousands of entries.
+ *
+ * Listings are only used from the GUI thread.
+ */
+class KONSOLEPRIVATE_EXPORT DirectoryListing : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Returns the listing of the directory at @p path, which is shared for as
+     * long as someone holds on to it.
+     */
+    static QSharedPointer<DirectoryListing> forDirectory(const QString &path);
+
+    ~DirectoryListing() override;
+
+    /** Returns the canonical path of the directory, with a trailing '/' */
+    QString path() const;
+
+    /** Returns true if @p text starts with the name of one of the entries */
+    bool containsPrefixOf(const QString &text);
+
+    /** Returns the names of the entries, including "." and "..", in sorted order */
+    QStringList entries();
+
+Q_SIGNALS:
+    /**
+     * Emitted when an entry was added to, removed from or renamed in the
+     * directory, at most every 250 milliseconds.  It is not emitted if the
+     * directory cannot be watched.
+     */
+    void changed();
+
+private:
+    explicit DirectoryListing(const QString &canonicalPath);
+    Q_DISABLE_COPY(DirectoryListing)
+
+    // reads the directory again if it changed since the last time
+    void update();
+    // emits changed(), or has it emitted once the current interval is over
+    void notifyChanged();
+
+    friend class DirectoryListingCache;
+
+    QString _canonicalPath;
+    QStringList _entries;
+    // set when the directory changed, and always if it could not be watched
+    bool _outdated;
+    bool _watched;
+    // running for the interval after changed() was emitted
+    QTimer _changeTimer;
+    // whether the directory changed again during the interval
+    bool _changePending;
+};
+}
+
+#endif // DIRECTORYLISTING_H
@@ -1584,9 +1584,13 @@ void EditProfileDialog::setupScrollingPage(const Profile::Ptr &profile)
 
     setupRadio(pageamounts, scrollFullPage);
 
+    _scrollingUi->historyIndexButton->setChecked(profile->property<bool>(Profile::HistoryIndexEnabled));
+
     // signals and slots
     connect(_scrollingUi->historySizeWidget, &Konsole::HistorySizeWidget::historySizeChanged, this,
             &Konsole::EditProfileDialog::historySizeChanged);
+    connect(_scrollingUi->historyIndexButton, &QCheckBox::toggled, this,
+            &Konsole::EditProfileDialog::toggleHistoryIndex);
 }
 
 void EditProfileDialog::historySizeChanged(int lineCount)
@@ -1599,6 +1603,11 @@ void EditProfileDialog::historyModeChanged(Enum::HistoryModeEnum mode)
     updateTempProfileProperty(Profile::HistoryMode, mode);
 }
 
+void EditProfileDialog::toggleHistoryIndex(bool enable)
+{
+    updateTempProfileProperty(Profile::HistoryIndexEnabled, enable);
+}
+
 void EditProfileDialog::scrollFullPage()
 {
     updateTempProfileProperty(Profile::ScrollFullPage, Enum::ScrollPageFull);
@@ -173,6 +173,7 @@ private Q_SLOTS:
     void historyModeChanged(Enum::HistoryModeEnum mode);
 
     void historySizeChanged(int);
+    void toggleHistoryIndex(bool enable);
 
     void scrollFullPage();
     void scrollHalfPage();
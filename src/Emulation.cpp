@@ -24,35 +24,75 @@
 
 // Qt
 #include <QKeyEvent>
+#include <QMutexLocker>
+#include <QThread>
 
 // Konsole
+#include "EmulationScheduler.h"
 #include "KeyboardTranslator.h"
 #include "KeyboardTranslatorManager.h"
 #include "Screen.h"
 #include "ScreenWindow.h"
+#include "Tracer.h"
+#include "konsoleperformance.h"
 
 using namespace Konsole;
 
+// refresh interval of a 60Hz screen, used until the views tell otherwise
+static const int DEFAULT_FRAME_INTERVAL = 16;
+
+// upper bound on how long a frame may be held back, in case the
+// program never ends it (e.g. because it was killed mid-frame)
+static const int DEFAULT_SYNCHRONIZED_UPDATE_TIMEOUT = 150;
+
 Emulation::Emulation() :
     _windows(QList<ScreenWindow *>()),
+    _mutex(QMutex::Recursive),
     _currentScreen(nullptr),
     _codec(nullptr),
     _decoder(nullptr),
+    _utf8Decoder(Utf8Decoder()),
+    _useUtf8Decoder(false),
+    _decodedText(QVector<uint>()),
     _keyTranslator(nullptr),
     _usesMouseTracking(false),
     _bracketedPasteMode(false),
+    _readOnly(false),
+    _tracer(nullptr),
     _bulkTimer1(new QTimer(this)),
     _bulkTimer2(new QTimer(this)),
-    _imageSizeInitialized(false)
+    _imageSizeInitialized(false),
+    _synchronizedUpdate(false),
+    _synchronizedUpdateTimeout(DEFAULT_SYNCHRONIZED_UPDATE_TIMEOUT),
+    _framePolicy(NormalPolicy),
+    _minimumFrameInterval(DEFAULT_FRAME_INTERVAL),
+    _frameInterval(2 * DEFAULT_FRAME_INTERVAL),
+    _frameCost(0),
+    _floodMode(false),
+    _inputBytes(0)
 {
     // create screens with a default size
     _screen[0] = new Screen(40, 80);
     _screen[1] = new Screen(40, 80);
     _currentScreen = _screen[0];
 
+    // lines of the history which were shown blank while being read from
+    // a file are shown once they are there
+    for (Screen *screen : _screen) {
+        screen->setHistoryLoadedCallback([this]() { bufferedUpdate(); });
+    }
+
+    _bulkTimer1.setSingleShot(true);
+    _bulkTimer2.setSingleShot(true);
     QObject::connect(&_bulkTimer1, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
     QObject::connect(&_bulkTimer2, &QTimer::timeout, this, &Konsole::Emulation::showBulk);
 
+    _synchronizedUpdateTimer.setSingleShot(true);
+    QObject::connect(&_synchronizedUpdateTimer, &QTimer::timeout, this, &Konsole::Emulation::synchronizedUpdateTimedOut);
+
+    // emitted while output is processed, and queued to the views
+    qRegisterMetaType<Enum::CursorShapeEnum>("Enum::CursorShapeEnum");
+
     // listen for mouse status changes
     connect(this, &Konsole::Emulation::programRequestsMouseTracking, this,
             &Konsole::Emulation::setUsesMouseTracking);
@@ -82,7 +122,10 @@ void Emulation::bracketedPasteModeChanged(bool bracketedPasteMode)
 
 ScreenWindow *Emulation::createWindow()
 {
+    QMutexLocker locker(&_mutex);
+
     auto window = new ScreenWindow(_currentScreen);
+    window->setMutex(&_mutex);
     _windows << window;
 
     connect(window, &Konsole::ScreenWindow::selectionChanged, this,
@@ -103,12 +146,17 @@ void Emulation::checkScreenInUse()
 
 void Emulation::checkSelectedText()
 {
+    QMutexLocker locker(&_mutex);
     QString text = _currentScreen->selectedText(Screen::PreserveLineBreaks);
     emit selectionChanged(text);
 }
 
 Emulation::~Emulation()
 {
+    if (EmulationScheduler::instance() != nullptr) {
+        EmulationScheduler::instance()->cancel(this);
+    }
+
     for (ScreenWindow *window : qAsConst(_windows)) {
         delete window;
     }
@@ -135,11 +183,13 @@ void Emulation::setScreen(int index)
 
 void Emulation::clearHistory()
 {
+    QMutexLocker locker(&_mutex);
     _screen[0]->setScroll(_screen[0]->getScroll(), false);
 }
 
 void Emulation::setHistory(const HistoryType &history)
 {
+    QMutexLocker locker(&_mutex);
     _screen[0]->setScroll(history);
 
     showBulk();
@@ -147,16 +197,32 @@ void Emulation::setHistory(const HistoryType &history)
 
 const HistoryType &Emulation::history() const
 {
+    QMutexLocker locker(&_mutex);
     return _screen[0]->getScroll();
 }
 
+void Emulation::setHistoryIndexEnabled(bool enabled)
+{
+    QMutexLocker locker(&_mutex);
+    _screen[0]->setHistoryIndexEnabled(enabled);
+}
+
+bool Emulation::historyIndexEnabled() const
+{
+    QMutexLocker locker(&_mutex);
+    return _screen[0]->historyIndex() != nullptr;
+}
+
 void Emulation::setCodec(const QTextCodec *codec)
 {
+    QMutexLocker locker(&_mutex);
     if (codec != nullptr) {
         _codec = codec;
 
         delete _decoder;
         _decoder = _codec->makeDecoder();
+        _utf8Decoder.reset();
+        _useUtf8Decoder = utf8();
 
         emit useUtf8Request(utf8());
     } else {
@@ -164,6 +230,19 @@ void Emulation::setCodec(const QTextCodec *codec)
     }
 }
 
+const QTextCodec *Emulation::codec() const
+{
+    QMutexLocker locker(&_mutex);
+    return _codec;
+}
+
+bool Emulation::utf8() const
+{
+    QMutexLocker locker(&_mutex);
+    Q_ASSERT(_codec);
+    return _codec->mibEnum() == 106;
+}
+
 void Emulation::setCodec(EmulationCodec codec)
 {
     if (codec == Utf8Codec) {
@@ -234,13 +313,27 @@ void Emulation::sendMouseEvent(int /*buttons*/, int /*column*/, int /*row*/, int
 
 void Emulation::receiveData(const char *text, int length)
 {
-    bufferedUpdate();
+    QMutexLocker locker(&_mutex);
 
-    QVector<uint> unicodeText = _decoder->toUnicode(text, length).toUcs4();
+    if (_tracer != nullptr && _tracer->isActive()) {
+        _tracer->addCount(Tracer::ReceivedBytesCounter, length);
+    }
+
+    {
+        TraceScope trace(_tracer, Tracer::DecodeStage);
+        if (_useUtf8Decoder) {
+            _utf8Decoder.decode(text, length, _decodedText);
+        } else {
+            _decodedText = _decoder->toUnicode(text, length).toUcs4();
+        }
+    }
 
     //send characters to terminal emulator
-    for (auto &&i : unicodeText) {
-        receiveChar(i);
+    {
+        TraceScope trace(_tracer, Tracer::ParseStage);
+        for (const uint c : qAsConst(_decodedText)) {
+            receiveChar(c);
+        }
     }
 
     //look for z-modem indicator
@@ -257,43 +350,256 @@ void Emulation::receiveData(const char *text, int length)
             }
         }
     }
+
+    locker.unlock();
+
+    // after the output is processed, so that the views cannot pick up
+    // the screen image before it
+    runInOwnThread([this, length]() {
+        updateInputRate(length);
+        bufferedUpdate();
+    });
 }
 
 void Emulation::writeToStream(TerminalCharacterDecoder *decoder, int startLine, int endLine)
 {
+    QMutexLocker locker(&_mutex);
     _currentScreen->writeLinesToStream(decoder, startLine, endLine);
 }
 
 int Emulation::lineCount() const
 {
+    QMutexLocker locker(&_mutex);
     // sum number of lines currently on _screen plus number of lines in history
     return _currentScreen->getLines() + _currentScreen->getHistLines();
 }
 
 void Emulation::showBulk()
 {
+    // the views copy the screen image while they are notified
+    QMutexLocker locker(&_mutex);
+
+    // If the idle timer is still running when the views are updated, output
+    // kept arriving until the frame deadline passed, i.e. the program is
+    // producing output continuously.
+    const bool streaming = _bulkTimer1.isActive();
+
     _bulkTimer1.stop();
     _bulkTimer2.stop();
 
+    // the views are brought up to date once the synchronized update ends
+    if (_synchronizedUpdate) {
+        return;
+    }
+
+    // the output has stopped, leave flood mode before the views are
+    // updated so that they do their full update now
+    if (_floodMode && !streaming) {
+        setFloodMode(false);
+    }
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
     emit outputChanged();
 
     _currentScreen->resetScrolledLines();
     _currentScreen->resetDroppedLines();
+
+    updateFramePacing(streaming, frameTimer.nsecsElapsed() / 1000);
 }
 
 void Emulation::bufferedUpdate()
 {
-    static const int BULK_TIMEOUT1 = 10;
-    static const int BULK_TIMEOUT2 = 40;
+    if (QThread::currentThread() != thread()) {
+        runInOwnThread([this]() { bufferedUpdate(); });
+        return;
+    }
+
+    // output arriving this soon after the user typed something is most
+    // likely the echo of, or the response to, that input
+    static const int INPUT_RESPONSE_TIME = 100;
+    // time to wait for more output before updating the views
+    static const int IDLE_TIMEOUT = 10;
+
+    if (_lastUserInput.isValid() && !_lastUserInput.hasExpired(INPUT_RESPONSE_TIME)) {
+        // Show the output as soon as the data which has already been read
+        // is processed, but not more often than the screen can display it.
+        const qint64 sinceLastFrame = _lastFrame.isValid() ? _lastFrame.elapsed() : _minimumFrameInterval;
+        _framePolicy = InteractivePolicy;
+        _bulkTimer1.start(static_cast<int>(qMax<qint64>(0, _minimumFrameInterval - sinceLastFrame)));
+    } else {
+        _bulkTimer1.start(qMin(IDLE_TIMEOUT, _frameInterval));
+    }
 
-    _bulkTimer1.setSingleShot(true);
-    _bulkTimer1.start(BULK_TIMEOUT1);
     if (!_bulkTimer2.isActive()) {
-        _bulkTimer2.setSingleShot(true);
-        _bulkTimer2.start(BULK_TIMEOUT2);
+        _bulkTimer2.start(_frameInterval);
     }
 }
 
+void Emulation::updateFramePacing(bool streaming, qint64 frameTime)
+{
+    // continuous output for this long (in ms) switches to the throughput policy
+    static const int THROUGHPUT_THRESHOLD = 500;
+    // lowest update rate under the throughput policy
+    static const int MAXIMUM_FRAME_INTERVAL = 200;
+
+    // update rate while flooded
+    static const int FLOOD_FRAME_INTERVAL = 250;
+
+    static const char *const policyNames[] = { "interactive", "normal", "throughput", "flood" };
+    qCDebug(KonsolePerformance, "frame: policy %s, interval %d ms, update took %lld us",
+            policyNames[_framePolicy], _frameInterval, frameTime);
+
+    _lastFrame.start();
+    _frameCost = _frameCost == 0 ? frameTime : (3 * _frameCost + frameTime) / 4;
+
+    if (!streaming) {
+        _streamingSince.invalidate();
+        _framePolicy = NormalPolicy;
+        _frameInterval = 2 * _minimumFrameInterval;
+        return;
+    }
+
+    if (!_streamingSince.isValid()) {
+        _streamingSince.start();
+    }
+    if (_floodMode) {
+        _framePolicy = FloodPolicy;
+        _frameInterval = FLOOD_FRAME_INTERVAL;
+    } else if (_streamingSince.hasExpired(THROUGHPUT_THRESHOLD)) {
+        // Nobody can read output scrolling past at this rate.  Limit the
+        // time spent updating the views to about a quarter of the total so
+        // that most of it goes into processing the output.
+        _framePolicy = ThroughputPolicy;
+        const int costInterval = static_cast<int>(4 * _frameCost / 1000);
+        _frameInterval = qBound(2 * _minimumFrameInterval, costInterval, MAXIMUM_FRAME_INTERVAL);
+    } else {
+        _framePolicy = NormalPolicy;
+    }
+}
+
+void Emulation::updateInputRate(int length)
+{
+    // how often the input rate is measured, in ms
+    static const int INPUT_RATE_INTERVAL = 250;
+    // rate in bytes per second above which output is considered unreadable;
+    // 4 MiB/s is on the order of 50,000 lines per second
+    static const qint64 FLOOD_THRESHOLD = 4 * 1024 * 1024;
+
+    _inputBytes += length;
+    if (!_inputRateTimer.isValid()) {
+        _inputRateTimer.start();
+        return;
+    }
+
+    const qint64 elapsed = _inputRateTimer.elapsed();
+    if (elapsed < INPUT_RATE_INTERVAL) {
+        return;
+    }
+
+    const qint64 rate = _inputBytes * 1000 / elapsed;
+    if (!_floodMode && rate > FLOOD_THRESHOLD) {
+        setFloodMode(true);
+    } else if (_floodMode && rate < FLOOD_THRESHOLD / 2) {
+        // the output slowed down without stopping completely
+        setFloodMode(false);
+    }
+
+    _inputBytes = 0;
+    _inputRateTimer.start();
+}
+
+void Emulation::setFloodMode(bool flooding)
+{
+    _floodMode = flooding;
+    if (!flooding) {
+        _inputBytes = 0;
+        _inputRateTimer.invalidate();
+    }
+
+    qCDebug(KonsolePerformance) << (flooding ? "entering" : "leaving") << "flood mode";
+    emit floodModeChanged(flooding);
+}
+
+bool Emulation::floodMode() const
+{
+    return _floodMode;
+}
+
+void Emulation::setMinimumFrameInterval(int msecs)
+{
+    _minimumFrameInterval = qMax(1, msecs);
+    if (_framePolicy != ThroughputPolicy && _framePolicy != FloodPolicy) {
+        _frameInterval = 2 * _minimumFrameInterval;
+    }
+}
+
+void Emulation::setReadOnly(bool readOnly)
+{
+    _readOnly = readOnly;
+}
+
+bool Emulation::isReadOnly() const
+{
+    return _readOnly;
+}
+
+void Emulation::setTracer(Tracer *tracer)
+{
+    _tracer = tracer;
+}
+
+Tracer *Emulation::tracer() const
+{
+    return _tracer;
+}
+
+void Emulation::userInputSent()
+{
+    _lastUserInput.start();
+}
+
+void Emulation::setSynchronizedUpdateTimeout(int msec)
+{
+    _synchronizedUpdateTimeout = msec;
+}
+
+int Emulation::synchronizedUpdateTimeout() const
+{
+    return _synchronizedUpdateTimeout;
+}
+
+void Emulation::beginSynchronizedUpdate()
+{
+    _synchronizedUpdate = true;
+    runInOwnThread([this]() {
+        if (!_synchronizedUpdateTimer.isActive()) {
+            _synchronizedUpdateTimer.start(_synchronizedUpdateTimeout);
+        }
+    });
+}
+
+void Emulation::endSynchronizedUpdate()
+{
+    // the flag is cleared straight away, so that the update is shown even
+    // if the output goes on before the views get to it
+    const bool showUpdate = _synchronizedUpdate;
+    _synchronizedUpdate = false;
+
+    runInOwnThread([this, showUpdate]() {
+        _synchronizedUpdateTimer.stop();
+        if (showUpdate) {
+            showBulk();
+        }
+    });
+}
+
+void Emulation::synchronizedUpdateTimedOut()
+{
+    endSynchronizedUpdate();
+}
+
 char Emulation::eraseChar() const
 {
     return '\b';
@@ -305,6 +611,8 @@ void Emulation::setImageSize(int lines, int columns)
         return;
     }
 
+    QMutexLocker locker(&_mutex);
+
     QSize screenSize[2] = {
         QSize(_screen[0]->getColumns(),
               _screen[0]->getLines()),
@@ -313,30 +621,50 @@ void Emulation::setImageSize(int lines, int columns)
     };
     QSize newSize(columns, lines);
 
-    if (newSize == screenSize[0] && newSize == screenSize[1]) {
-        // If this method is called for the first time, always emit
-        // SIGNAL(imageSizeChange()), even if the new size is the same as the
-        // current size.  See #176902
-        if (!_imageSizeInitialized) {
-            emit imageSizeChanged(lines, columns);
-        }
-    } else {
+    const bool resized = newSize != screenSize[0] || newSize != screenSize[1];
+    if (resized) {
         _screen[0]->resizeImage(lines, columns);
         _screen[1]->resizeImage(lines, columns);
-
-        emit imageSizeChanged(lines, columns);
-
-        bufferedUpdate();
     }
 
-    if (!_imageSizeInitialized) {
-        _imageSizeInitialized = true;
+    const bool initialized = _imageSizeInitialized;
+    _imageSizeInitialized = true;
 
-        emit imageSizeInitialized();
-    }
+    // The output can resize the screens too, in a worker thread.  The
+    // session resizes the pty in response to the signals, which it has
+    // to do in its own thread.
+    runInOwnThread([this, lines, columns, resized, initialized]() {
+        // If this method is called for the first time, always emit
+        // SIGNAL(imageSizeChange()), even if the new size is the same as the
+        // current size.  See #176902
+        if (resized || !initialized) {
+            emit imageSizeChanged(lines, columns);
+        }
+        if (resized) {
+            bufferedUpdate();
+        }
+        if (!initialized) {
+            emit imageSizeInitialized();
+        }
+    });
 }
 
 QSize Emulation::imageSize() const
 {
+    QMutexLocker locker(&_mutex);
     return {_currentScreen->getColumns(), _currentScreen->getLines()};
 }
+
+QMutex *Emulation::mutex() const
+{
+    return &_mutex;
+}
+
+void Emulation::runInOwnThread(const std::function<void()> &function)
+{
+    if (QThread::currentThread() == thread()) {
+        function();
+    } else {
+        QMetaObject::invokeMethod(this, function, Qt::QueuedConnection);
+    }
+}
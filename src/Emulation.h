@@ -23,13 +23,20 @@
 #ifndef EMULATION_H
 #define EMULATION_H
 
+// Standard
+#include <functional>
+
 // Qt
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QSize>
 #include <QTextCodec>
 #include <QTimer>
 
 // Konsole
 #include "Enumeration.h"
+#include "ScreenWindow.h"
+#include "Utf8Decoder.h"
 #include "konsoleprivate_export.h"
 
 class QKeyEvent;
@@ -38,8 +45,8 @@ namespace Konsole {
 class KeyboardTranslator;
 class HistoryType;
 class Screen;
-class ScreenWindow;
 class TerminalCharacterDecoder;
+class Tracer;
 
 /**
  * Base class for terminal emulation back-ends.
@@ -82,6 +89,12 @@ class TerminalCharacterDecoder;
  * input received.  The emulation can be reset back to its starting state by calling
  * reset().
  *
+ * The output is usually processed in a worker thread, see EmulationScheduler.
+ * The screens are then guarded by mutex(), which receiveData() and the
+ * methods of the emulation and of its screen windows take.  The signals
+ * emitted while processing output are delivered to receivers in other
+ * threads through queued connections.
+ *
  * The emulation also maintains an activity state, which specifies whether
  * terminal is currently active ( when data is received ), normal
  * ( when the terminal is idle or receiving user input ) or trying
@@ -125,6 +138,13 @@ public:
     void setHistory(const HistoryType &);
     /** Returns the history store used by this emulation.  See setHistory() */
     const HistoryType &history() const;
+    /**
+     * Sets whether the lines moved into the history are indexed, which
+     * speeds up searching a long history.  See Screen::setHistoryIndexEnabled()
+     */
+    void setHistoryIndexEnabled(bool enabled);
+    /** Returns whether the lines moved into the history are indexed */
+    bool historyIndexEnabled() const;
     /** Clears the history scroll. */
     void clearHistory();
 
@@ -142,10 +162,7 @@ public:
     virtual void writeToStream(TerminalCharacterDecoder *decoder, int startLine, int endLine);
 
     /** Returns the codec used to decode incoming characters.  See setCodec() */
-    const QTextCodec *codec() const
-    {
-        return _codec;
-    }
+    const QTextCodec *codec() const;
 
     /** Sets the codec used to decode incoming characters.  */
     void setCodec(const QTextCodec *);
@@ -155,11 +172,7 @@ public:
      * Returns true if the current codec used to decode incoming
      * characters is UTF-8
      */
-    bool utf8() const
-    {
-        Q_ASSERT(_codec);
-        return _codec->mibEnum() == 106;
-    }
+    bool utf8() const;
 
     /** Returns the special character used for erasing character. */
     virtual char eraseChar() const;
@@ -197,6 +210,50 @@ public:
 
     bool programBracketedPasteMode() const;
 
+    /**
+     * Returns true while output is arriving too fast to be read.
+     * See floodModeChanged()
+     */
+    bool floodMode() const;
+
+    /**
+     * Sets the shortest time, in milliseconds, between two updates of the
+     * attached views.  This is normally the refresh interval of the screen
+     * the views are shown on; there is no point in updating them more often.
+     */
+    void setMinimumFrameInterval(int msecs);
+
+    /**
+     * Sets how long, in milliseconds, the updates of the views are held back
+     * at most when a program starts a synchronized update and never ends it.
+     * Defaults to 150ms.
+     */
+    void setSynchronizedUpdateTimeout(int msec);
+    /** Returns the timeout set with setSynchronizedUpdateTimeout() */
+    int synchronizedUpdateTimeout() const;
+
+    /**
+     * Sets whether the terminal is read-only.  Key presses are then no
+     * longer sent to the terminal program, but can still be used to
+     * scroll the views.
+     */
+    void setReadOnly(bool readOnly);
+    /** Returns true if the terminal is read-only.  See setReadOnly() */
+    bool isReadOnly() const;
+
+    /** Sets the tracer which times decoding and parsing the output */
+    void setTracer(Tracer *tracer);
+    /** Returns the tracer set with setTracer() */
+    Tracer *tracer() const;
+
+    /**
+     * Returns the mutex which guards the screens against the worker thread
+     * processing the output.  It is recursive, and has to be held by code
+     * which uses the screens directly rather than through the emulation or
+     * a ScreenWindow.
+     */
+    QMutex *mutex() const;
+
 public Q_SLOTS:
 
     /** Change the size of the emulation's image */
@@ -236,6 +293,9 @@ public Q_SLOTS:
      * to be emitted when it expires.  The timer allows multiple updates in quick
      * succession to be buffered into a single outputChanged() signal emission.
      *
+     * receiveData() may be called in any thread; it holds mutex() while it
+     * processes @p text, and starts the timer in the emulation's own thread.
+     *
      * @param text A string of characters received from the terminal program.
      * @param length The length of @p text
      */
@@ -316,6 +376,23 @@ Q_SIGNALS:
      */
     void outputChanged();
 
+    /**
+     * Emitted when the terminal starts or stops receiving output faster
+     * than anybody could read it.  While @p flooding is true the screen is
+     * updated at a low rate, and views should skip work which only matters
+     * to a reader, such as running filters.  When the output stops the
+     * signal is emitted with @p flooding set to false before the final
+     * outputChanged(), so that views can bring everything up to date.
+     */
+    void floodModeChanged(bool flooding);
+
+    /**
+     * Emitted when a key bound to one of the scrolling commands of the
+     * keyboard translator is pressed.  The view which currently has the
+     * focus should scroll by @p amount lines or pages.
+     */
+    void scrollViewRequest(ScreenWindow::RelativeScrollMode mode, int amount);
+
     /**
      * Emitted when the program running in the terminal wishes to update
      * certain session attributes. This allows terminal programs to customize
@@ -440,8 +517,46 @@ protected:
 
     void setCodec(EmulationCodec codec);
 
+    /**
+     * Calls @p function in the thread the emulation lives in, straight away
+     * if that is the calling thread and otherwise from its event loop.  The
+     * timers of the emulation can only be started and stopped there.
+     */
+    void runInOwnThread(const std::function<void()> &function);
+
+    /**
+     * Holds back updates of the attached views until endSynchronizedUpdate()
+     * is called, so that a program redrawing the screen in several writes
+     * is displayed in a single, complete frame.
+     *
+     * If the program does not end the update within a short time the held
+     * back output is shown anyway.
+     */
+    void beginSynchronizedUpdate();
+    /**
+     * Ends an update started with beginSynchronizedUpdate() and immediately
+     * sends the updated screen image to the attached views.
+     */
+    void endSynchronizedUpdate();
+    /**
+     * Called when a synchronized update was not ended within the timeout set
+     * with setSynchronizedUpdateTimeout().  The default implementation ends
+     * the update; emulations which track it as a terminal mode should also
+     * reset that mode, so that it is not reported as still being set.
+     */
+    virtual void synchronizedUpdateTimedOut();
+
+    /**
+     * Notes that input typed by the user has been sent to the terminal, so
+     * that the output which follows (usually its echo) is shown immediately
+     * instead of being batched up.
+     */
+    void userInputSent();
+
     QList<ScreenWindow *> _windows;
 
+    mutable QMutex _mutex;
+
     Screen *_currentScreen;  // pointer to the screen which is currently active,
     // this is one of the elements in the screen[] array
 
@@ -454,6 +569,12 @@ protected:
     //the current text codec.  (this allows for rendering of non-ASCII characters in text files etc.)
     const QTextCodec *_codec;
     QTextDecoder *_decoder;
+    // used instead of _decoder when the codec is UTF-8, which avoids
+    // building an intermediate QString for every block of input
+    Utf8Decoder _utf8Decoder;
+    bool _useUtf8Decoder;
+    // reused between calls to receiveData() to hold the decoded input
+    QVector<uint> _decodedText;
     const KeyboardTranslator *_keyTranslator; // the keyboard layout
 
 protected Q_SLOTS:
@@ -484,9 +605,52 @@ private:
 
     bool _usesMouseTracking;
     bool _bracketedPasteMode;
+    bool _readOnly;
+    Tracer *_tracer;
     QTimer _bulkTimer1;
     QTimer _bulkTimer2;
     bool _imageSizeInitialized;
+
+    // true while a synchronized update is in progress, see beginSynchronizedUpdate()
+    bool _synchronizedUpdate;
+    // ends a synchronized update which the program failed to end itself
+    QTimer _synchronizedUpdateTimer;
+    int _synchronizedUpdateTimeout;
+
+    // The way updates of the views are scheduled, see bufferedUpdate().
+    // Messages about the policy in use and the time spent on each update
+    // are logged to the org.kde.konsole.performance category.
+    enum FramePolicy {
+        // output follows user input and is shown as soon as it is processed
+        InteractivePolicy,
+        // output is batched up for a short time
+        NormalPolicy,
+        // the program writes output continuously, update at a reduced rate
+        ThroughputPolicy,
+        // output arrives faster than it can be read, see floodModeChanged()
+        FloodPolicy
+    };
+
+    void updateFramePacing(bool streaming, qint64 frameTime);
+    // measures the rate at which output arrives and enters flood mode
+    // when it is too high
+    void updateInputRate(int length);
+    void setFloodMode(bool flooding);
+
+    FramePolicy _framePolicy;
+    int _minimumFrameInterval;
+    // longest time output is held back before the views are updated
+    int _frameInterval;
+    // moving average of the time spent updating the views, in microseconds
+    qint64 _frameCost;
+    QElapsedTimer _lastUserInput;
+    QElapsedTimer _lastFrame;
+    QElapsedTimer _streamingSince;
+
+    bool _floodMode;
+    // bytes received since _inputRateTimer was started
+    qint64 _inputBytes;
+    QElapsedTimer _inputRateTimer;
 };
 }
 
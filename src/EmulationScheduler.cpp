@@ -0,0 +1,175 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "EmulationScheduler.h"
+
+// Qt
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+// Konsole
+#include "Emulation.h"
+
+using namespace Konsole;
+
+// amount of output processed in one go; small enough to let the other
+// emulations take turns often, large enough to keep the overhead of
+// doing so low
+static const int CHUNK_SIZE = 16 * 1024;
+
+class EmulationScheduler::ProcessTask : public QRunnable
+{
+public:
+    ProcessTask(EmulationScheduler *scheduler, Emulation *emulation, quint64 serial) :
+        _scheduler(scheduler),
+        _emulation(emulation),
+        _serial(serial)
+    {
+    }
+
+    void run() override
+    {
+        _scheduler->processChunk(_emulation, _serial);
+    }
+
+private:
+    EmulationScheduler *_scheduler;
+    Emulation *_emulation;
+    quint64 _serial;
+};
+
+EmulationScheduler::EmulationScheduler() :
+    _pendingData(QHash<Emulation *, PendingData>()),
+    _nextSerial(0)
+{
+    _pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+EmulationScheduler::~EmulationScheduler()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _pendingData.clear();
+    }
+    _pool.waitForDone();
+}
+
+Q_GLOBAL_STATIC(EmulationScheduler, theEmulationScheduler)
+EmulationScheduler *EmulationScheduler::instance()
+{
+    return theEmulationScheduler;
+}
+
+void EmulationScheduler::receiveData(Emulation *emulation, const char *data, int length)
+{
+    QMutexLocker locker(&_mutex);
+
+    auto iter = _pendingData.find(emulation);
+    if (iter != _pendingData.end()) {
+        // a worker takes care of it once the chunks before are processed
+        iter->data.append(data, length);
+        return;
+    }
+
+    const quint64 serial = _nextSerial++;
+    _pendingData.insert(emulation, PendingData{QByteArray(data, length), 0, serial, false});
+    _pool.start(new ProcessTask(this, emulation, serial));
+}
+
+int EmulationScheduler::pendingBytes(Emulation *emulation) const
+{
+    QMutexLocker locker(&_mutex);
+
+    const auto iter = _pendingData.constFind(emulation);
+    if (iter == _pendingData.constEnd()) {
+        return 0;
+    }
+    return iter->data.size() - iter->offset;
+}
+
+void EmulationScheduler::cancel(Emulation *emulation)
+{
+    QMutexLocker locker(&_mutex);
+
+    auto iter = _pendingData.find(emulation);
+    while (iter != _pendingData.end() && iter->processing) {
+        _chunkProcessed.wait(&_mutex);
+        iter = _pendingData.find(emulation);
+    }
+    if (iter != _pendingData.end()) {
+        // a task which is still queued finds nothing to do
+        _pendingData.erase(iter);
+    }
+}
+
+void EmulationScheduler::processChunk(Emulation *emulation, quint64 serial)
+{
+    QByteArray chunk;
+    {
+        QMutexLocker locker(&_mutex);
+
+        const auto iter = _pendingData.find(emulation);
+        if (iter == _pendingData.end() || iter->serial != serial) {
+            // cancelled
+            return;
+        }
+
+        const int count = qMin(CHUNK_SIZE, iter->data.size() - iter->offset);
+        chunk = iter->data.mid(iter->offset, count);
+        iter->offset += count;
+        iter->processing = true;
+
+        // drop the processed part now and then, as more output may be
+        // appended to the buffer before it ever runs empty
+        if (iter->offset * 2 > iter->data.size()) {
+            iter->data.remove(0, iter->offset);
+            iter->offset = 0;
+        }
+    }
+
+    emulation->receiveData(chunk.constData(), chunk.size());
+
+    int remaining = 0;
+    {
+        QMutexLocker locker(&_mutex);
+
+        // cancel() waits for the chunk, so the entry is only gone if the
+        // scheduler is being destroyed
+        const auto iter = _pendingData.find(emulation);
+        if (iter != _pendingData.end()) {
+            iter->processing = false;
+            remaining = iter->data.size() - iter->offset;
+            if (remaining > 0) {
+                // behind the other emulations which have output waiting
+                _pool.start(new ProcessTask(this, emulation, serial));
+            } else {
+                _pendingData.erase(iter);
+            }
+        }
+        _chunkProcessed.wakeAll();
+    }
+
+    QMetaObject::invokeMethod(this, [this, emulation, remaining]() {
+        emit dataProcessed(emulation, remaining);
+    }, Qt::QueuedConnection);
+}
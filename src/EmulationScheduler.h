@@ -0,0 +1,120 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef EMULATIONSCHEDULER_H
+#define EMULATIONSCHEDULER_H
+
+// Qt
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+class Emulation;
+
+/**
+ * Processes the output of the terminal programs on a pool of worker
+ * threads, one thread per processor core.
+ *
+ * The output of each emulation is queued and processed one chunk at a
+ * time.  A worker which finishes a chunk queues the emulation again behind
+ * the others which have output waiting, and idle workers take whichever
+ * emulation is next, so a session flooded with output cannot hold up the
+ * output of other sessions, nor keyboard input and painting in the GUI
+ * thread.
+ *
+ * Only one chunk of an emulation is processed at a time, so each
+ * emulation receives its output in the order in which it arrived.  While
+ * a chunk is processed the emulation's mutex() is held; the GUI thread
+ * takes it to copy the screen image for the views, and for everything
+ * else which reads or modifies the screens.  The signals the emulation
+ * emits while processing output, such as bell(), sessionAttributeChanged()
+ * and zmodemDownloadDetected(), are queued to the receivers in the GUI
+ * thread.
+ */
+class KONSOLEPRIVATE_EXPORT EmulationScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    EmulationScheduler();
+    ~EmulationScheduler() override;
+
+    /** Returns the scheduler shared by all emulations. */
+    static EmulationScheduler *instance();
+
+    /**
+     * Queues @p length bytes of @p data to be passed to
+     * Emulation::receiveData() of @p emulation in a worker thread.
+     */
+    void receiveData(Emulation *emulation, const char *data, int length);
+
+    /** Returns the number of bytes queued for @p emulation. */
+    int pendingBytes(Emulation *emulation) const;
+
+    /**
+     * Discards the output queued for @p emulation and waits until the
+     * chunk of it which is being processed, if any, is done.  Must be
+     * called before @p emulation is destroyed, without holding its mutex.
+     */
+    void cancel(Emulation *emulation);
+
+Q_SIGNALS:
+    /**
+     * Emitted in the GUI thread after a chunk of the output queued for
+     * @p emulation has been processed.  @p pendingBytes is the amount
+     * which was still queued at that point.
+     */
+    void dataProcessed(Konsole::Emulation *emulation, int pendingBytes);
+
+private:
+    class ProcessTask;
+
+    // processes the next chunk of the output queued for @p emulation, in a
+    // worker thread
+    void processChunk(Emulation *emulation, quint64 serial);
+
+    struct PendingData {
+        QByteArray data;
+        // position of the first byte which has not been processed yet
+        int offset;
+        // tells apart the output of emulations created at the same address
+        quint64 serial;
+        // true while a worker processes a chunk
+        bool processing;
+    };
+
+    mutable QMutex _mutex;
+    // woken when a worker is done with a chunk
+    QWaitCondition _chunkProcessed;
+    // emulations with output queued or being processed
+    QHash<Emulation *, PendingData> _pendingData;
+    quint64 _nextSerial;
+    QThreadPool _pool;
+};
+}
+
+#endif // EMULATIONSCHEDULER_H
@@ -24,11 +24,10 @@
 
 #include "konsoledebug.h"
 
-// Konsole
-#include "TerminalDisplay.h"
-#include "SessionManager.h"
-#include "Session.h"
-#include "Screen.h"
+// Qt
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QThread>
 
 using namespace Konsole;
 
@@ -52,6 +51,8 @@ ExtendedCharTable ExtendedCharTable::instance;
 
 uint ExtendedCharTable::createExtendedChar(const uint *unicodePoints, ushort length)
 {
+    QMutexLocker locker(&_mutex);
+
     // look for this sequence of points in the table
     uint hash = extendedCharHash(unicodePoints, length);
     const uint initialHash = hash;
@@ -69,23 +70,22 @@ uint ExtendedCharTable::createExtendedChar(const uint *unicodePoints, ushort len
         hash++;
 
         if (hash == initialHash) {
-            if (!triedCleaningSolution) {
+            if (!triedCleaningSolution && usedExtendedChars
+                && QThread::currentThread() == QCoreApplication::instance()->thread()) {
                 triedCleaningSolution = true;
                 // All the hashes are full, go to all Screens and try to free any
-                // This is slow but should happen very rarely
-                QSet<uint> usedExtendedChars;
-                const QList<Session *> sessionsList = SessionManager::instance()->sessions();
-                for (const Session *s : sessionsList) {
-                    const QList<TerminalDisplay *> displayList = s->views();
-                    for (const TerminalDisplay *display : displayList) {
-                        usedExtendedChars += display->screenWindow()->screen()->usedExtendedChars();
-                    }
-                }
+                // This is slow but should happen very rarely.  The screens are
+                // locked while they are searched, which must not happen with
+                // the table locked, as the threads processing output lock
+                // them the other way round.
+                locker.unlock();
+                const QSet<uint> usedChars = usedExtendedChars();
+                locker.relock();
 
                 QHash<uint, uint *>::iterator it = _extendedCharTable.begin();
                 QHash<uint, uint *>::iterator itEnd = _extendedCharTable.end();
                 while (it != itEnd) {
-                    if (usedExtendedChars.contains(it.key())) {
+                    if (usedChars.contains(it.key())) {
                         ++it;
                     } else {
                         it = _extendedCharTable.erase(it);
@@ -113,6 +113,8 @@ uint ExtendedCharTable::createExtendedChar(const uint *unicodePoints, ushort len
 
 uint *ExtendedCharTable::lookupExtendedChar(uint hash, ushort &length) const
 {
+    QMutexLocker locker(&_mutex);
+
     // look up index in table and if found, set the length
     // argument and return a pointer to the character sequence
 
@@ -125,6 +127,12 @@ uint *ExtendedCharTable::lookupExtendedChar(uint hash, ushort &length) const
     return nullptr;
 }
 
+int ExtendedCharTable::size() const
+{
+    QMutexLocker locker(&_mutex);
+    return _extendedCharTable.size();
+}
+
 uint ExtendedCharTable::extendedCharHash(const uint *unicodePoints, ushort length) const
 {
     uint hash = 0;
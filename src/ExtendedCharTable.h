@@ -22,8 +22,13 @@
 #ifndef EXTENDEDCHARTABLE_H
 #define EXTENDEDCHARTABLE_H
 
+// Std
+#include <functional>
+
 // Qt
 #include <QHash>
+#include <QMutex>
+#include <QSet>
 
 namespace Konsole {
 /**
@@ -31,6 +36,9 @@ namespace Konsole {
  * by hash keys.  The hash key itself is the same size as a unicode
  * character ( uint ) so that it can occupy the same space in
  * a structure.
+ *
+ * The table is shared by the screens of all sessions, whose output is
+ * processed in several threads, so it is guarded by a mutex.
  */
 class ExtendedCharTable
 {
@@ -63,6 +71,18 @@ public:
      */
     uint *lookupExtendedChar(uint hash, ushort &length) const;
 
+    /** Returns the number of character sequences in the table */
+    int size() const;
+
+    /**
+     * Returns the hash keys of all extended characters which are still in
+     * use.  When the table runs out of keys, the entries which are not in
+     * this set are removed.  Set by the owner of the terminal screens; if
+     * it is not set, no entries are ever removed.  Only called in the GUI
+     * thread, as it has to look at the screens of all sessions.
+     */
+    std::function<QSet<uint>()> usedExtendedChars;
+
     /** The global ExtendedCharTable instance. */
     static ExtendedCharTable instance;
 private:
@@ -75,6 +95,7 @@ private:
     // in each value is the length of the buffer, followed by the uints in the buffer
     // themselves.
     QHash<uint, uint *> _extendedCharTable;
+    mutable QMutex _mutex;
 };
 }
 #endif  // end of EXTENDEDCHARTABLE_H
@@ -22,15 +22,19 @@
 
 #include "konsoledebug.h"
 #include <algorithm>
+#include <climits>
 
 // Qt
 #include <QAction>
 #include <QApplication>
 #include <QClipboard>
-#include <QDir>
+#include <QHash>
 #include <QMimeDatabase>
+#include <QRunnable>
+#include <QVarLengthArray>
 #include <QString>
 #include <QTextStream>
+#include <QThreadPool>
 #include <QUrl>
 #include <QMenu>
 
@@ -42,11 +46,42 @@
 #include <KFileItemActions>
 
 // Konsole
+#include "DirectoryListing.h"
 #include "Session.h"
 #include "TerminalCharacterDecoder.h"
 
 using namespace Konsole;
 
+namespace Konsole {
+// Receives the results of a background search on the thread of the chain.
+// A running search keeps it alive, so it can outlive its chain, which
+// clears 'chain' when it is destroyed.
+class FilterSearchReceiver : public QObject
+{
+public:
+    TerminalImageFilterChain *chain = nullptr;
+};
+}
+
+namespace {
+class SearchTask : public QRunnable
+{
+public:
+    explicit SearchTask(std::function<void()> search) :
+        _search(std::move(search))
+    {
+    }
+
+    void run() override
+    {
+        _search();
+    }
+
+private:
+    std::function<void()> _search;
+};
+}
+
 FilterChain::~FilterChain()
 {
     qDeleteAll(_filters);
@@ -54,6 +89,9 @@ FilterChain::~FilterChain()
 
 void FilterChain::addFilter(Filter *filter)
 {
+    // hotspots the filter found before it was removed from the chain
+    // describe text which may have gone since
+    filter->setOutdated();
     _filters.append(filter);
 }
 
@@ -69,10 +107,10 @@ void FilterChain::reset()
     }
 }
 
-void FilterChain::setBuffer(const QString *buffer, const QList<int> *linePositions)
+void FilterChain::setBuffer(const QString *buffer, const Filter::LineColumns *lineColumns)
 {
     for(auto *filter : _filters) {
-        filter->setBuffer(buffer, linePositions);
+        filter->setBuffer(buffer, lineColumns);
     }
 }
 
@@ -80,9 +118,16 @@ void FilterChain::process()
 {
     for( auto *filter : _filters) {
         filter->process();
+        finishProcessing(filter);
     }
 }
 
+void FilterChain::finishProcessing(Filter *filter)
+{
+    filter->sortHotSpots();
+    filter->_outdated = false;
+}
+
 void FilterChain::clear()
 {
     _filters.clear();
@@ -108,13 +153,201 @@ QList<QSharedPointer<Filter::HotSpot>> FilterChain::hotSpots() const
     return list;
 }
 
+int FilterChain::hotSpotCount() const
+{
+    int count = 0;
+    for (const auto *filter : _filters) {
+        count += filter->hotSpots().size();
+    }
+    return count;
+}
+
+// a snapshot of what a background search looks for
+struct TerminalImageFilterChain::Search
+{
+    int generation;
+    QList<Filter *> filters;
+    // the regular expression of each filter, or an empty one for filters
+    // which are not RegExpFilters and are processed when the results arrive
+    QVector<RegExpFilter::Pattern> patterns;
+    QString text;
+    std::function<void(bool)> done;
+};
+
 TerminalImageFilterChain::TerminalImageFilterChain() :
     _buffer(nullptr),
-    _linePositions(nullptr)
+    _lineColumns(new Filter::LineColumns()),
+    _columns(0),
+    _generation(0),
+    _searching(false),
+    _receiver(new FilterSearchReceiver(), &QObject::deleteLater)
+{
+    _receiver->chain = this;
+}
+
+TerminalImageFilterChain::~TerminalImageFilterChain()
+{
+    _receiver->chain = nullptr;
+}
+
+void TerminalImageFilterChain::process()
+{
+    const Search search = currentSearch();
+    addMatches(search, RegExpFilter::findMatches(search.patterns, search.text));
+
+    // a search still running would add the same hotspots again
+    _generation++;
+}
+
+TerminalImageFilterChain::Search TerminalImageFilterChain::currentSearch() const
+{
+    Search search;
+    search.generation = _generation;
+    search.filters = _filters;
+    for (auto *filter : qAsConst(_filters)) {
+        const auto *regExpFilter = dynamic_cast<const RegExpFilter *>(filter);
+        if (regExpFilter != nullptr) {
+            search.patterns << RegExpFilter::Pattern{regExpFilter->regExp(), regExpFilter->anchors()};
+        } else {
+            search.patterns << RegExpFilter::Pattern{QRegularExpression(), QStringList()};
+        }
+    }
+    if (_buffer != nullptr) {
+        search.text = *_buffer;
+    }
+    return search;
+}
+
+void TerminalImageFilterChain::processInBackground(const std::function<void(bool)> &done)
+{
+    if (_searching) {
+        return;
+    }
+
+    Search search = currentSearch();
+    search.done = done;
+
+    // none of the lines changed, so there is nothing to search for
+    if (search.text.isEmpty()) {
+        searchFinished(search, QVector<QVector<RegExpFilter::Match>>(_filters.size()));
+        return;
+    }
+
+    _searching = true;
+    const QSharedPointer<FilterSearchReceiver> receiver = _receiver;
+    QThreadPool::globalInstance()->start(new SearchTask([receiver, search]() {
+        const QVector<QVector<RegExpFilter::Match>> matches =
+            RegExpFilter::findMatches(search.patterns, search.text);
+
+        QMetaObject::invokeMethod(receiver.data(), [receiver, search, matches]() {
+            if (receiver->chain != nullptr) {
+                receiver->chain->searchFinished(search, matches);
+            }
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void TerminalImageFilterChain::searchFinished(const Search &search,
+                                              const QVector<QVector<RegExpFilter::Match>> &matches)
+{
+    _searching = false;
+
+    // the positions found are only meaningful in the buffer they were
+    // found in, and for the regular expressions they were found for
+    bool current = search.generation == _generation && search.filters == _filters;
+    for (int i = 0; current && i < _filters.size(); i++) {
+        const auto *regExpFilter = dynamic_cast<const RegExpFilter *>(_filters.at(i));
+        current = regExpFilter == nullptr
+                  || (regExpFilter->regExp() == search.patterns.at(i).regExp
+                      && regExpFilter->anchors() == search.patterns.at(i).anchors);
+    }
+    if (!current) {
+        search.done(false);
+        return;
+    }
+
+    addMatches(search, matches);
+
+    search.done(true);
+}
+
+void TerminalImageFilterChain::addMatches(const Search &search,
+                                          const QVector<QVector<RegExpFilter::Match>> &matches)
 {
+    for (int i = 0; i < search.filters.size(); i++) {
+        auto *filter = search.filters.at(i);
+        auto *regExpFilter = dynamic_cast<RegExpFilter *>(filter);
+        if (regExpFilter != nullptr) {
+            regExpFilter->addMatches(matches.at(i));
+        } else {
+            filter->process();
+        }
+        finishProcessing(filter);
+    }
+    _unprocessedLines.fill(false);
+}
+
+// the parts of a character which decide the text the filters see
+static inline bool sameText(const Character &a, const Character &b)
+{
+    return a.character == b.character
+           && a.isRealCharacter == b.isRealCharacter
+           && (a.rendition & RE_EXTENDED_CHAR) == (b.rendition & RE_EXTENDED_CHAR);
+}
+
+static uint lineHash(const Character *line, int columns, LineProperty property)
+{
+    uint hash = property & LINE_WRAPPED;
+    for (int column = 0; column < columns; column++) {
+        const Character &ch = line[column];
+        hash = hash * 31 + ch.character;
+        hash = hash * 31 + ((ch.rendition & RE_EXTENDED_CHAR) != 0 ? 2 : 0) + (ch.isRealCharacter ? 1 : 0);
+    }
+    return hash;
+}
+
+// Returns how many lines the text moved down between two images, as the
+// shift under which most lines of the new image match those of the old one.
+// Ties go to the smallest shift, so that blank lines do not fake a scroll.
+static int findShift(const QVector<uint> &previous, const QVector<uint> &current)
+{
+    int bestShift = 0;
+    int bestMatches = -1;
+    const auto tryShift = [&](int shift) {
+        const int first = qMax(0, shift);
+        const int last = qMin(current.size(), previous.size() + shift);
+        if (last - first <= bestMatches) {
+            return;
+        }
+        int matches = 0;
+        for (int line = first; line < last; line++) {
+            if (current[line] == previous[line - shift]) {
+                matches++;
+            }
+        }
+        if (matches > bestMatches) {
+            bestShift = shift;
+            bestMatches = matches;
+        }
+    };
+
+    tryShift(0);
+    for (int distance = 1; distance < qMax(previous.size(), current.size()); distance++) {
+        tryShift(-distance);
+        tryShift(distance);
+    }
+    return bestShift;
 }
 
-TerminalImageFilterChain::~TerminalImageFilterChain() = default;
+void TerminalImageFilterChain::clearImage()
+{
+    reset();
+    _image.clear();
+    _lineProperties.clear();
+    _lineHashes.clear();
+    _unprocessedLines.clear();
+    _generation++;
+}
 
 void TerminalImageFilterChain::setImage(const Character * const image, int lines, int columns,
                                         const QVector<LineProperty> &lineProperties)
@@ -123,8 +356,118 @@ void TerminalImageFilterChain::setImage(const Character * const image, int lines
         return;
     }
 
-    // reset all filters and hotspots
-    reset();
+    const auto isWrapped = [&](int line) {
+        return (lineProperties.value(line, LINE_DEFAULT) & LINE_WRAPPED) != 0;
+    };
+
+    QVector<uint> lineHashes(lines);
+    for (int line = 0; line < lines; line++) {
+        lineHashes[line] = lineHash(image + line * columns, columns, lineProperties.value(line, LINE_DEFAULT));
+    }
+
+    // a filter which is outdated, e.g. because the directory listing of
+    // a FileFilter changed, examines all lines again on its own, while
+    // the other filters keep their hotspots
+    const bool updateAll = columns != _columns || _lineHashes.isEmpty();
+    bool anyOutdated = false;
+    for (const auto *filter : qAsConst(_filters)) {
+        anyOutdated = anyOutdated || filter->isOutdated();
+    }
+
+    _generation++;
+
+    QBitArray dirtyLines(lines, true);
+    if (updateAll) {
+        // reset all filters and hotspots
+        reset();
+    } else {
+        const int shift = findShift(_lineHashes, lineHashes);
+        for (int line = 0; line < lines; line++) {
+            const int previousLine = line - shift;
+            if (previousLine < 0 || previousLine >= _lineHashes.size()
+                || lineHashes[line] != _lineHashes[previousLine]
+                || isWrapped(line) != ((_lineProperties.value(previousLine, LINE_DEFAULT) & LINE_WRAPPED) != 0)) {
+                continue;
+            }
+            const Character *text = image + line * columns;
+            if (std::equal(text, text + columns, _image.constData() + previousLine * columns, sameText)) {
+                dirtyLines.clearBit(line);
+            }
+        }
+
+        // lines of the previous image whose results were thrown away
+        // still have to be processed
+        for (int previousLine = 0; previousLine < _unprocessedLines.size(); previousLine++) {
+            const int line = previousLine + shift;
+            if (_unprocessedLines.testBit(previousLine) && line >= 0 && line < lines) {
+                dirtyLines.setBit(line);
+            }
+        }
+
+        // a match may continue onto the next line when a line is wrapped,
+        // so a change anywhere on a wrapped line means examining all of it
+        // again.  The same goes for the lines of a hotspot which is dropped
+        // because part of it changed or scrolled away.
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int first = 0; first < lines;) {
+                int last = first;
+                while (last + 1 < lines && isWrapped(last)) {
+                    last++;
+                }
+                bool dirty = false;
+                for (int line = first; line <= last && !dirty; line++) {
+                    dirty = dirtyLines.testBit(line);
+                }
+                if (dirty) {
+                    dirtyLines.fill(true, first, last + 1);
+                }
+                first = last + 1;
+            }
+
+            for (const auto *filter : qAsConst(_filters)) {
+                for (const auto &spot : filter->hotSpots()) {
+                    const int first = qMax(0, spot->startLine() + shift);
+                    const int last = qMin(lines - 1, spot->endLine() + shift);
+                    bool dropped = first != spot->startLine() + shift || last != spot->endLine() + shift;
+                    bool kept = false;
+                    for (int line = first; line <= last; line++) {
+                        if (dirtyLines.testBit(line)) {
+                            dropped = true;
+                        } else {
+                            kept = true;
+                        }
+                    }
+                    if (dropped && kept) {
+                        dirtyLines.fill(true, first, last + 1);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (auto *filter : qAsConst(_filters)) {
+            if (filter->isOutdated()) {
+                filter->reset();
+            } else {
+                filter->retainHotSpots(shift, dirtyLines);
+            }
+        }
+    }
+
+    // the lines put into the buffer for the filters
+    QBitArray bufferedLines = dirtyLines;
+    if (anyOutdated) {
+        bufferedLines.fill(true);
+    }
+
+    _image.resize(lines * columns);
+    std::copy(image, image + lines * columns, _image.begin());
+    _lineProperties = lineProperties;
+    _lineHashes = lineHashes;
+    _columns = columns;
+    _unprocessedLines = bufferedLines;
 
     PlainTextDecoder decoder;
     decoder.setLeadingWhitespace(true);
@@ -132,15 +475,21 @@ void TerminalImageFilterChain::setImage(const Character * const image, int lines
 
     // setup new shared buffers for the filters to process on
     _buffer.reset(new QString());
-    _linePositions.reset(new QList<int>());
 
-    setBuffer(_buffer.get(), _linePositions.get());
+    setBuffer(_buffer.get(), _lineColumns.get());
 
     QTextStream lineStream(_buffer.get());
     decoder.begin(&lineStream);
 
+    // the lines which are in the buffer and where each of them starts
+    QVarLengthArray<int, 128> bufferLines;
+    QVarLengthArray<int, 128> linePositions;
     for (int i = 0; i < lines; i++) {
-        _linePositions->append(_buffer->length());
+        if (!bufferedLines.testBit(i)) {
+            continue;
+        }
+        bufferLines.append(i);
+        linePositions.append(_buffer->length());
         decoder.decodeLine(image + i * columns, columns, LINE_DEFAULT);
 
         // pretend that each line ends with a newline character.
@@ -153,16 +502,42 @@ void TerminalImageFilterChain::setImage(const Character * const image, int lines
         // TODO - Use the "line wrapped" attribute associated with lines in a
         // terminal image to avoid adding this imaginary character for wrapped
         // lines
-        if ((lineProperties.value(i, LINE_DEFAULT) & LINE_WRAPPED) == 0) {
+        if (!isWrapped(i)) {
             lineStream << QLatin1Char('\n');
         }
     }
     decoder.end();
+
+    // work out the line and column of every position once, rather than
+    // for each match the filters find.  The vector keeps its capacity, so
+    // this does not allocate unless the image has grown.
+    const QString &text = *_buffer;
+    _lineColumns->resize(bufferLines.isEmpty() ? 0 : text.length() + 1);
+    auto *lineColumn = _lineColumns->data();
+    for (int i = 0; i < bufferLines.size(); i++) {
+        const int end = i == bufferLines.size() - 1 ? text.length() + 1 : linePositions[i + 1];
+        int column = 0;
+        for (int position = linePositions[i]; position < end; position++) {
+            lineColumn[position] = std::make_pair(bufferLines[i], column);
+            if (position == text.length()) {
+                break;
+            }
+            const QChar ch = text.at(position);
+            if (ch.isHighSurrogate() && position + 1 < text.length() && text.at(position + 1).isLowSurrogate()) {
+                lineColumn[++position] = std::make_pair(bufferLines[i], column);
+                column += Character::width(QChar::surrogateToUcs4(ch, text.at(position)));
+            } else {
+                column += Character::width(ch.unicode());
+            }
+        }
+    }
 }
 
 Filter::Filter() :
-    _linePositions(nullptr),
-    _buffer(nullptr)
+    _lineColumns(nullptr),
+    _buffer(nullptr),
+    _retainedLines(),
+    _outdated(true)
 {
 }
 
@@ -173,32 +548,84 @@ Filter::~Filter()
 
 void Filter::reset()
 {
-    _hotspots.clear();
+    // QVector::clear() keeps the capacity of each line
+    for (auto &spans : _hotspotLines) {
+        spans.clear();
+    }
     _hotspotList.clear();
+    _retainedLines.clear();
+    _outdated = true;
 }
 
-void Filter::setBuffer(const QString *buffer, const QList<int> *linePositions)
+bool Filter::isOutdated() const
 {
-    _buffer = buffer;
-    _linePositions = linePositions;
+    return _outdated;
 }
 
-std::pair<int, int> Filter::getLineColumn(int position)
+void Filter::setOutdated()
 {
-    Q_ASSERT(_linePositions);
-    Q_ASSERT(_buffer);
+    _outdated = true;
+}
 
-    for (int i = 0; i < _linePositions->count(); i++) {
-        const int nextLine = i == _linePositions->count() - 1
-            ? _buffer->length() + 1
-            : _linePositions->value(i + 1);
+void Filter::retainHotSpots(int shift, const QBitArray &dirtyLines)
+{
+    const auto spots = _hotspotList;
 
-        if (_linePositions->value(i) <= position && position < nextLine) {
-            return std::make_pair(i,  Character::stringWidth(buffer()->mid(_linePositions->value(i),
-                                                     position - _linePositions->value(i))));
+    for (auto &spans : _hotspotLines) {
+        spans.clear();
+    }
+    _hotspotList.clear();
+
+    for (const auto &spot : spots) {
+        const int first = spot->startLine() + shift;
+        const int last = spot->endLine() + shift;
+        if (first < 0 || last >= dirtyLines.size()) {
+            continue;
         }
+        bool dirty = false;
+        for (int line = first; line <= last && !dirty; line++) {
+            dirty = dirtyLines.testBit(line);
+        }
+        if (!dirty) {
+            spot->moveBy(shift);
+            addHotSpot(spot);
+        }
+    }
+
+    _retainedLines = ~dirtyLines;
+}
+
+void Filter::sortHotSpots()
+{
+    const auto before = [](const QSharedPointer<HotSpot> &a, const QSharedPointer<HotSpot> &b) {
+        return a->startLine() < b->startLine()
+               || (a->startLine() == b->startLine() && a->startColumn() < b->startColumn());
+    };
+    if (std::is_sorted(_hotspotList.cbegin(), _hotspotList.cend(), before)) {
+        return;
+    }
+
+    std::stable_sort(_hotspotList.begin(), _hotspotList.end(), before);
+    for (auto &spans : _hotspotLines) {
+        spans.clear();
+    }
+    for (int index = 0; index < _hotspotList.size(); index++) {
+        indexHotSpot(index);
     }
-    return std::make_pair(-1, -1);
+}
+
+void Filter::setBuffer(const QString *buffer, const LineColumns *lineColumns)
+{
+    _buffer = buffer;
+    _lineColumns = lineColumns;
+}
+
+std::pair<int, int> Filter::getLineColumn(int position) const
+{
+    Q_ASSERT(_lineColumns);
+    Q_ASSERT(_buffer);
+
+    return _lineColumns->value(position, std::make_pair(-1, -1));
 }
 
 const QString *Filter::buffer()
@@ -210,31 +637,68 @@ Filter::HotSpot::~HotSpot() = default;
 
 void Filter::addHotSpot(QSharedPointer<HotSpot> spot)
 {
+    // when another filter of the chain has to examine all lines, the
+    // buffer also holds those whose hotspots were kept
+    if (spot->startLine() >= 0 && spot->startLine() < _retainedLines.size()
+        && _retainedLines.testBit(spot->startLine())) {
+        return;
+    }
     _hotspotList << spot;
+    indexHotSpot(_hotspotList.size() - 1);
+}
+
+void Filter::indexHotSpot(int index)
+{
+    const HotSpot *spot = _hotspotList.at(index).data();
+    if (spot->startLine() < 0) {
+        return;
+    }
+    if (spot->endLine() >= _hotspotLines.size()) {
+        _hotspotLines.resize(spot->endLine() + 1);
+    }
 
+    const auto startsBefore = [](const LineSpan &a, const LineSpan &b) {
+        return a.startColumn < b.startColumn;
+    };
     for (int line = spot->startLine(); line <= spot->endLine(); line++) {
-        _hotspots.insert(line, spot);
+        const LineSpan span = {
+            line == spot->startLine() ? spot->startColumn() : 0,
+            line == spot->endLine() ? spot->endColumn() : INT_MAX,
+            index
+        };
+        // filters find their matches from left to right, so this
+        // nearly always appends
+        auto &spans = _hotspotLines[line];
+        spans.insert(std::upper_bound(spans.begin(), spans.end(), span, startsBefore), span);
     }
 }
 
-QList<QSharedPointer<Filter::HotSpot>> Filter::hotSpots() const
+const QList<QSharedPointer<Filter::HotSpot>> &Filter::hotSpots() const
 {
     return _hotspotList;
 }
 
-QSharedPointer<Filter::HotSpot> Filter::hotSpotAt(int line, int column) const
+const QVector<Filter::LineSpan> &Filter::hotSpotsAtLine(int line) const
 {
-    const auto hotspots = _hotspots.values(line);
+    static const QVector<LineSpan> noSpans;
+    return line >= 0 && line < _hotspotLines.size() ? _hotspotLines.at(line) : noSpans;
+}
 
-    for (auto &spot : hotspots) {
-        if (spot->startLine() == line && spot->startColumn() > column) {
-            continue;
-        }
-        if (spot->endLine() == line && spot->endColumn() < column) {
-            continue;
+QSharedPointer<Filter::HotSpot> Filter::hotSpotAt(int line, int column) const
+{
+    const auto &spans = hotSpotsAtLine(line);
+
+    // the spans which start at or before the column are those in front
+    // of the first one which starts after it
+    auto it = std::upper_bound(spans.cbegin(), spans.cend(), column,
+                               [](int column, const LineSpan &span) {
+        return column < span.startColumn;
+    });
+    while (it != spans.cbegin()) {
+        --it;
+        if (it->endColumn >= column) {
+            return _hotspotList.at(it->index);
         }
-
-        return spot;
     }
 
     return nullptr;
@@ -289,6 +753,12 @@ void Filter::HotSpot::setType(Type type)
     _type = type;
 }
 
+void Filter::HotSpot::moveBy(int lines)
+{
+    _startLine += lines;
+    _endLine += lines;
+}
+
 RegExpFilter::RegExpFilter() :
     _searchText(QRegularExpression())
 {
@@ -313,6 +783,9 @@ QStringList RegExpFilter::HotSpot::capturedTexts() const
 
 void RegExpFilter::setRegExp(const QRegularExpression &regExp)
 {
+    if (regExp != _searchText) {
+        setOutdated();
+    }
     _searchText = regExp;
     _searchText.optimize();
 }
@@ -322,26 +795,177 @@ QRegularExpression RegExpFilter::regExp() const
     return _searchText;
 }
 
+void RegExpFilter::setAnchors(const QStringList &anchors)
+{
+    if (anchors != _anchors) {
+        setOutdated();
+    }
+    _anchors = anchors;
+}
+
+QStringList RegExpFilter::anchors() const
+{
+    return _anchors;
+}
+
 void RegExpFilter::process()
 {
     const QString *text = buffer();
 
     Q_ASSERT(text);
 
-    if (!_searchText.isValid() || _searchText.pattern().isEmpty()) {
-        return;
-    }
+    addMatches(findMatches(QVector<Pattern>{Pattern{_searchText, _anchors}}, *text).first());
+}
 
-    QRegularExpressionMatchIterator iterator(_searchText.globalMatch(*text));
+// appends the matches for regExp in the part of text from start to end
+static void appendMatches(const QRegularExpression &regExp, const QString &text, int start, int end,
+                          QVector<RegExpFilter::Match> &matches)
+{
+    QRegularExpressionMatchIterator iterator(regExp.globalMatch(text.midRef(start, end - start)));
     while (iterator.hasNext()) {
-        QRegularExpressionMatch match(iterator.next());
-        std::pair<int, int> start = getLineColumn(match.capturedStart());
-        std::pair<int, int> end = getLineColumn(match.capturedEnd());
+        const QRegularExpressionMatch match(iterator.next());
+        const RegExpFilter::Match found = {start + match.capturedStart(), start + match.capturedEnd(),
+                                           match.capturedTexts()};
+        matches.append(found);
+    }
+}
+
+QVector<RegExpFilter::Match> RegExpFilter::findMatches(const QRegularExpression &regExp, const QString &text)
+{
+    QVector<Match> matches;
+
+    // the text is empty when none of the lines changed since the last time
+    if (!regExp.isValid() || regExp.pattern().isEmpty() || text.isEmpty()) {
+        return matches;
+    }
+
+    appendMatches(regExp, text, 0, text.size(), matches);
+    return matches;
+}
+
+QVector<QVector<RegExpFilter::Match>> RegExpFilter::findMatches(const QVector<Pattern> &patterns,
+                                                                const QString &text)
+{
+    QVector<QVector<Match>> matches(patterns.size());
+    if (text.isEmpty()) {
+        return matches;
+    }
+
+    struct Anchor {
+        QString text;
+        Qt::CaseSensitivity caseSensitivity;
+        int pattern;
+    };
+    QVector<Anchor> anchors;
+    // the anchors which may start with each character, with a table for ASCII
+    QVector<QVector<int>> asciiAnchors(128);
+    QHash<ushort, QVector<int>> otherAnchors;
+
+    // the parts of the text to search for each pattern, as pairs of start and end
+    QVector<QVector<std::pair<int, int>>> ranges(patterns.size());
+
+    for (int i = 0; i < patterns.size(); i++) {
+        const Pattern &pattern = patterns.at(i);
+        if (!pattern.regExp.isValid() || pattern.regExp.pattern().isEmpty()) {
+            continue;
+        }
+        if (pattern.anchors.isEmpty()) {
+            ranges[i].append({0, text.size()});
+            continue;
+        }
+
+        const bool caseInsensitive = (pattern.regExp.patternOptions() & QRegularExpression::CaseInsensitiveOption) != 0;
+        for (const QString &anchor : pattern.anchors) {
+            if (anchor.isEmpty()) {
+                continue;
+            }
+            const int index = anchors.size();
+            anchors.append({anchor, caseInsensitive ? Qt::CaseInsensitive : Qt::CaseSensitive, i});
+
+            QVarLengthArray<ushort, 3> firstCharacters;
+            firstCharacters.append(anchor.at(0).unicode());
+            if (caseInsensitive) {
+                firstCharacters.append(anchor.at(0).toLower().unicode());
+                firstCharacters.append(anchor.at(0).toUpper().unicode());
+            }
+            for (int j = 0; j < firstCharacters.size(); j++) {
+                const ushort ch = firstCharacters.at(j);
+                QVector<int> &list = ch < 128 ? asciiAnchors[ch] : otherAnchors[ch];
+                if (!list.contains(index)) {
+                    list.append(index);
+                }
+            }
+        }
+    }
+
+    if (!anchors.isEmpty()) {
+        // whether an anchor of each pattern was found in the current line
+        QVarLengthArray<bool, 8> found(patterns.size());
+        std::fill(found.begin(), found.end(), false);
+
+        const int length = text.size();
+        int lineStart = 0;
+        for (int position = 0; position <= length; position++) {
+            if (position == length || text.at(position) == QLatin1Char('\n')) {
+                const int lineEnd = qMin(position + 1, length);
+                for (int i = 0; i < patterns.size(); i++) {
+                    if (!found[i]) {
+                        continue;
+                    }
+                    found[i] = false;
+                    // adjacent lines are searched together
+                    if (!ranges[i].isEmpty() && ranges[i].last().second == lineStart) {
+                        ranges[i].last().second = lineEnd;
+                    } else {
+                        ranges[i].append({lineStart, lineEnd});
+                    }
+                }
+                lineStart = lineEnd;
+                continue;
+            }
+
+            const ushort ch = text.at(position).unicode();
+            const QVector<int> *candidates = nullptr;
+            if (ch < 128) {
+                candidates = &asciiAnchors.at(ch);
+            } else if (!otherAnchors.isEmpty()) {
+                const auto it = otherAnchors.constFind(ch);
+                if (it != otherAnchors.constEnd()) {
+                    candidates = &it.value();
+                }
+            }
+            if (candidates == nullptr) {
+                continue;
+            }
+
+            for (const int index : *candidates) {
+                const Anchor &anchor = anchors.at(index);
+                if (!found[anchor.pattern]
+                    && text.midRef(position, anchor.text.size()).compare(anchor.text, anchor.caseSensitivity) == 0) {
+                    found[anchor.pattern] = true;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < patterns.size(); i++) {
+        for (const auto &range : ranges.at(i)) {
+            appendMatches(patterns.at(i).regExp, text, range.first, range.second, matches[i]);
+        }
+    }
+    return matches;
+}
+
+void RegExpFilter::addMatches(const QVector<Match> &matches)
+{
+    for (const Match &match : matches) {
+        std::pair<int, int> start = getLineColumn(match.start);
+        std::pair<int, int> end = getLineColumn(match.end);
 
         QSharedPointer<Filter::HotSpot> spot(
             newHotSpot(start.first, start.second,
                        end.first, end.second,
-                       match.capturedTexts()
+                       match.capturedTexts
             )
         );
 
@@ -433,6 +1057,8 @@ const QRegularExpression UrlFilter::CompleteUrlRegExp(QLatin1Char('(') + FullUrl
 UrlFilter::UrlFilter()
 {
     setRegExp(CompleteUrlRegExp);
+    // every link contains one of these, and neither links nor email addresses span lines
+    setAnchors({QStringLiteral("://"), QStringLiteral("www."), QStringLiteral("@")});
 }
 
 UrlFilter::HotSpot::~HotSpot() = default;
@@ -493,23 +1119,53 @@ QSharedPointer<Filter::HotSpot> FileFilter::newHotSpot(int startLine, int startC
     // Return nullptr if it's not:
     // <current dir>/filename
     // <current dir>/childDir/filename
-    auto match = std::find_if(std::begin(_currentDirContents), std::end(_currentDirContents),
-        [filename](const QString& s) { return filename.startsWith(s); });
-
-    if (match == std::end(_currentDirContents)) {
+    if (!_directory->containsPrefixOf(filename)) {
         return nullptr;
     }
 
-    return QSharedPointer<Filter::HotSpot>(new FileFilter::HotSpot(startLine, startColumn, endLine, endColumn, capturedTexts, _dirPath + filename));
+    return QSharedPointer<Filter::HotSpot>(new FileFilter::HotSpot(startLine, startColumn, endLine, endColumn, capturedTexts, _directory->path() + filename));
 }
 
-void FileFilter::process()
+void FileFilter::addMatches(const QVector<Match> &matches)
 {
-    const QDir dir(_session->currentWorkingDirectory());
-    _dirPath = dir.canonicalPath() + QLatin1Char('/');
-    _currentDirContents = dir.entryList(QDir::Dirs | QDir::Files);
+    // the listing is shared and kept up to date, so it only has to be
+    // looked up again when the session changes directory.  The hotspots
+    // kept on the lines which are not processed now are files in the
+    // previous directory.
+    const QString workingDirectory = _session->currentWorkingDirectory();
+    if (_directory.isNull() || workingDirectory != _workingDirectory) {
+        if (!_directory.isNull()) {
+            requestUpdate();
+        }
+        setDirectory(workingDirectory);
+    }
 
-    RegExpFilter::process();
+    RegExpFilter::addMatches(matches);
+}
+
+void FileFilter::setDirectory(const QString &workingDirectory)
+{
+    if (!_directory.isNull()) {
+        disconnect(_directory.data(), nullptr, this, nullptr);
+    }
+    _workingDirectory = workingDirectory;
+    _directory = DirectoryListing::forDirectory(workingDirectory);
+    connect(_directory.data(), &Konsole::DirectoryListing::changed, this, &Konsole::FileFilter::requestUpdate);
+}
+
+void FileFilter::requestUpdate()
+{
+    // the text may be being processed right now, which clears the flag
+    // once it is done, so the filter is only marked afterwards
+    if (_updateRequested) {
+        return;
+    }
+    _updateRequested = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        _updateRequested = false;
+        setOutdated();
+        emit outdated();
+    }, Qt::QueuedConnection);
 }
 
 FileFilter::HotSpot::HotSpot(int startLine, int startColumn, int endLine, int endColumn,
@@ -526,10 +1182,26 @@ void FileFilter::HotSpot::activate(QObject *)
 }
 
 FileFilter::FileFilter(Session *session) :
-    _session(session)
-    , _dirPath(QString())
-    , _currentDirContents(QStringList())
+    QObject()
+    , RegExpFilter()
+    , _session(session)
+    , _workingDirectory(QString())
+    , _directory(nullptr)
+    , _updateRequested(false)
 {
+    if (session != nullptr) {
+        // a directory reported by the shell takes precedence over the one
+        // of the process, so ask the session rather than using the signal's
+        connect(session, &Konsole::Session::currentDirectoryChanged, this, [this]() {
+            // nothing has been filtered yet if there is no listing
+            const QString workingDirectory = _session->currentWorkingDirectory();
+            if (!_directory.isNull() && workingDirectory != _workingDirectory) {
+                setDirectory(workingDirectory);
+                requestUpdate();
+            }
+        });
+    }
+
     static auto re = QRegularExpression(
         /* First part of the regexp means 'strings with spaces and starting with single quotes'
          * Second part means "Strings with double quotes"
@@ -21,26 +21,31 @@
 #define FILTER_H
 
 // Qt
+#include <QBitArray>
 #include <QList>
 #include <QSet>
 #include <QObject>
 #include <QPointer>
 #include <QStringList>
 #include <QRegularExpression>
-#include <QMultiHash>
+#include <QVector>
 
 // KDE
 #include <KFileItemActions>
 
+#include <functional>
 #include <memory>
 
 // Konsole
 #include "Character.h"
+#include "konsoleprivate_export.h"
 
 class QAction;
 class QMenu;
 
 namespace Konsole {
+class DirectoryListing;
+class FilterSearchReceiver;
 class Session;
 
 /**
@@ -61,7 +66,7 @@ class Session;
  * When processing the text they should create instances of Filter::HotSpot subclasses for sections of interest
  * and add them to the filter's list of hotspots using addHotSpot()
  */
-class Filter
+class KONSOLEPRIVATE_EXPORT Filter
 {
 public:
     /**
@@ -136,6 +141,11 @@ public:
         void setType(Type type);
 
     private:
+        friend class Filter;
+
+        // moves the hotspot down by @p lines, after the text scrolled
+        void moveBy(int lines);
+
         int _startLine;
         int _startColumn;
         int _endLine;
@@ -156,35 +166,92 @@ public:
      */
     void reset();
 
+    /**
+     * Returns true if the hotspots do not belong to the text last processed,
+     * because the filter was reset, has just been added to a chain or its
+     * settings have changed.  The whole text then has to be processed again.
+     */
+    bool isOutdated() const;
+
+    /**
+     * Keeps the hotspots which, once moved down by @p shift lines, lie
+     * entirely on lines which are not set in @p dirtyLines, and deletes the
+     * others.  process() then only needs to examine the dirty lines, and
+     * the hotspots it finds on the other lines are dropped, as they were
+     * kept already.
+     */
+    void retainHotSpots(int shift, const QBitArray &dirtyLines);
+
+    /**
+     * The part of a hotspot which lies on a single line.
+     *
+     * @p endColumn is inclusive, and is INT_MAX if the hotspot continues
+     * onto the next line.  @p index is the position of the hotspot in hotSpots().
+     */
+    struct LineSpan {
+        int startColumn;
+        int endColumn;
+        int index;
+    };
+
     /** Returns the hotspot which covers the given @p line and @p column, or 0 if no hotspot covers that area */
     QSharedPointer<HotSpot> hotSpotAt(int line, int column) const;
 
     /** Returns the list of hotspots identified by the filter */
-    QList<QSharedPointer<HotSpot>> hotSpots() const;
+    const QList<QSharedPointer<HotSpot>> &hotSpots() const;
 
-    /** Returns the list of hotspots identified by the filter which occur on a given line */
+    /**
+     * Returns the parts of the hotspots identified by the filter which occur on a given line,
+     * ordered by the column where they start on that line.
+     */
+    const QVector<LineSpan> &hotSpotsAtLine(int line) const;
 
     /**
-     * TODO: Document me
+     * The line and column of each position within a buffer, including the
+     * position just past its end.  Columns count wide characters twice.
      */
-    void setBuffer(const QString *buffer, const QList<int> *linePositions);
+    typedef QVector<std::pair<int, int>> LineColumns;
+
+    /**
+     * Sets the text for process() to examine.  @p lineColumns maps each
+     * position in @p buffer to its line and column in the terminal image.
+     */
+    void setBuffer(const QString *buffer, const LineColumns *lineColumns);
 
 protected:
     /** Adds a new hotspot to the list */
     void addHotSpot(QSharedPointer<HotSpot> spot);
+    /** Marks the hotspots as outdated after a change to the filter's settings */
+    void setOutdated();
     /** Returns the internal buffer */
     const QString *buffer();
-    /** Converts a character position within buffer() to a line and column */
-    std::pair<int,int> getLineColumn(int position);
+    /**
+     * Converts a character position within buffer() to a line and column,
+     * or (-1, -1) if the position is outside the buffer
+     */
+    std::pair<int,int> getLineColumn(int position) const;
 
 private:
     Q_DISABLE_COPY(Filter)
 
-    QMultiHash<int, QSharedPointer<HotSpot>> _hotspots;
+    friend class FilterChain;
+
+    // adds the hotspot at @p index in _hotspotList to _hotspotLines
+    void indexHotSpot(int index);
+    // restores the order of the hotspots after process() found new ones
+    // in between those kept by retainHotSpots()
+    void sortHotSpots();
+
+    // the hotspots on each line, kept between calls to reset() so that
+    // processing the next image does not have to allocate them again
+    QVector<QVector<LineSpan>> _hotspotLines;
     QList<QSharedPointer<HotSpot>> _hotspotList;
 
-    const QList<int> *_linePositions;
+    const LineColumns *_lineColumns;
     const QString *_buffer;
+    // the lines whose hotspots retainHotSpots() kept
+    QBitArray _retainedLines;
+    bool _outdated;
 };
 
 /**
@@ -194,7 +261,7 @@ private:
  * Subclasses can reimplement newHotSpot() to return custom hotspot types when matches for the regular expression
  * are found.
  */
-class RegExpFilter : public Filter
+class KONSOLEPRIVATE_EXPORT RegExpFilter : public Filter
 {
 public:
     /**
@@ -227,6 +294,16 @@ public:
     /** Returns the regular expression which the filter searches for in blocks of text */
     QRegularExpression regExp() const;
 
+    /**
+     * Sets literal strings one of which is part of every match for regExp(), such as
+     * "://" for links.  Lines of text which contain none of them are not searched, so
+     * the matches of a filter with anchors must not span lines.  Anchors are compared
+     * case insensitively if the regular expression is.
+     */
+    void setAnchors(const QStringList &anchors);
+    /** Returns the anchors set with setAnchors() */
+    QStringList anchors() const;
+
     /**
      * Reimplemented to search the filter's text buffer for text matching regExp()
      *
@@ -235,6 +312,37 @@ public:
      */
     void process() override;
 
+    /** A match for a regular expression, as found by findMatches() */
+    struct Match {
+        int start;
+        int end;
+        QStringList capturedTexts;
+    };
+
+    /**
+     * Returns the matches for @p regExp in @p text, the search process() makes.
+     * This only reads its arguments, so it can run on another thread with
+     * copies of the regular expression and the buffer.
+     */
+    static QVector<Match> findMatches(const QRegularExpression &regExp, const QString &text);
+
+    /** A regular expression to search for with findMatches() and its anchors() */
+    struct Pattern {
+        QRegularExpression regExp;
+        QStringList anchors;
+    };
+
+    /**
+     * Returns the matches for each of @p patterns in @p text.  The anchors of all
+     * patterns are looked for in a single scan of the text, after which each regular
+     * expression only runs over the lines containing one of its anchors, or over all
+     * of the text if it has none.  Adding a pattern with rare anchors costs little.
+     */
+    static QVector<QVector<Match>> findMatches(const QVector<Pattern> &patterns, const QString &text);
+
+    /** Adds hotspots for @p matches, which were found in buffer() by findMatches() */
+    virtual void addMatches(const QVector<Match> &matches);
+
 protected:
     /**
      * Called when a match for the regular expression is encountered.  Subclasses should reimplement this
@@ -245,10 +353,11 @@ protected:
 
 private:
     QRegularExpression _searchText;
+    QStringList _anchors;
 };
 
 /** A filter which matches URLs in blocks of text */
-class UrlFilter : public RegExpFilter
+class KONSOLEPRIVATE_EXPORT UrlFilter : public RegExpFilter
 {
 public:
     /**
@@ -296,8 +405,10 @@ private:
  * A filter which matches files according to POSIX Portable Filename Character Set
  * https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap03.html#tag_03_267
  */
-class FileFilter : public RegExpFilter
+class KONSOLEPRIVATE_EXPORT FileFilter : public QObject, public RegExpFilter
 {
+    Q_OBJECT
+
 public:
     /**
      * Hotspot type created by FileFilter instances.
@@ -323,15 +434,32 @@ public:
 
     explicit FileFilter(Session *session);
 
-    void process() override;
+    /** Reimplemented to list the session's current directory before adding hotspots for @p matches */
+    void addMatches(const QVector<Match> &matches) override;
+
+Q_SIGNALS:
+    /**
+     * Emitted when the session changed directory or an entry was added to or
+     * removed from its directory.  The filter has been marked as outdated,
+     * as its hotspots may no longer be files, and the whole text has to be
+     * processed again.
+     */
+    void outdated();
 
 protected:
     QSharedPointer<Filter::HotSpot> newHotSpot(int, int, int, int, const QStringList &) override;
 
 private:
+    void setDirectory(const QString &workingDirectory);
+    // marks the filter as outdated and emits outdated() once control
+    // returns to the event loop
+    void requestUpdate();
+
     QPointer<Session> _session;
-    QString _dirPath;
-    QStringList _currentDirContents;
+    // the session's working directory when the matches were last added
+    QString _workingDirectory;
+    QSharedPointer<DirectoryListing> _directory;
+    bool _updateRequested;
 };
 
 /**
@@ -348,10 +476,10 @@ private:
  *
  * The hotSpotAt() method will return the first hotspot which covers a given position.
  *
- * The hotSpots() method return all of the hotspots in the text and on
- * a given line respectively.
+ * The hotSpots() method return all of the hotspots in the text and
+ * visitHotSpotsAtLine() those on a given line.
  */
-class FilterChain
+class KONSOLEPRIVATE_EXPORT FilterChain
 {
 public:
     virtual ~FilterChain();
@@ -368,26 +496,73 @@ public:
     /**
      * Processes each filter in the chain
      */
-    void process();
+    virtual void process();
 
     /** Sets the buffer for each filter in the chain to process. */
-    void setBuffer(const QString *buffer, const QList<int> *linePositions);
+    void setBuffer(const QString *buffer, const Filter::LineColumns *lineColumns);
 
     /** Returns the first hotspot which occurs at @p line, @p column or 0 if no hotspot was found */
     QSharedPointer<Filter::HotSpot> hotSpotAt(int line, int column) const;
     /** Returns a list of all the hotspots in all the chain's filters */
     QList<QSharedPointer<Filter::HotSpot>> hotSpots() const;
+    /** Returns the number of hotspots in all the chain's filters */
+    int hotSpotCount() const;
+
+    /**
+     * Calls @p visitor with each hotspot which occurs on @p line and its
+     * position in hotSpots(), without building the list of all hotspots.
+     */
+    template<typename Visitor>
+    void visitHotSpotsAtLine(int line, Visitor visitor) const
+    {
+        int offset = 0;
+        for (const Filter *filter : _filters) {
+            const auto &spots = filter->hotSpots();
+            for (const Filter::LineSpan &span : filter->hotSpotsAtLine(line)) {
+                visitor(spots.at(span.index), offset + span.index);
+            }
+            offset += spots.size();
+        }
+    }
 protected:
+    // puts the hotspots of a filter in order once it has processed the buffer
+    static void finishProcessing(Filter *filter);
+
     QList<Filter *> _filters;
 };
 
-/** A filter chain which processes character images from terminal displays */
-class TerminalImageFilterChain : public FilterChain
+/**
+ * A filter chain which processes character images from terminal displays.
+ *
+ * The chain remembers the text of the last image.  setImage() compares the
+ * next image with it, and the filters only process the lines which changed;
+ * the hotspots on other lines are kept, and moved if the text scrolled.
+ */
+class KONSOLEPRIVATE_EXPORT TerminalImageFilterChain : public FilterChain
 {
 public:
     TerminalImageFilterChain();
     ~TerminalImageFilterChain() override;
 
+    /**
+     * Reimplemented to search for the regular expressions of all RegExpFilters
+     * together, see RegExpFilter::findMatches()
+     */
+    void process() override;
+
+    /**
+     * Processes each filter in the chain like process(), except that the
+     * regular expressions of RegExpFilters are searched for on a worker
+     * thread, in a copy of the text.
+     *
+     * @p done is called on this thread once the hotspots have been updated.
+     * It is passed false instead if the results were thrown away because
+     * setImage() was called or the filters changed in the meantime; the
+     * image then needs processing again.  Calls made while a search is
+     * running are ignored, as its results are bound to be thrown away.
+     */
+    void processInBackground(const std::function<void(bool)> &done);
+
     /**
      * Set the current terminal image to @p image.
      *
@@ -399,13 +574,38 @@ public:
     void setImage(const Character * const image, int lines, int columns,
                   const QVector<LineProperty> &lineProperties);
 
+    /**
+     * Removes all hotspots and forgets the image last set, so that the next
+     * call to setImage() processes all of it.  The results of a search which
+     * is still running are thrown away.
+     */
+    void clearImage();
+
 private:
     Q_DISABLE_COPY(TerminalImageFilterChain)
 
 /* usually QStrings and QLists are not supposed to be in the heap, here we have a problem:
     we need a shared memory space between many filter objeccts, defined by this TerminalImage. */
     std::unique_ptr<QString> _buffer;
-    std::unique_ptr<QList<int>> _linePositions;
+    std::unique_ptr<Filter::LineColumns> _lineColumns;
+
+    struct Search;
+    Search currentSearch() const;
+    void addMatches(const Search &search, const QVector<QVector<RegExpFilter::Match>> &matches);
+    void searchFinished(const Search &search, const QVector<QVector<RegExpFilter::Match>> &matches);
+
+    // the text of the image last set, to find the lines which have changed
+    QVector<Character> _image;
+    QVector<LineProperty> _lineProperties;
+    QVector<uint> _lineHashes;
+    int _columns;
+
+    // the lines in the buffer which have not been processed yet
+    QBitArray _unprocessedLines;
+    // incremented by each call to setImage(), to recognize stale results
+    int _generation;
+    bool _searching;
+    QSharedPointer<FilterSearchReceiver> _receiver;
 };
 }
 #endif //FILTER_H
@@ -0,0 +1,161 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "GlyphCache.h"
+
+// Qt
+#include <QFontMetrics>
+#include <QPainter>
+
+using namespace Konsole;
+
+// the cache is emptied when it grows beyond this many glyphs, which only
+// happens with text in many different colors
+static const int MAXIMUM_GLYPHS = 8192;
+
+namespace Konsole {
+uint qHash(const GlyphCache::Key &key, uint seed)
+{
+    return ::qHash(key.character, seed) ^ ::qHash(key.foreground, seed)
+           ^ ::qHash(key.background ^ (static_cast<uint>(key.variant) << 24), seed);
+}
+}
+
+GlyphCache::GlyphCache() :
+    _glyphs(),
+    _wideGlyphs(),
+    _cellWidth(1),
+    _cellHeight(1),
+    _baseline(0),
+    _antialias(true),
+    _devicePixelRatio(1.0),
+    _nullImage()
+{
+}
+
+void GlyphCache::setCellSize(int cellWidth, int cellHeight, int baseline)
+{
+    _cellWidth = cellWidth;
+    _cellHeight = cellHeight;
+    _baseline = baseline;
+    clear();
+}
+
+void GlyphCache::setAntialias(bool antialias)
+{
+    if (antialias != _antialias) {
+        _antialias = antialias;
+        clear();
+    }
+}
+
+void GlyphCache::clear()
+{
+    _glyphs.clear();
+    _wideGlyphs.clear();
+}
+
+int GlyphCache::size() const
+{
+    return _glyphs.size();
+}
+
+bool GlyphCache::isCacheable(uint character)
+{
+    if (character < 0x20) {
+        return false;
+    }
+    if (character <= 0x7e) {
+        return true;
+    }
+    if (character > 0xFFFF) {
+        return false;
+    }
+
+    // scripts which are drawn one glyph per character, without any shaping
+    const QChar::Category category = QChar::category(character);
+    if (category == QChar::Mark_NonSpacing || category == QChar::Mark_SpacingCombining
+        || category == QChar::Mark_Enclosing || category == QChar::Other_Format) {
+        return false;
+    }
+    switch (QChar::script(character)) {
+    case QChar::Script_Common:
+    case QChar::Script_Latin:
+    case QChar::Script_Greek:
+    case QChar::Script_Cyrillic:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const QImage &GlyphCache::glyph(uint character, const QFont &font, int variant, QRgb foreground, QRgb background,
+                                qreal devicePixelRatio)
+{
+    if (devicePixelRatio != _devicePixelRatio) {
+        _devicePixelRatio = devicePixelRatio;
+        clear();
+    }
+
+    if (!isCacheable(character)) {
+        return _nullImage;
+    }
+
+    const Key key = {character, variant, foreground, background};
+    auto it = _glyphs.constFind(key);
+    if (it != _glyphs.constEnd()) {
+        return it.value();
+    }
+
+    // glyphs reaching into the neighbouring cell, such as wide forms of
+    // ambiguous width characters, are left to drawText() so they are not cut off
+    const quint64 wideKey = (static_cast<quint64>(variant) << 32) | character;
+    if (_wideGlyphs.contains(wideKey)) {
+        return _nullImage;
+    }
+    if (QFontMetrics(font).horizontalAdvance(QString::fromUcs4(&character, 1)) > _cellWidth) {
+        _wideGlyphs.insert(wideKey);
+        return _nullImage;
+    }
+
+    if (_glyphs.size() >= MAXIMUM_GLYPHS) {
+        _glyphs.clear();
+    }
+    return _glyphs.insert(key, rasterize(character, font, foreground, background)).value();
+}
+
+QImage GlyphCache::rasterize(uint character, const QFont &font, QRgb foreground, QRgb background) const
+{
+    QImage image(QSize(_cellWidth, _cellHeight) * _devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(_devicePixelRatio);
+    image.fill(QColor::fromRgba(background));
+
+    QPainter painter(&image);
+    painter.setFont(font);
+    painter.setPen(QColor::fromRgba(foreground));
+    painter.setRenderHint(QPainter::TextAntialiasing, _antialias);
+    painter.setLayoutDirection(Qt::LeftToRight);
+    painter.drawText(0, _baseline, QString::fromUcs4(&character, 1));
+
+    return image;
+}
@@ -0,0 +1,123 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+// Qt
+#include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+/**
+ * Keeps the glyphs of a terminal display rasterized into images of the
+ * size of a character cell, so that repainting text only has to copy
+ * the images instead of shaping and rasterizing it again.
+ *
+ * Glyphs are drawn onto their opaque background color, which is the only
+ * way to get subpixel antialiased text into an image; the cache is
+ * therefore only of use where the background is a plain color.
+ *
+ * Only characters which do not need shaping and whose glyph fits into a
+ * cell are cached.  glyph() returns a null image for all others and text
+ * containing them has to be drawn with QPainter::drawText().
+ */
+class KONSOLEPRIVATE_EXPORT GlyphCache
+{
+public:
+    /** The variants of the font the glyphs are drawn with */
+    enum FontVariant {
+        Bold = 1 << 0,
+        Underline = 1 << 1,
+        StrikeOut = 1 << 2,
+        Overline = 1 << 3
+    };
+
+    GlyphCache();
+
+    /**
+     * Sets the size of a character cell.  @p baseline is the distance of
+     * the text's baseline from the top of the cell.  Discards all cached
+     * glyphs, as does any change of the display's font.
+     */
+    void setCellSize(int cellWidth, int cellHeight, int baseline);
+
+    /** Sets whether the glyphs are drawn antialiased.  Discards all cached glyphs. */
+    void setAntialias(bool antialias);
+
+    /** Discards all cached glyphs */
+    void clear();
+
+    /** Returns the number of glyphs in the cache */
+    int size() const;
+
+    /** Returns true if @p character can be drawn without shaping */
+    static bool isCacheable(uint character);
+
+    /**
+     * Returns the image of @p character drawn in @p foreground on
+     * @p background with @p font, which is the display's font in the
+     * variant described by @p variant, a combination of FontVariant
+     * flags.  The image has the size of a cell at @p devicePixelRatio.
+     *
+     * Returns a null image if the character cannot be cached.
+     */
+    const QImage &glyph(uint character, const QFont &font, int variant, QRgb foreground, QRgb background,
+                        qreal devicePixelRatio);
+
+private:
+    struct Key {
+        uint character;
+        int variant;
+        QRgb foreground;
+        QRgb background;
+
+        bool operator==(const Key &other) const
+        {
+            return character == other.character && variant == other.variant
+                   && foreground == other.foreground && background == other.background;
+        }
+    };
+    friend uint qHash(const Key &key, uint seed);
+
+    QImage rasterize(uint character, const QFont &font, QRgb foreground, QRgb background) const;
+
+    QHash<Key, QImage> _glyphs;
+    // characters, combined with the font variant, whose glyphs are wider
+    // than a cell; remembered so that they are only measured once
+    QSet<quint64> _wideGlyphs;
+    int _cellWidth;
+    int _cellHeight;
+    int _baseline;
+    bool _antialias;
+    qreal _devicePixelRatio;
+    // returned for characters which are not cached
+    const QImage _nullImage;
+};
+}
+
+#endif // GLYPHCACHE_H
@@ -22,19 +22,21 @@
 #include "History.h"
 
 #include "konsoledebug.h"
-#include "KonsoleSettings.h"
 
 // System
 #include <cerrno>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <sys/types.h>
 #include <unistd.h>
 
 // KDE
+#include <QCoreApplication>
 #include <QDir>
 #include <qplatformdefs.h>
 #include <QStandardPaths>
+#include <QUrl>
 #include <KConfigGroup>
 #include <KSharedConfig>
 
@@ -73,7 +75,7 @@ HistoryFile::HistoryFile() :
     if (!historyFileLocation.exists()) {
         QString fileLocation;
         KSharedConfigPtr appConfig = KSharedConfig::openConfig();
-        if (qApp->applicationName() != QLatin1String("konsole")) {
+        if (QCoreApplication::applicationName() != QLatin1String("konsole")) {
             // Check if "kpart"rc has "FileLocation" group; AFAIK
             // only possible if user manually added it. If not
             // found, use konsole's config.
@@ -86,7 +88,7 @@ HistoryFile::HistoryFile() :
         if (configGroup.readEntry("scrollbackUseCacheLocation", false)) {
             fileLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
         } else if (configGroup.readEntry("scrollbackUseSpecifiedLocation", false)) {
-            const QUrl specifiedUrl = KonsoleSettings::scrollbackUseSpecifiedLocationDirectory();
+            const QUrl specifiedUrl = configGroup.readEntry("scrollbackUseSpecifiedLocationDirectory", QUrl());
             fileLocation = specifiedUrl.path();
         } else {
             fileLocation = QDir::tempPath();
@@ -112,7 +114,7 @@ HistoryFile::HistoryFile() :
     _tmpFile.setFileTemplate(tmpFormat);
     if (_tmpFile.open()) {
 #if defined(Q_OS_LINUX)
-        qCDebug(KonsoleDebug, "HistoryFile: /proc/%lld/fd/%d", qApp->applicationPid(), _tmpFile.handle());
+        qCDebug(KonsoleDebug, "HistoryFile: /proc/%lld/fd/%d", QCoreApplication::applicationPid(), _tmpFile.handle());
 #endif
         // On some systems QTemporaryFile creates unnamed file.
         // Do not interfere in such cases.
@@ -230,6 +232,16 @@ qint64 HistoryFile::len() const
     return _length;
 }
 
+void HistoryFile::flush()
+{
+    _tmpFile.flush();
+}
+
+int HistoryFile::handle() const
+{
+    return _tmpFile.handle();
+}
+
 // History Scroll abstract base class //////////////////////////////////////
 
 HistoryScroll::HistoryScroll(HistoryType *t) :
@@ -261,7 +273,9 @@ bool HistoryScroll::hasScroll()
 */
 
 HistoryScrollFile::HistoryScrollFile() :
-    HistoryScroll(new HistoryTypeFile())
+    HistoryScroll(new HistoryTypeFile()),
+    _lineCache(_index.handle(), _cells.handle(), _lineflags.handle()),
+    _cachedLines(0)
 {
 }
 
@@ -274,11 +288,21 @@ int HistoryScrollFile::getLines()
 
 int HistoryScrollFile::getLineLen(int lineno)
 {
+    const auto block = cachedBlock(lineno);
+    if (!block.isNull()) {
+        return block->lineLength(lineno);
+    }
     return (startOfLine(lineno + 1) - startOfLine(lineno)) / sizeof(Character);
 }
 
 bool HistoryScrollFile::isWrappedLine(int lineno)
 {
+    // the views ask for the flags of the lines they show, a single flag
+    // is read from the file rather than waiting for its block
+    const auto block = isLineLoaded(lineno) ? cachedBlock(lineno) : QSharedPointer<const HistoryLineCache::Block>();
+    if (!block.isNull()) {
+        return block->isWrapped(lineno);
+    }
     if (lineno >= 0 && lineno <= getLines()) {
         unsigned char flag = 0;
         _lineflags.get(reinterpret_cast<char *>(&flag), sizeof(unsigned char),
@@ -301,8 +325,65 @@ qint64 HistoryScrollFile::startOfLine(int lineno)
     return _cells.len();
 }
 
+bool HistoryScrollFile::isCached(int lineno)
+{
+    if (lineno < 0) {
+        return false;
+    }
+    if (lineno >= _cachedLines) {
+        updateCachedLines();
+    }
+    return lineno < _cachedLines;
+}
+
+void HistoryScrollFile::updateCachedLines()
+{
+    // only complete blocks are cached, the last lines are read from the
+    // files until enough lines have been added to fill another block
+    const int completeLines = getLines() / HistoryLineCache::BLOCK_LINES * HistoryLineCache::BLOCK_LINES;
+    if (completeLines == _cachedLines) {
+        return;
+    }
+    _index.flush();
+    _cells.flush();
+    _lineflags.flush();
+    _cachedLines = completeLines;
+    _lineCache.setAvailableLines(completeLines);
+}
+
+HistoryLineCache::Reader HistoryScrollFile::lineReader()
+{
+    updateCachedLines();
+    return _lineCache.reader();
+}
+
+QSharedPointer<const HistoryLineCache::Block> HistoryScrollFile::cachedBlock(int lineno)
+{
+    if (!isCached(lineno)) {
+        return {};
+    }
+    return _lineCache.block(lineno);
+}
+
+bool HistoryScrollFile::isLineLoaded(int lineno)
+{
+    // the lines which are not cached yet were added last, and are
+    // usually still in memory
+    return !isCached(lineno) || _lineCache.isLoaded(lineno);
+}
+
+void HistoryScrollFile::setLoadedCallback(const std::function<void()> &callback)
+{
+    _lineCache.setLoadedCallback(callback);
+}
+
 void HistoryScrollFile::getCells(int lineno, int colno, int count, Character res[])
 {
+    const auto block = cachedBlock(lineno);
+    if (!block.isNull()) {
+        memcpy(res, block->line(lineno) + colno, count * sizeof(Character));
+        return;
+    }
     _cells.get(reinterpret_cast<char*>(res), count * sizeof(Character), startOfLine(lineno) + colno * sizeof(Character));
 }
 
@@ -425,6 +506,15 @@ CompactHistoryBlockList::~CompactHistoryBlockList()
     list.clear();
 }
 
+qint64 CompactHistoryBlockList::memoryUsage() const
+{
+    qint64 usage = 0;
+    for (CompactHistoryBlock *block : list) {
+        usage += block->length();
+    }
+    return usage;
+}
+
 void *CompactHistoryLine::operator new(size_t size, CompactHistoryBlockList &blockList)
 {
     return blockList.allocate(size);
@@ -593,6 +683,11 @@ void CompactHistoryScroll::getCells(int lineNumber, int startColumn, int count,
     line->getCharacters(buffer, count, startColumn);
 }
 
+qint64 CompactHistoryScroll::memoryUsage()
+{
+    return _blockList.memoryUsage() + _lines.size() * static_cast<qint64>(sizeof(CompactHistoryLine *));
+}
+
 void CompactHistoryScroll::setMaxNbLines(unsigned int lineCount)
 {
     _maxLineCount = lineCount;
@@ -23,6 +23,7 @@
 
 // System
 #include <sys/mman.h>
+#include <functional>
 
 // Qt
 #include <QList>
@@ -33,6 +34,7 @@
 
 // Konsole
 #include "Character.h"
+#include "HistoryLineCache.h"
 
 namespace Konsole {
 /*
@@ -54,6 +56,12 @@ public:
     //un-mmaps the file
     void unmap();
 
+    //writes out everything added so far, so that it can be read through
+    //other descriptors of the file
+    void flush();
+    //the descriptor of the file, or -1 if it could not be opened
+    int handle() const;
+
 private:
     qint64 _length;
     QTemporaryFile _tmpFile;
@@ -92,6 +100,24 @@ public:
     virtual void getCells(int lineno, int colno, int count, Character res[]) = 0;
     virtual bool isWrappedLine(int lineNumber) = 0;
 
+    // whether the line can be read without waiting for a file.  If not,
+    // it is loaded in the background and the callback set with
+    // setLoadedCallback() is called, on any thread, once it is there
+    virtual bool isLineLoaded(int lineno)
+    {
+        Q_UNUSED(lineno)
+        return true;
+    }
+    virtual void setLoadedCallback(const std::function<void()> &callback)
+    {
+        Q_UNUSED(callback)
+    }
+    // a reader of the first lines, which may be used on any thread
+    virtual HistoryLineCache::Reader lineReader()
+    {
+        return {};
+    }
+
     // adding lines.
     virtual void addCells(const Character a[], int count) = 0;
     // convenience method - this is virtual so that subclasses can take advantage
@@ -103,6 +129,12 @@ public:
 
     virtual void addLine(bool previousWrapped = false) = 0;
 
+    // bytes of memory taken up by the lines, not counting those kept in files
+    virtual qint64 memoryUsage()
+    {
+        return 0;
+    }
+
     //
     // FIXME:  Passing around constant references to HistoryType instances
     // is very unsafe, because those references will no longer
@@ -132,15 +164,30 @@ public:
     void getCells(int lineno, int colno, int count, Character res[]) override;
     bool isWrappedLine(int lineno) override;
 
+    bool isLineLoaded(int lineno) override;
+    void setLoadedCallback(const std::function<void()> &callback) override;
+    HistoryLineCache::Reader lineReader() override;
+
     void addCells(const Character text[], int count) override;
     void addLine(bool previousWrapped = false) override;
 
 private:
     qint64 startOfLine(int lineno);
+    // whether 'lineno' is read through _lineCache
+    bool isCached(int lineno);
+    // hands the complete blocks of lines added since the last call to _lineCache
+    void updateCachedLines();
+    // returns the cached block of lines containing 'lineno', or a null
+    // pointer if the line has to be read from the files
+    QSharedPointer<const HistoryLineCache::Block> cachedBlock(int lineno);
 
     HistoryFile _index; // lines Row(qint64)
     HistoryFile _cells; // text  Row(Character)
     HistoryFile _lineflags; // flags Row(unsigned char)
+
+    HistoryLineCache _lineCache;
+    // the number of lines flushed to the files for _lineCache
+    int _cachedLines;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -266,6 +313,8 @@ public:
         return list.size();
     }
 
+    qint64 memoryUsage() const;
+
 private:
     QList<CompactHistoryBlock *> list;
 };
@@ -328,6 +377,8 @@ public:
 
     void setMaxNbLines(unsigned int lineCount);
 
+    qint64 memoryUsage() override;
+
 private:
     bool hasDifferentColors(const TextLine &line) const;
     HistoryArray _lines;
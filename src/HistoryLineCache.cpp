@@ -0,0 +1,352 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "HistoryLineCache.h"
+
+// System
+#include <cerrno>
+#include <unistd.h>
+
+// Qt
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+
+using namespace Konsole;
+
+// the number of blocks read ahead of the one being accessed
+static const int READ_AHEAD_BLOCKS = 2;
+// the cache drops the least recently used blocks beyond this size
+static const qint64 MAXIMUM_CACHE_SIZE = 16 * 1024 * 1024;
+
+// reads exactly 'size' bytes at 'offset', returns false on errors and
+// at the end of the file
+static bool readFully(int fd, void *buffer, qint64 size, qint64 offset)
+{
+    auto *data = static_cast<char *>(buffer);
+    while (size > 0) {
+        const ssize_t count = pread(fd, data, static_cast<size_t>(size), offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= count;
+        offset += count;
+    }
+    return true;
+}
+
+// the state shared with the background loads, which keep it alive until
+// they are done
+struct HistoryLineCache::Data
+{
+    Data(int indexFile, int cellsFile, int flagsFile) :
+        indexFile(indexFile < 0 ? -1 : dup(indexFile)),
+        cellsFile(cellsFile < 0 ? -1 : dup(cellsFile)),
+        flagsFile(flagsFile < 0 ? -1 : dup(flagsFile)),
+        availableBlocks(0),
+        size(0)
+    {
+    }
+
+    ~Data()
+    {
+        for (const int fd : {indexFile, cellsFile, flagsFile}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    bool isValid() const
+    {
+        return indexFile >= 0 && cellsFile >= 0 && flagsFile >= 0;
+    }
+
+    QSharedPointer<const Block> load(int blockNumber) const;
+    void insert(int blockNumber, const QSharedPointer<const Block> &block);
+
+    const int indexFile;
+    const int cellsFile;
+    const int flagsFile;
+
+    QMutex mutex;
+    // the members below are guarded by the mutex
+    int availableBlocks;
+    QHash<int, QSharedPointer<const Block>> blocks;
+    // block numbers from the least to the most recently used
+    QVector<int> recentlyUsed;
+    // blocks being loaded in the background
+    QSet<int> pending;
+    // blocks reported missing by isLoaded(), which call 'loaded' once
+    // they are there
+    QSet<int> missed;
+    // blocks which could not be read
+    QSet<int> failed;
+    std::function<void()> loaded;
+    qint64 size;
+};
+
+QSharedPointer<const HistoryLineCache::Block> HistoryLineCache::Data::load(int blockNumber) const
+{
+    auto block = QSharedPointer<Block>::create();
+    block->firstLine = blockNumber * BLOCK_LINES;
+    block->lineStarts.resize(BLOCK_LINES + 1);
+    block->flags.resize(BLOCK_LINES);
+
+    // the index holds the start of every line but the first, which starts at 0
+    qint64 *lineStarts = block->lineStarts.data();
+    if (block->firstLine == 0) {
+        *lineStarts++ = 0;
+        if (!readFully(indexFile, lineStarts, BLOCK_LINES * sizeof(qint64), 0)) {
+            return {};
+        }
+    } else if (!readFully(indexFile, lineStarts, (BLOCK_LINES + 1) * sizeof(qint64),
+                          (block->firstLine - 1) * static_cast<qint64>(sizeof(qint64)))) {
+        return {};
+    }
+
+    if (!readFully(flagsFile, block->flags.data(), BLOCK_LINES, block->firstLine)) {
+        return {};
+    }
+
+    const qint64 cellsSize = block->lineStarts.last() - block->lineStarts.first();
+    if (cellsSize < 0 || cellsSize % sizeof(Character) != 0) {
+        return {};
+    }
+    block->cells.resize(static_cast<int>(cellsSize / sizeof(Character)));
+    if (cellsSize > 0 && !readFully(cellsFile, block->cells.data(), cellsSize, block->lineStarts.first())) {
+        return {};
+    }
+
+    return block;
+}
+
+void HistoryLineCache::Data::insert(int blockNumber, const QSharedPointer<const Block> &block)
+{
+    if (!blocks.contains(blockNumber)) {
+        blocks.insert(blockNumber, block);
+        size += block->size();
+    }
+    failed.remove(blockNumber);
+    recentlyUsed.removeOne(blockNumber);
+    recentlyUsed.append(blockNumber);
+
+    // blocks still referenced by a reader are only freed when it lets go
+    while (size > MAXIMUM_CACHE_SIZE && recentlyUsed.size() > 1) {
+        const int oldest = recentlyUsed.takeFirst();
+        size -= blocks.take(oldest)->size();
+    }
+}
+
+// loads a block on the thread pool
+class HistoryLineCache::LoadTask : public QRunnable
+{
+public:
+    LoadTask(const QSharedPointer<Data> &data, int blockNumber) :
+        _data(data),
+        _blockNumber(blockNumber)
+    {
+    }
+
+    void run() override
+    {
+        const QSharedPointer<const Block> block = _data->load(_blockNumber);
+
+        QMutexLocker locker(&_data->mutex);
+        _data->pending.remove(_blockNumber);
+        if (!block.isNull()) {
+            _data->insert(_blockNumber, block);
+        } else {
+            _data->failed.insert(_blockNumber);
+        }
+        if (_data->missed.remove(_blockNumber) && _data->loaded) {
+            _data->loaded();
+        }
+    }
+
+private:
+    const QSharedPointer<Data> _data;
+    const int _blockNumber;
+};
+
+HistoryLineCache::HistoryLineCache(int indexFile, int cellsFile, int flagsFile) :
+    _data(new Data(indexFile, cellsFile, flagsFile)),
+    _lastBlock(),
+    _lastBlockNumber(-1),
+    _direction(1)
+{
+}
+
+HistoryLineCache::~HistoryLineCache()
+{
+    // loads still running keep the data alive, but must not call back
+    QMutexLocker locker(&_data->mutex);
+    _data->loaded = nullptr;
+}
+
+void HistoryLineCache::setAvailableLines(int lines)
+{
+    QMutexLocker locker(&_data->mutex);
+    _data->availableBlocks = lines / BLOCK_LINES;
+}
+
+int HistoryLineCache::cachedLines() const
+{
+    QMutexLocker locker(&_data->mutex);
+    return _data->availableBlocks * BLOCK_LINES;
+}
+
+QSharedPointer<const HistoryLineCache::Block> HistoryLineCache::block(int lineNumber)
+{
+    if (lineNumber < 0 || !_data->isValid()) {
+        return {};
+    }
+    const int blockNumber = lineNumber / BLOCK_LINES;
+    if (blockNumber == _lastBlockNumber && !_lastBlock.isNull()) {
+        return _lastBlock;
+    }
+
+    QSharedPointer<const Block> block;
+    {
+        QMutexLocker locker(&_data->mutex);
+        if (blockNumber >= _data->availableBlocks) {
+            return {};
+        }
+        block = _data->blocks.value(blockNumber);
+        if (!block.isNull()) {
+            _data->insert(blockNumber, block);
+        }
+    }
+
+    if (block.isNull()) {
+        // a miss of a reader which cannot wait, e.g. the search, the views
+        // ask isLoaded() first
+        block = _data->load(blockNumber);
+        if (block.isNull()) {
+            return {};
+        }
+        QMutexLocker locker(&_data->mutex);
+        _data->insert(blockNumber, block);
+    }
+
+    if (_lastBlockNumber != -1) {
+        _direction = blockNumber < _lastBlockNumber ? -1 : 1;
+    }
+    _lastBlock = block;
+    _lastBlockNumber = blockNumber;
+
+    readAhead(blockNumber);
+
+    return block;
+}
+
+bool HistoryLineCache::isLoaded(int lineNumber)
+{
+    if (lineNumber < 0 || !_data->isValid()) {
+        return true;
+    }
+    const int blockNumber = lineNumber / BLOCK_LINES;
+    if (blockNumber == _lastBlockNumber && !_lastBlock.isNull()) {
+        return true;
+    }
+
+    QMutexLocker locker(&_data->mutex);
+    if (blockNumber >= _data->availableBlocks || _data->blocks.contains(blockNumber)
+        || _data->failed.contains(blockNumber)) {
+        return true;
+    }
+
+    _data->missed.insert(blockNumber);
+    if (!_data->pending.contains(blockNumber)) {
+        _data->pending.insert(blockNumber);
+        QThreadPool::globalInstance()->start(new LoadTask(_data, blockNumber));
+    }
+    return false;
+}
+
+void HistoryLineCache::setLoadedCallback(const std::function<void()> &callback)
+{
+    QMutexLocker locker(&_data->mutex);
+    _data->loaded = callback;
+}
+
+HistoryLineCache::Reader HistoryLineCache::reader() const
+{
+    Reader reader;
+    if (_data->isValid()) {
+        reader._data = _data;
+        reader._lines = cachedLines();
+    }
+    return reader;
+}
+
+HistoryLineCache::Reader::Reader() :
+    _data(),
+    _lines(0)
+{
+}
+
+int HistoryLineCache::Reader::lines() const
+{
+    return _lines;
+}
+
+QSharedPointer<const HistoryLineCache::Block> HistoryLineCache::Reader::block(int lineNumber) const
+{
+    if (lineNumber < 0 || lineNumber >= _lines) {
+        return {};
+    }
+    const int blockNumber = lineNumber / BLOCK_LINES;
+    {
+        QMutexLocker locker(&_data->mutex);
+        const QSharedPointer<const Block> block = _data->blocks.value(blockNumber);
+        if (!block.isNull()) {
+            return block;
+        }
+    }
+    return _data->load(blockNumber);
+}
+
+void HistoryLineCache::readAhead(int blockNumber)
+{
+    QMutexLocker locker(&_data->mutex);
+
+    for (int i = 1; i <= READ_AHEAD_BLOCKS; i++) {
+        const int next = blockNumber + i * _direction;
+        if (next < 0 || next >= _data->availableBlocks) {
+            break;
+        }
+        if (_data->blocks.contains(next) || _data->pending.contains(next)) {
+            continue;
+        }
+        _data->pending.insert(next);
+        QThreadPool::globalInstance()->start(new LoadTask(_data, next));
+    }
+}
@@ -0,0 +1,185 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+#ifndef HISTORYLINECACHE_H
+#define HISTORYLINECACHE_H
+
+// System
+#include <functional>
+
+// Qt
+#include <QSharedPointer>
+#include <QVector>
+
+// Konsole
+#include "Character.h"
+
+namespace Konsole {
+/**
+ * Caches the lines of a file based history in blocks of consecutive
+ * lines, each read from the history files with three reads.
+ *
+ * Scrolling through the history accesses one block after another, so
+ * the cache reads ahead: once a block has been accessed, the next blocks
+ * in the direction the history is being scrolled are loaded on a
+ * background thread, and are usually there by the time they are needed.
+ *
+ * The display must not wait for the files either: it asks isLoaded()
+ * first, shows placeholders for the lines which are still being read and
+ * is told through the callback set with setLoadedCallback() when they
+ * are there.
+ *
+ * Lines of the history never change once they have been added.  The
+ * files are read with pread() through duplicates of their descriptors,
+ * so background reads neither interfere with lines being added nor
+ * outlive the files they read from.  Only lines which have been flushed
+ * to the files, see setAvailableLines(), are read.
+ */
+class HistoryLineCache
+{
+    struct Data;
+
+public:
+    /** The number of lines in a block */
+    static const int BLOCK_LINES = 256;
+
+    /** A block of consecutive lines */
+    struct Block {
+        int lineLength(int lineNumber) const
+        {
+            const int i = lineNumber - firstLine;
+            return static_cast<int>((lineStarts[i + 1] - lineStarts[i]) / sizeof(Character));
+        }
+
+        const Character *line(int lineNumber) const
+        {
+            const int i = lineNumber - firstLine;
+            return cells.constData() + (lineStarts[i] - lineStarts[0]) / sizeof(Character);
+        }
+
+        bool isWrapped(int lineNumber) const
+        {
+            return flags[lineNumber - firstLine] != 0;
+        }
+
+        qint64 size() const
+        {
+            return cells.size() * sizeof(Character) + lineStarts.size() * sizeof(qint64) + flags.size();
+        }
+
+        int firstLine;
+        // offset of each line in the cells file, and that of the line
+        // following the block
+        QVector<qint64> lineStarts;
+        QVector<uchar> flags;
+        QVector<Character> cells;
+    };
+
+    /**
+     * Reads the lines which were cached when it was created, on any
+     * thread.  It shares the duplicated descriptors of the files with the
+     * cache and stays valid after the cache is destroyed.
+     */
+    class Reader
+    {
+    public:
+        Reader();
+
+        /** The number of lines which can be read */
+        int lines() const;
+
+        /**
+         * Returns the block containing line @p lineNumber, or a null
+         * pointer if it cannot be read.  Blocks which are not cached are
+         * read without caching them, so that reading many lines does not
+         * push out those the views need.
+         */
+        QSharedPointer<const Block> block(int lineNumber) const;
+
+    private:
+        friend class HistoryLineCache;
+
+        QSharedPointer<Data> _data;
+        int _lines;
+    };
+
+    /**
+     * Constructs a cache reading from the files with the descriptors
+     * @p indexFile, @p cellsFile and @p flagsFile, laid out as written by
+     * HistoryScrollFile.
+     */
+    HistoryLineCache(int indexFile, int cellsFile, int flagsFile);
+    ~HistoryLineCache();
+
+    /**
+     * Announces that the first @p lines lines of the history have been
+     * written to the files.  Only complete blocks of these are cached.
+     */
+    void setAvailableLines(int lines);
+
+    /** Returns the number of lines which are cached, see setAvailableLines() */
+    int cachedLines() const;
+
+    /**
+     * Returns the block containing line @p lineNumber, or a null pointer
+     * if the line is not cached or cannot be read.  The blocks following
+     * it in the direction of the previous accesses are loaded in the
+     * background.
+     */
+    QSharedPointer<const Block> block(int lineNumber);
+
+    /**
+     * Returns whether block() can return line @p lineNumber without
+     * reading the files.  If not, the block is loaded in the background
+     * and the callback set with setLoadedCallback() is called once it
+     * is cached.  Lines which are not cached at all, or whose block
+     * cannot be read, are reported as loaded.
+     */
+    bool isLoaded(int lineNumber);
+
+    /**
+     * Sets the function called when a block which isLoaded() reported
+     * missing has been loaded.  It is called on a background thread,
+     * and never after the cache has been destroyed.
+     */
+    void setLoadedCallback(const std::function<void()> &callback);
+
+    /** Returns a reader of the lines cached now, see setAvailableLines() */
+    Reader reader() const;
+
+private:
+    Q_DISABLE_COPY(HistoryLineCache)
+
+    class LoadTask;
+
+    void readAhead(int blockNumber);
+
+    QSharedPointer<Data> _data;
+    // the block returned last, looked up without locking
+    QSharedPointer<const Block> _lastBlock;
+    int _lastBlockNumber;
+    // 1 while the history is being scrolled down, -1 while scrolled up
+    int _direction;
+};
+}
+
+#endif // HISTORYLINECACHE_H
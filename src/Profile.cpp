@@ -91,6 +91,7 @@ const Profile::PropertyInfo Profile::DefaultPropertyNames[] = {
     // Scrolling
     , { HistoryMode , "HistoryMode" , SCROLLING_GROUP , QVariant::Int }
     , { HistorySize , "HistorySize" , SCROLLING_GROUP , QVariant::Int }
+    , { HistoryIndexEnabled , "HistoryIndexEnabled" , SCROLLING_GROUP , QVariant::Bool }
     , { ScrollBarPosition , "ScrollBarPosition" , SCROLLING_GROUP , QVariant::Int }
     , { ScrollFullPage , "ScrollFullPage" , SCROLLING_GROUP , QVariant::Bool }
 
@@ -99,6 +100,7 @@ const Profile::PropertyInfo Profile::DefaultPropertyNames[] = {
     , { ReverseUrlHints , "ReverseUrlHints" , TERMINAL_GROUP , QVariant::Bool }
     , { BlinkingTextEnabled , "BlinkingTextEnabled" , TERMINAL_GROUP , QVariant::Bool }
     , { FlowControlEnabled , "FlowControlEnabled" , TERMINAL_GROUP , QVariant::Bool }
+    , { ReadHighWaterMark , "ReadHighWaterMark" , TERMINAL_GROUP , QVariant::Int }
     , { BidiRenderingEnabled , "BidiRenderingEnabled" , TERMINAL_GROUP , QVariant::Bool }
     , { BlinkingCursorEnabled , "BlinkingCursorEnabled" , TERMINAL_GROUP , QVariant::Bool }
     , { BellMode , "BellMode" , TERMINAL_GROUP , QVariant::Int }
@@ -186,10 +188,12 @@ void Profile::useFallback()
 
     setProperty(HistoryMode, Enum::FixedSizeHistory);
     setProperty(HistorySize, 1000);
+    setProperty(HistoryIndexEnabled, qEnvironmentVariableIntValue("KONSOLE_HISTORY_INDEX") == 1);
     setProperty(ScrollBarPosition, Enum::ScrollBarRight);
     setProperty(ScrollFullPage, false);
 
     setProperty(FlowControlEnabled, true);
+    setProperty(ReadHighWaterMark, 4096);
     setProperty(UrlHintsModifiers, 0);
     setProperty(ReverseUrlHints, false);
     setProperty(BlinkingTextEnabled, true);
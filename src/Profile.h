@@ -142,6 +142,12 @@ public:
          * FixedSizeHistory
          */
         HistorySize,
+        /** (bool) Specifies whether the output remembered by terminal
+         * sessions using this profile is indexed, which speeds up searching
+         * a long history at the cost of some memory.  Enabled by default
+         * if the KONSOLE_HISTORY_INDEX environment variable is set to 1.
+         */
+        HistoryIndexEnabled,
         /** (ScrollBarPositionEnum) Specifies the position of the scroll bar
          * in terminal displays using this profile.
          *
@@ -302,7 +308,12 @@ public:
         /** (bool) Reverse the order of URL hints */
         ReverseUrlHints,
         /** (QColor) used in tab color */
-        TabColor
+        TabColor,
+        /** (int) Amount of output in kilobytes which may be waiting to be
+         * processed before no more is read from the terminal process.
+         * 0 means no limit.
+         */
+        ReadHighWaterMark
     };
 
     Q_ENUM(Property)
@@ -608,6 +619,12 @@ public:
         return property<int>(Profile::SilenceSeconds);
     }
 
+    /** Convenience method for property<int>(Profile::ReadHighWaterMark) */
+    int readHighWaterMark() const
+    {
+        return property<int>(Profile::ReadHighWaterMark);
+    }
+
     /** Convenience method for property<QString>(Profile::TerminalColumns) */
     int terminalColumns() const
     {
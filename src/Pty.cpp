@@ -22,6 +22,7 @@
 #include "Pty.h"
 
 #include "konsoledebug.h"
+#include "config-konsole.h"
 
 // System
 #include <termios.h>
@@ -34,6 +35,12 @@
 // KDE
 #include <KPtyDevice>
 
+// Konsole
+#include "Tracer.h"
+#if HAVE_SYS_EPOLL_H
+#include "PtyReader.h"
+#endif
+
 using Konsole::Pty;
 
 Pty::Pty(int masterFd, QObject *aParent) :
@@ -55,6 +62,9 @@ void Pty::init()
     _eraseChar = 0;
     _xonXoff = true;
     _utf8 = true;
+    _readSuspended = false;
+    _readInThread = false;
+    _tracer.storeRelease(nullptr);
 
     setEraseChar(_eraseChar);
     setFlowControlEnabled(_xonXoff);
@@ -65,10 +75,28 @@ void Pty::init()
     setUseUtmp(true);
     setPtyChannels(KPtyProcess::AllChannels);
 
+#if HAVE_SYS_EPOLL_H
+    // all ptys are read by one thread; KPtyDevice's own notifier is
+    // only used if that is not available
+    if (Konsole::PtyReader::instance()->addPty(this)) {
+        pty()->setSuspended(true);
+        _readInThread = true;
+        return;
+    }
+#endif
+
     connect(pty(), &KPtyDevice::readyRead, this, &Konsole::Pty::dataReceived);
 }
 
-Pty::~Pty() = default;
+Pty::~Pty()
+{
+#if HAVE_SYS_EPOLL_H
+    // the reader is gone already if this is deleted on exit
+    if (Konsole::PtyReader *reader = Konsole::PtyReader::instance()) {
+        reader->removePty(this);
+    }
+#endif
+}
 
 void Pty::sendData(const QByteArray &data)
 {
@@ -84,7 +112,11 @@ void Pty::sendData(const QByteArray &data)
 
 void Pty::dataReceived()
 {
-    QByteArray data = pty()->readAll();
+    QByteArray data;
+    {
+        Konsole::TraceScope trace(tracer(), Konsole::Tracer::ReadStage);
+        data = pty()->readAll();
+    }
     if (data.isEmpty()) {
         return;
     }
@@ -289,9 +321,46 @@ void Pty::setWriteable(bool writeable)
 
 void Pty::closePty()
 {
+#if HAVE_SYS_EPOLL_H
+    if (Konsole::PtyReader *reader = Konsole::PtyReader::instance()) {
+        reader->removePty(this);
+    }
+    _readInThread = false;
+#endif
     pty()->close();
 }
 
+void Pty::setReadSuspended(bool suspended)
+{
+    if (_readSuspended == suspended) {
+        return;
+    }
+    _readSuspended = suspended;
+
+#if HAVE_SYS_EPOLL_H
+    if (_readInThread) {
+        Konsole::PtyReader::instance()->setPaused(this, suspended);
+        return;
+    }
+#endif
+    pty()->setSuspended(suspended);
+}
+
+bool Pty::isReadSuspended() const
+{
+    return _readSuspended;
+}
+
+void Pty::setTracer(Konsole::Tracer *tracer)
+{
+    _tracer.storeRelease(tracer);
+}
+
+Konsole::Tracer *Pty::tracer() const
+{
+    return _tracer.loadAcquire();
+}
+
 void Pty::sendEof()
 {
     if (pty()->masterFd() < 0) {
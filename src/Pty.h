@@ -24,6 +24,7 @@
 #define PTY_H
 
 // Qt
+#include <QAtomicPointer>
 #include <QSize>
 
 // KDE
@@ -35,6 +36,8 @@
 class QStringList;
 
 namespace Konsole {
+class Tracer;
+
 /**
  * The Pty class is used to start the terminal process,
  * send data to it, receive data from it and manipulate
@@ -142,6 +145,26 @@ public:
      */
     void sendEof();
 
+    /**
+     * Stops or resumes reading output from the terminal process.  While
+     * reading is suspended, the output is held back in the kernel's pty
+     * buffer, so that a process writing more of it is blocked until
+     * reading is resumed.
+     */
+    void setReadSuspended(bool suspended);
+
+    /** Returns true if reading output is suspended.  See setReadSuspended() */
+    bool isReadSuspended() const;
+
+    /**
+     * Sets the tracer which times the reading of the output.  It may be
+     * used from the thread reading the output, see PtyReader.
+     */
+    void setTracer(Tracer *tracer);
+
+    /** Returns the tracer set with setTracer() */
+    Tracer *tracer() const;
+
 public Q_SLOTS:
     /**
      * Put the pty into UTF-8 mode on systems which support it.
@@ -185,6 +208,11 @@ private:
     char _eraseChar;
     bool _xonXoff;
     bool _utf8;
+    bool _readSuspended;
+    // true if the output is read by the PtyReader thread rather than
+    // by KPtyDevice
+    bool _readInThread;
+    QAtomicPointer<Tracer> _tracer;
 };
 }
 
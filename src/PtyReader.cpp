@@ -0,0 +1,372 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "PtyReader.h"
+
+#include "konsoledebug.h"
+
+// System
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// Qt
+#include <QMutexLocker>
+#include <QVector>
+
+// KDE
+#include <KPtyDevice>
+
+// Konsole
+#include "Pty.h"
+#include "Tracer.h"
+
+using namespace Konsole;
+
+Q_GLOBAL_STATIC(PtyReader, theReader)
+
+// size of the ring buffer of each pty, the most output which is read
+// ahead of the terminal emulation
+static const int RING_SIZE = 256 * 1024;
+// epoll data of the eventfd, channel ids start above it
+static const quint64 WAKEUP_ID = 0;
+
+PtyReader::PtyReader() :
+    QThread(),
+    _epollFd(-1),
+    _wakeupFd(-1),
+    _mutex(),
+    _channels(),
+    _channelIds(),
+    _nextChannelId(WAKEUP_ID + 1),
+    _stopping(false),
+    _deliveryPending(0)
+{
+    setObjectName(QStringLiteral("PtyReader"));
+
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    _wakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_epollFd < 0 || _wakeupFd < 0) {
+        qCDebug(KonsoleDebug) << "Could not set up epoll, ptys are read in the GUI thread";
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKEUP_ID;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeupFd, &event);
+}
+
+PtyReader::~PtyReader()
+{
+    if (isRunning()) {
+        {
+            QMutexLocker locker(&_mutex);
+            _stopping = true;
+        }
+        const quint64 one = 1;
+        const ssize_t written = ::write(_wakeupFd, &one, sizeof(one));
+        Q_UNUSED(written)
+        wait();
+    }
+
+    qDeleteAll(_channels);
+
+    if (_wakeupFd >= 0) {
+        ::close(_wakeupFd);
+    }
+    if (_epollFd >= 0) {
+        ::close(_epollFd);
+    }
+}
+
+PtyReader *PtyReader::instance()
+{
+    return theReader;
+}
+
+bool PtyReader::addPty(Pty *pty)
+{
+    const int fd = pty->pty()->masterFd();
+    if (_epollFd < 0 || _wakeupFd < 0 || fd < 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&_mutex);
+
+    if (_channelIds.contains(pty)) {
+        return true;
+    }
+
+    auto *channel = new Channel;
+    channel->pty = pty;
+    channel->fd = fd;
+    channel->buffer.reset(new char[RING_SIZE]);
+    channel->writePosition = 0;
+    channel->readPosition = 0;
+    channel->deliverPosition = 0;
+    channel->deliveries = 0;
+    channel->removed = false;
+    channel->watched = false;
+    channel->paused = false;
+
+    const quint64 id = _nextChannelId++;
+    watchChannel(id, channel, true);
+    if (!channel->watched) {
+        delete channel;
+        return false;
+    }
+
+    _channels.insert(id, channel);
+    _channelIds.insert(pty, id);
+
+    locker.unlock();
+
+    if (!isRunning()) {
+        start();
+    }
+    return true;
+}
+
+void PtyReader::removePty(Pty *pty)
+{
+    QMutexLocker locker(&_mutex);
+
+    const quint64 id = _channelIds.take(pty);
+    Channel *channel = _channels.take(id);
+    if (channel == nullptr) {
+        return;
+    }
+
+    // the fd is removed from the epoll set before it is closed, and the
+    // reader thread looks the channel up by id, so an event which is
+    // already pending for it is ignored
+    watchChannel(id, channel, false);
+
+    if (channel->deliveries > 0) {
+        // removed from a receiver of its own output, e.g. when the
+        // session is closed from a dialog; deliverData() deletes it
+        channel->removed = true;
+    } else {
+        delete channel;
+    }
+}
+
+void PtyReader::setPaused(Pty *pty, bool paused)
+{
+    QMutexLocker locker(&_mutex);
+
+    const quint64 id = _channelIds.value(pty);
+    Channel *channel = _channels.value(id);
+    if (channel == nullptr || channel->paused == paused) {
+        return;
+    }
+
+    channel->paused = paused;
+    if (paused) {
+        watchChannel(id, channel, false);
+    } else if (channel->writePosition - channel->readPosition < RING_SIZE) {
+        watchChannel(id, channel, true);
+    }
+}
+
+void PtyReader::watchChannel(quint64 id, Channel *channel, bool watch)
+{
+    if (channel->watched == watch) {
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    if (epoll_ctl(_epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, channel->fd, &event) == 0) {
+        channel->watched = watch;
+    } else if (!watch) {
+        // the fd has been closed already, which removed it from the set
+        channel->watched = false;
+    }
+}
+
+bool PtyReader::readChannel(quint64 id, Channel *channel)
+{
+    bool dataRead = false;
+
+    // an event may have been pending when the channel was paused
+    if (channel->paused) {
+        return false;
+    }
+
+    TraceScope trace(channel->pty->tracer(), Tracer::ReadStage);
+
+    forever {
+        const quint64 used = channel->writePosition - channel->readPosition;
+        if (used == RING_SIZE) {
+            // stop reading until the GUI thread has caught up; meanwhile the
+            // process' output waits in the kernel's pty buffer
+            watchChannel(id, channel, false);
+            break;
+        }
+
+        // read only what is available, the master fd is blocking
+        int available = 0;
+        if (::ioctl(channel->fd, FIONREAD, &available) < 0 || available <= 0) {
+            break;
+        }
+
+        const int offset = static_cast<int>(channel->writePosition % RING_SIZE);
+        const int space = qMin(RING_SIZE - offset, static_cast<int>(RING_SIZE - used));
+        const ssize_t count = ::read(channel->fd, channel->buffer.get() + offset, qMin(available, space));
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        channel->writePosition += count;
+        dataRead = true;
+
+        if (count == available) {
+            break;
+        }
+        // otherwise the read stopped at the end of the ring, continue at its start
+    }
+
+    return dataRead;
+}
+
+void PtyReader::run()
+{
+    static const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+
+    forever {
+        const int count = epoll_wait(_epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCDebug(KonsoleDebug) << "epoll_wait failed, no longer reading ptys:" << strerror(errno);
+            return;
+        }
+
+        bool dataRead = false;
+        {
+            QMutexLocker locker(&_mutex);
+            if (_stopping) {
+                return;
+            }
+
+            for (int i = 0; i < count; i++) {
+                const quint64 id = events[i].data.u64;
+                Channel *channel = _channels.value(id);
+                if (channel == nullptr) {
+                    continue;
+                }
+
+                if (readChannel(id, channel)) {
+                    dataRead = true;
+                } else if ((events[i].events & (EPOLLHUP | EPOLLERR)) != 0) {
+                    // nothing left to read and nothing more will come;
+                    // stop the event from being reported over and over
+                    watchChannel(id, channel, false);
+                }
+            }
+        }
+
+        // a single wakeup of the GUI thread for the whole batch, and none
+        // at all while the previous one has not been handled yet
+        if (dataRead && _deliveryPending.testAndSetOrdered(0, 1)) {
+            QMetaObject::invokeMethod(this, &PtyReader::deliverData, Qt::QueuedConnection);
+        }
+    }
+}
+
+void PtyReader::deliverData()
+{
+    _deliveryPending.storeRelease(0);
+
+    // the ptys' output up to now; what arrives while it is passed on
+    // is left for the next wakeup
+    QVector<QPair<quint64, quint64>> pending;
+    {
+        QMutexLocker locker(&_mutex);
+        pending.reserve(_channels.count());
+        for (auto it = _channels.constBegin(); it != _channels.constEnd(); ++it) {
+            if (it.value()->writePosition != it.value()->deliverPosition) {
+                pending.append(qMakePair(it.key(), it.value()->writePosition));
+            }
+        }
+    }
+
+    for (const auto &entry : qAsConst(pending)) {
+        const quint64 id = entry.first;
+        const quint64 end = entry.second;
+
+        forever {
+            Channel *channel;
+            const char *data;
+            int length;
+            Pty *pty;
+            {
+                QMutexLocker locker(&_mutex);
+                channel = _channels.value(id);
+                if (channel == nullptr || channel->deliverPosition >= end) {
+                    break;
+                }
+                const int offset = static_cast<int>(channel->deliverPosition % RING_SIZE);
+                length = static_cast<int>(qMin<quint64>(end - channel->deliverPosition, RING_SIZE - offset));
+                data = channel->buffer.get() + offset;
+                pty = channel->pty;
+
+                // A receiver may run a nested event loop, as the zmodem
+                // dialog does, in which deliverData() is called again.  The
+                // data is reserved before it is passed on, so that it is
+                // not passed on twice.
+                channel->deliverPosition += length;
+                channel->deliveries++;
+            }
+
+            // the reader thread only writes to the free part of the ring,
+            // which does not grow before all deliveries have returned, so
+            // the data can be passed on without copying it
+            emit pty->receivedData(data, length);
+
+            QMutexLocker locker(&_mutex);
+            if (--channel->deliveries > 0) {
+                // an outer delivery frees the data once it returns
+                continue;
+            }
+            if (channel->removed) {
+                delete channel;
+                break;
+            }
+            channel->readPosition = channel->deliverPosition;
+            if (!channel->watched && !channel->paused) {
+                watchChannel(id, channel, true);
+            }
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef PTYREADER_H
+#define PTYREADER_H
+
+// Std
+#include <memory>
+
+// Qt
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+
+namespace Konsole {
+class Pty;
+
+/**
+ * Reads the output of all terminal processes in a single background thread.
+ *
+ * Instead of a socket notifier in the GUI event loop for every session,
+ * the master side of each pty is watched with epoll by one thread.  The
+ * output is read into a ring buffer per pty, using reads as large as the
+ * data available.  After each round of reads the GUI thread is woken up
+ * once and all buffered output is passed on through Pty::receivedData(),
+ * however many ptys had output.
+ *
+ * When the ring buffer of a pty is full, the pty is no longer read from
+ * until the GUI thread has caught up, which lets the kernel's pty buffer
+ * hold back the process writing to it.
+ */
+class PtyReader : public QThread
+{
+    Q_OBJECT
+
+public:
+    PtyReader();
+    ~PtyReader() override;
+
+    /** Returns the reader shared by all ptys. */
+    static PtyReader *instance();
+
+    /**
+     * Starts reading the output of @p pty.  Returns false if that is not
+     * possible, in which case the pty has to read its output itself.
+     */
+    bool addPty(Pty *pty);
+    /** Stops reading the output of @p pty. */
+    void removePty(Pty *pty);
+
+    /**
+     * Pauses or resumes reading the output of @p pty.  While paused, the
+     * output is left in the kernel's pty buffer.
+     */
+    void setPaused(Pty *pty, bool paused);
+
+protected:
+    void run() override;
+
+private Q_SLOTS:
+    // passes the buffered output on to the ptys, runs in the GUI thread
+    void deliverData();
+
+private:
+    struct Channel {
+        Pty *pty;
+        int fd;
+        std::unique_ptr<char[]> buffer;
+        // total number of bytes read from the pty and passed on to it;
+        // the difference is the amount of data in the buffer
+        quint64 writePosition;
+        quint64 readPosition;
+        // total number of bytes handed to the pty, which is ahead of
+        // readPosition while receivedData() has not returned yet
+        quint64 deliverPosition;
+        // number of calls to receivedData() in progress, more than one
+        // if a receiver runs a nested event loop
+        int deliveries;
+        // set if the pty is removed during a delivery; the channel is
+        // deleted once the delivery returns
+        bool removed;
+        // false while the fd is not watched because the buffer is full
+        // or reading is paused
+        bool watched;
+        bool paused;
+    };
+
+    // reads the data available from the channel's pty, returns true if any
+    bool readChannel(quint64 id, Channel *channel);
+    void watchChannel(quint64 id, Channel *channel, bool watch);
+
+    int _epollFd;
+    // used to wake up the reader thread when it is stopped
+    int _wakeupFd;
+
+    // protects _channels and the positions in each channel
+    QMutex _mutex;
+    QHash<quint64, Channel *> _channels;
+    QHash<Pty *, quint64> _channelIds;
+    quint64 _nextChannelId;
+    bool _stopping;
+
+    // set while a call of deliverData() is queued in the GUI thread
+    QAtomicInt _deliveryPending;
+};
+}
+
+#endif // PTYREADER_H
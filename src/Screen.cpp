@@ -30,6 +30,7 @@
 #include "TerminalCharacterDecoder.h"
 #include "History.h"
 #include "ExtendedCharTable.h"
+#include "TrigramIndex.h"
 
 using namespace Konsole;
 
@@ -53,7 +54,6 @@ const Character Screen::DefaultChar = Character(' ',
                                       false);
 
 Screen::Screen(int lines, int columns):
-    _currentTerminalDisplay(nullptr),
     _lines(lines),
     _columns(columns),
     _screenLines(new ImageLine[_lines + 1]),
@@ -63,6 +63,8 @@ Screen::Screen(int lines, int columns):
     _droppedLines(0),
     _lineProperties(QVarLengthArray<LineProperty, 64>()),
     _history(new HistoryScrollNone()),
+    _historyIndex(nullptr),
+    _historyLoaded(),
     _cuX(0),
     _cuY(0),
     _currentForeground(CharacterColor()),
@@ -95,6 +97,7 @@ Screen::~Screen()
 {
     delete[] _screenLines;
     delete _history;
+    delete _historyIndex;
 }
 
 void Screen::cursorUp(int n)
@@ -452,10 +455,14 @@ void Screen::copyFromHistory(Character* dest, int startLine, int count) const
     Q_ASSERT(startLine >= 0 && count > 0 && startLine + count <= _history->getLines());
 
     for (int line = startLine; line < startLine + count; line++) {
-        const int length = qMin(_columns, _history->getLineLen(line));
+        // lines still being read from a file are left blank for now, the
+        // views are updated once they are there
+        const int length = _history->isLineLoaded(line) ? qMin(_columns, _history->getLineLen(line)) : 0;
         const int destLineOffset  = (line - startLine) * _columns;
 
-        _history->getCells(line, 0, length, dest + destLineOffset);
+        if (length > 0) {
+            _history->getCells(line, 0, length, dest + destLineOffset);
+        }
 
         for (int column = length; column < _columns; column++) {
             dest[destLineOffset + column] = Screen::DefaultChar;
@@ -1414,6 +1421,14 @@ void Screen::addHistLine()
 
         const int newHistLines = _history->getLines();
 
+        if (_historyIndex != nullptr) {
+            if (newHistLines == oldHistLines) {
+                _historyIndex->removeLines(1);
+            }
+            _historyIndex->addLine(_screenLines[0].constData(), _screenLines[0].size(),
+                                   (_lineProperties[0] & LINE_WRAPPED) != 0);
+        }
+
         const bool beginIsTL = (_selBegin == _selTopLeft);
 
         // If the history is full, increment the count
@@ -1475,6 +1490,11 @@ void Screen::setScroll(const HistoryType& t , bool copyPreviousScroll)
         _history = t.scroll(nullptr);
         delete oldScroll;
     }
+    _history->setLoadedCallback(_historyLoaded);
+
+    if (_historyIndex != nullptr) {
+        _historyIndex->reset(_history->getLines());
+    }
 }
 
 bool Screen::hasScroll() const
@@ -1482,6 +1502,41 @@ bool Screen::hasScroll() const
     return _history->hasScroll();
 }
 
+qint64 Screen::historyMemoryUsage() const
+{
+    return _history->memoryUsage();
+}
+
+void Screen::setHistoryLoadedCallback(const std::function<void()> &callback)
+{
+    _historyLoaded = callback;
+    _history->setLoadedCallback(callback);
+}
+
+void Screen::setHistoryIndexEnabled(bool enabled)
+{
+    if (enabled == (_historyIndex != nullptr)) {
+        return;
+    }
+
+    if (enabled) {
+        _historyIndex = new TrigramIndex(_history->getLines());
+    } else {
+        delete _historyIndex;
+        _historyIndex = nullptr;
+    }
+}
+
+TrigramIndex *Screen::historyIndex() const
+{
+    return _historyIndex;
+}
+
+HistoryLineCache::Reader Screen::historyReader() const
+{
+    return _history->lineReader();
+}
+
 const HistoryType& Screen::getScroll() const
 {
     return _history->getType();
@@ -23,6 +23,9 @@
 #ifndef SCREEN_H
 #define SCREEN_H
 
+// System
+#include <functional>
+
 // Qt
 #include <QRect>
 #include <QSet>
@@ -32,6 +35,8 @@
 
 // Konsole
 #include "Character.h"
+#include "HistoryLineCache.h"
+#include "konsoleprivate_export.h"
 
 #define MODE_Origin    0
 #define MODE_Wrap      1
@@ -43,9 +48,9 @@
 
 namespace Konsole {
 class TerminalCharacterDecoder;
-class TerminalDisplay;
 class HistoryType;
 class HistoryScroll;
+class TrigramIndex;
 
 /**
     \brief An image of characters with associated attributes.
@@ -70,7 +75,7 @@ class HistoryScroll;
     using selectedText().  When getImage() is used to retrieve the visible image,
     characters which are part of the selection have their colors inverted.
 */
-class Screen
+class KONSOLEPRIVATE_EXPORT Screen
 {
 public:
     /* PlainText: Return plain text (default)
@@ -421,6 +426,30 @@ public:
      * in a history buffer.
      */
     bool hasScroll() const;
+    /** Returns the bytes of memory taken up by the history */
+    qint64 historyMemoryUsage() const;
+    /**
+     * Sets the function called when lines of the history, which getImage()
+     * has shown blank as they were still being read from a file, have
+     * become available.  It may be called on any thread.
+     */
+    void setHistoryLoadedCallback(const std::function<void()> &callback);
+
+    /**
+     * Sets whether the lines moved into the history are indexed, so that
+     * searches can skip the lines which cannot match.  Only lines added
+     * afterwards are indexed.  Indexing is off by default, sessions enable
+     * it as set in their profile.
+     */
+    void setHistoryIndexEnabled(bool enabled);
+    /** Returns the index of the history, or nullptr if it is not indexed */
+    TrigramIndex *historyIndex() const;
+    /**
+     * Returns a reader of the first lines of the history, which may be
+     * used on another thread.  It can read no lines if the history is not
+     * kept in files.
+     */
+    HistoryLineCache::Reader historyReader() const;
 
     /**
      * Sets the start of the selection.
@@ -560,16 +589,6 @@ public:
       */
     static void fillWithDefaultChar(Character *dest, int count);
 
-    void setCurrentTerminalDisplay(TerminalDisplay *display)
-    {
-        _currentTerminalDisplay = display;
-    }
-
-    TerminalDisplay *currentTerminalDisplay()
-    {
-        return _currentTerminalDisplay;
-    }
-
     QSet<uint> usedExtendedChars() const
     {
         QSet<uint> result;
@@ -617,9 +636,6 @@ private:
     // scroll down 'n' lines in current region, clearing the top 'n' lines
     void scrollDown(int from, int n);
 
-    //when we handle scroll commands, we need to know which screenwindow will scroll
-    TerminalDisplay *_currentTerminalDisplay;
-
     void addHistLine();
 
     void initTabStops();
@@ -656,6 +672,8 @@ private:
 
     // history buffer ---------------
     HistoryScroll *_history;
+    TrigramIndex *_historyIndex;
+    std::function<void()> _historyLoaded;
 
     // cursor location
     int _cuX;
@@ -20,6 +20,9 @@
 // Own
 #include "ScreenWindow.h"
 
+// Qt
+#include <QMutexLocker>
+
 // Konsole
 #include "Screen.h"
 
@@ -28,6 +31,7 @@ using namespace Konsole;
 ScreenWindow::ScreenWindow(Screen *screen, QObject *parent) :
     QObject(parent),
     _screen(nullptr),
+    _mutex(nullptr),
     _windowBuffer(nullptr),
     _windowBufferSize(0),
     _bufferNeedsUpdate(true),
@@ -57,8 +61,19 @@ Screen *ScreenWindow::screen() const
     return _screen;
 }
 
+void ScreenWindow::setMutex(QMutex *mutex)
+{
+    _mutex = mutex;
+}
+
+QMutex *ScreenWindow::mutex() const
+{
+    return _mutex;
+}
+
 Character *ScreenWindow::getImage()
 {
+    QMutexLocker locker(_mutex);
     // reallocate internal buffer if the window size has changed
     int size = windowLines() * windowColumns();
     if (_windowBuffer == nullptr || _windowBufferSize != size) {
@@ -117,6 +132,7 @@ int ScreenWindow::endWindowLine() const
 
 QVector<LineProperty> ScreenWindow::getLineProperties()
 {
+    QMutexLocker locker(_mutex);
     QVector<LineProperty> result = _screen->getLineProperties(currentLine(), endWindowLine());
 
     if (result.count() != windowLines()) {
@@ -128,23 +144,27 @@ QVector<LineProperty> ScreenWindow::getLineProperties()
 
 QString ScreenWindow::selectedText(const Screen::DecodingOptions options) const
 {
+    QMutexLocker locker(_mutex);
     return _screen->selectedText(options);
 }
 
 void ScreenWindow::getSelectionStart(int &column, int &line)
 {
+    QMutexLocker locker(_mutex);
     _screen->getSelectionStart(column, line);
     line -= currentLine();
 }
 
 void ScreenWindow::getSelectionEnd(int &column, int &line)
 {
+    QMutexLocker locker(_mutex);
     _screen->getSelectionEnd(column, line);
     line -= currentLine();
 }
 
 void ScreenWindow::setSelectionStart(int column, int line, bool columnMode)
 {
+    QMutexLocker locker(_mutex);
     _screen->setSelectionStart(column, line + currentLine(), columnMode);
 
     _bufferNeedsUpdate = true;
@@ -153,6 +173,7 @@ void ScreenWindow::setSelectionStart(int column, int line, bool columnMode)
 
 void ScreenWindow::setSelectionEnd(int column, int line)
 {
+    QMutexLocker locker(_mutex);
     _screen->setSelectionEnd(column, line + currentLine());
 
     _bufferNeedsUpdate = true;
@@ -161,6 +182,7 @@ void ScreenWindow::setSelectionEnd(int column, int line)
 
 void ScreenWindow::setSelectionByLineRange(int start, int end)
 {
+    QMutexLocker locker(_mutex);
     clearSelection();
 
     _screen->setSelectionStart(0, start, false);
@@ -172,11 +194,13 @@ void ScreenWindow::setSelectionByLineRange(int start, int end)
 
 bool ScreenWindow::isSelected(int column, int line)
 {
+    QMutexLocker locker(_mutex);
     return _screen->isSelected(column, qMin(line + currentLine(), endWindowLine()));
 }
 
 void ScreenWindow::clearSelection()
 {
+    QMutexLocker locker(_mutex);
     _screen->clearSelection();
 
     emit selectionChanged();
@@ -195,21 +219,25 @@ int ScreenWindow::windowLines() const
 
 int ScreenWindow::windowColumns() const
 {
+    QMutexLocker locker(_mutex);
     return _screen->getColumns();
 }
 
 int ScreenWindow::lineCount() const
 {
+    QMutexLocker locker(_mutex);
     return _screen->getHistLines() + _screen->getLines();
 }
 
 int ScreenWindow::columnCount() const
 {
+    QMutexLocker locker(_mutex);
     return _screen->getColumns();
 }
 
 QPoint ScreenWindow::cursorPosition() const
 {
+    QMutexLocker locker(_mutex);
     QPoint position;
 
     position.setX(_screen->getCursorX());
@@ -220,6 +248,7 @@ QPoint ScreenWindow::cursorPosition() const
 
 int ScreenWindow::currentLine() const
 {
+    QMutexLocker locker(_mutex);
     return qBound(0, _currentLine, lineCount() - windowLines());
 }
 
@@ -253,11 +282,13 @@ void ScreenWindow::scrollBy(RelativeScrollMode mode, int amount, bool fullPage)
 
 bool ScreenWindow::atEndOfOutput() const
 {
+    QMutexLocker locker(_mutex);
     return currentLine() == (lineCount() - windowLines());
 }
 
 void ScreenWindow::scrollTo(int line)
 {
+    QMutexLocker locker(_mutex);
     int maxCurrentLineNumber = lineCount() - windowLines();
     line = qBound(0, line, maxCurrentLineNumber);
 
@@ -295,6 +326,7 @@ void ScreenWindow::resetScrollCount()
 
 QRect ScreenWindow::scrollRegion() const
 {
+    QMutexLocker locker(_mutex);
     bool equalToScreenSize = windowLines() == _screen->getLines();
 
     if (atEndOfOutput() && equalToScreenSize) {
@@ -305,6 +337,7 @@ QRect ScreenWindow::scrollRegion() const
 
 void ScreenWindow::notifyOutputChanged()
 {
+    QMutexLocker locker(_mutex);
     // move window to the bottom of the screen and update scroll count
     // if this window is currently tracking the bottom of the screen
     if (_trackOutput) {
@@ -21,6 +21,7 @@
 #define SCREENWINDOW_H
 
 // Qt
+#include <QMutex>
 #include <QObject>
 #include <QPoint>
 #include <QRect>
@@ -28,6 +29,7 @@
 // Konsole
 #include "Character.h"
 #include "Screen.h"
+#include "konsoleprivate_export.h"
 
 namespace Konsole {
 
@@ -48,7 +50,7 @@ namespace Konsole {
  * be called.  This in turn will update the window's position and emit the outputChanged() signal
  * if necessary.
  */
-class ScreenWindow : public QObject
+class KONSOLEPRIVATE_EXPORT ScreenWindow : public QObject
 {
     Q_OBJECT
 
@@ -70,6 +72,17 @@ public:
     /** Returns the screen which this window looks onto */
     Screen *screen() const;
 
+    /**
+     * Sets the mutex which guards the screen, see Emulation::mutex().  The
+     * methods of the window hold it while they use the screen.
+     */
+    void setMutex(QMutex *mutex);
+    /**
+     * Returns the mutex set with setMutex(), or nullptr.  Code which uses
+     * screen() directly has to hold it.
+     */
+    QMutex *mutex() const;
+
     /**
      * Returns the image of characters which are currently visible through this window
      * onto the screen.
@@ -264,6 +277,7 @@ private:
     void fillUnusedArea();
 
     Screen *_screen; // see setScreen() , screen()
+    QMutex *_mutex;  // see setMutex() , mutex()
     Character *_windowBuffer;
     int _windowBufferSize;
     bool _bufferNeedsUpdate;
@@ -20,12 +20,46 @@
 
 #include "SearchHistoryTask.h"
 
-#include <QApplication>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QRunnable>
 #include <QTextStream>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVarLengthArray>
+
+#include <functional>
+#include <utility>
 
 #include "TerminalCharacterDecoder.h"
+#include "TrigramIndex.h"
 #include "Emulation.h"
 
+// candidate lines found with the index of the history which are no further
+// apart than this are searched together, with the lines in between
+static const int CANDIDATE_GAP = 8;
+// the properties of the lines beyond a block are looked up this many at a time
+static const int LINE_PROPERTIES_CHUNK = 64;
+
+namespace {
+class SearchBlockTask : public QRunnable
+{
+public:
+    explicit SearchBlockTask(std::function<void()> search) :
+        _search(std::move(search))
+    {
+    }
+
+    void run() override
+    {
+        _search();
+    }
+
+private:
+    std::function<void()> _search;
+};
+}
+
 namespace Konsole {
 
 void SearchHistoryTask::addScreenWindow(Session* session , ScreenWindow* searchWindow)
@@ -35,136 +69,410 @@ void SearchHistoryTask::addScreenWindow(Session* session , ScreenWindow* searchW
 
 void SearchHistoryTask::execute()
 {
-    auto iter = QMapIterator<QPointer<Session>,ScreenWindowPtr>(_windows);
+    _cancelled = false;
+    _pendingSessions = _windows.keys();
+    searchNextWindow();
+}
+
+void SearchHistoryTask::cancel()
+{
+    _cancelled = true;
+    _pendingSessions.clear();
+    _blocks.clear();
 
-    while (iter.hasNext()) {
-        iter.next();
-        executeOnScreenWindow(iter.key() , iter.value());
+    if (autoDelete()) {
+        deleteLater();
     }
 }
 
-void SearchHistoryTask::executeOnScreenWindow(const QPointer<Session> &session , const ScreenWindowPtr& window)
+void SearchHistoryTask::searchNextWindow()
 {
-    Q_ASSERT(session);
-    Q_ASSERT(window);
+    if (_pendingSessions.isEmpty()) {
+        if (autoDelete()) {
+            deleteLater();
+        }
+        return;
+    }
 
-    Emulation* emulation = session->emulation();
+    _session = _pendingSessions.takeFirst();
+    _window = _windows.value(_session);
 
-    if (!_regExp.pattern().isEmpty()) {
-        int pos = -1;
-        const bool forwards = (_direction == Enum::ForwardsSearch);
-        const int lastLine = window->lineCount() - 1;
+    Q_ASSERT(_session);
+    Q_ASSERT(_window);
 
-        int startLine;
-        if (forwards && (_startLine == lastLine)) {
-            startLine = 0;
-        } else if (!forwards && (_startLine == 0)) {
-            startLine = lastLine;
-        } else {
-            startLine = _startLine + (forwards ? 1 : -1);
-        }
+    if (_regExp.pattern().isEmpty()) {
+        emit completed(false);
+        searchNextWindow();
+        return;
+    }
+
+    const bool forwards = (_direction == Enum::ForwardsSearch);
+    _lastLine = _window->lineCount() - 1;
+
+    if (forwards && (_startLine == _lastLine)) {
+        _firstLine = 0;
+    } else if (!forwards && (_startLine == 0)) {
+        _firstLine = _lastLine;
+    } else {
+        _firstLine = _startLine + (forwards ? 1 : -1);
+    }
+
+    //setup first and last lines depending on search direction
+    _line = _firstLine;
+    _endLine = _line;
+
+    //read through and search history in blocks of 10K lines.
+    //this balances the need to retrieve lots of data from the history each time
+    //(for efficient searching)
+    //without using silly amounts of memory if the history is very large.
+    const int maxDelta = qMin(_window->lineCount(), 10000);
+    _delta = forwards ? maxDelta : -maxDelta;
+
+    // the index of the history can only be used for texts of three or more
+    // characters which every match contains
+    _literal = TrigramIndex::requiredLiteral(_regExp);
+
+    _hasWrapped = false;  // set to true when we reach the top/bottom
+    // of the output and continue from the other
+    // end
+    _blocksLeft = true;
+    _blocks.clear();
+
+    readNextBlock();
+}
+
+// reads the next block of lines from the history; the history is not
+// thread safe, so this happens on the GUI thread, one block at a time,
+// with the screen locked against the thread processing the output.  Only
+// the lines which are kept in files are left to the worker thread.
+void SearchHistoryTask::readNextBlock()
+{
+    if (_cancelled || !_blocksLeft || !_blocks.isEmpty()) {
+        return;
+    }
+
+    if (historyCleared()) {
+        _blocksLeft = false;
+        searchNextBlock();
+        return;
+    }
 
-        QString string;
-
-        //text stream to read history into string for pattern or regular expression searching
-        QTextStream searchStream(&string);
-
-        PlainTextDecoder decoder;
-        decoder.setRecordLinePositions(true);
-
-        //setup first and last lines depending on search direction
-        int line = startLine;
-
-        //read through and search history in blocks of 10K lines.
-        //this balances the need to retrieve lots of data from the history each time
-        //(for efficient searching)
-        //without using silly amounts of memory if the history is very large.
-        const int maxDelta = qMin(window->lineCount(), 10000);
-        int delta = forwards ? maxDelta : -maxDelta;
-
-        int endLine = line;
-        bool hasWrapped = false;  // set to true when we reach the top/bottom
-        // of the output and continue from the other
-        // end
-
-        //loop through history in blocks of <delta> lines.
-        do {
-            // ensure that application does not appear to hang
-            // if searching through a lengthy output
-            QApplication::processEvents();
-
-            // calculate lines to search in this iteration
-            if (hasWrapped) {
-                if (endLine == lastLine) {
-                    line = 0;
-                } else if (endLine == 0) {
-                    line = lastLine;
-                }
-
-                endLine += delta;
-
-                if (forwards) {
-                    endLine = qMin(startLine , endLine);
-                } else {
-                    endLine = qMax(startLine , endLine);
-                }
+    QMutexLocker locker(_window->mutex());
+
+    // with an index, the blocks which have no candidate lines are skipped
+    // straight away
+    TrigramIndex *index = _literal.size() >= 3 ? _window->screen()->historyIndex() : nullptr;
+
+    do {
+        // calculate lines to search in this iteration
+        if (_hasWrapped) {
+            if (_endLine == _lastLine) {
+                _line = 0;
+            } else if (_endLine == 0) {
+                _line = _lastLine;
+            }
+
+            _endLine += _delta;
+
+            if (_direction == Enum::ForwardsSearch) {
+                _endLine = qMin(_firstLine , _endLine);
             } else {
-                endLine += delta;
-
-                if (endLine > lastLine) {
-                    hasWrapped = true;
-                    endLine = lastLine;
-                } else if (endLine < 0) {
-                    hasWrapped = true;
-                    endLine = 0;
-                }
+                _endLine = qMax(_firstLine , _endLine);
+            }
+        } else {
+            _endLine += _delta;
+
+            if (_endLine > _lastLine) {
+                _hasWrapped = true;
+                _endLine = _lastLine;
+            } else if (_endLine < 0) {
+                _hasWrapped = true;
+                _endLine = 0;
             }
+        }
 
-            decoder.begin(&searchStream);
-            emulation->writeToStream(&decoder, qMin(endLine, line) , qMax(endLine, line));
-            decoder.end();
+        if (index != nullptr) {
+            readCandidateLines(index, qMin(_endLine, _line), qMax(_endLine, _line));
+        } else {
+            _blocks.append(Block{readLines(qMin(_endLine, _line), qMax(_endLine, _line))});
+        }
 
-            // line number search below assumes that the buffer ends with a new-line
-            string.append(QLatin1Char('\n'));
+        //move to the next block of text
+        _line = _endLine;
+        _blocksLeft = (_firstLine != _endLine);
+    } while (_blocks.isEmpty() && _blocksLeft);
 
-            if (forwards) {
-                pos = string.indexOf(_regExp);
-            } else {
-                pos = string.lastIndexOf(_regExp);
+    locker.unlock();
+
+    searchNextBlock();
+}
+
+SearchHistoryTask::Lines SearchHistoryTask::readLines(int startLine, int endLine)
+{
+    const Screen *screen = _window->screen();
+
+    Lines lines;
+    lines.firstLine = startLine;
+    lines.lastLine = endLine;
+    lines.history = screen->historyReader();
+    lines.fileLines = qBound(0, lines.history.lines() - startLine, endLine - startLine + 1);
+    lines.columns = screen->getColumns();
+
+    if (startLine + lines.fileLines > endLine) {
+        return lines;
+    }
+
+    //text stream to read history into string for pattern or regular expression searching
+    QTextStream searchStream(&lines.text);
+
+    PlainTextDecoder decoder;
+    decoder.setRecordLinePositions(true);
+
+    decoder.begin(&searchStream);
+    _session->emulation()->writeToStream(&decoder, startLine + lines.fileLines, endLine);
+    decoder.end();
+
+    // line number search below assumes that the buffer ends with a new-line
+    lines.text.append(QLatin1Char('\n'));
+    lines.linePositions = decoder.linePositions();
+    return lines;
+}
+
+// decodes the lines read from the files of the history the same way
+// Screen::writeLinesToStream() does, and puts them in front of the others
+void SearchHistoryTask::decodeFileLines(Lines &lines)
+{
+    if (lines.fileLines == 0) {
+        return;
+    }
+
+    QString text;
+    QTextStream stream(&text);
+    PlainTextDecoder decoder;
+    decoder.setRecordLinePositions(true);
+    decoder.begin(&stream);
+
+    QVarLengthArray<Character, 1024> buffer;
+    for (int line = lines.firstLine; line < lines.firstLine + lines.fileLines; line++) {
+        const auto block = lines.history.block(line);
+        const bool bottom = line == lines.lastLine;
+
+        buffer.clear();
+        LineProperty properties = LINE_DEFAULT;
+        if (!block.isNull()) {
+            const int length = bottom ? qMin(block->lineLength(line), lines.columns) : block->lineLength(line);
+            buffer.append(block->line(line), length);
+            if (block->isWrapped(line)) {
+                properties = LINE_WRAPPED;
             }
+        }
+        const int length = buffer.size();
+        if (!bottom && properties != LINE_WRAPPED) {
+            buffer.append(Character('\n'));
+        }
+        decoder.decodeLine(buffer.constData(), buffer.size(), properties);
+
+        // a last line shorter than the screen is selected up to its end
+        if (bottom && length < lines.columns) {
+            Character newLine('\n');
+            decoder.decodeLine(&newLine, 1, 0);
+        }
+    }
+    decoder.end();
 
-            //if a match is found, position the cursor on that line and update the screen
-            if (pos != -1) {
-                int newLines = 0;
-                QList<int> linePositions = decoder.linePositions();
-                while (newLines < linePositions.count() && linePositions[newLines] <= pos) {
-                    newLines++;
-                }
+    QList<int> linePositions = decoder.linePositions();
+    for (const int position : qAsConst(lines.linePositions)) {
+        linePositions << text.length() + position;
+    }
+    lines.text.prepend(lines.text.isEmpty() ? text + QLatin1Char('\n') : text);
+    lines.linePositions = linePositions;
+    lines.fileLines = 0;
+    lines.history = HistoryLineCache::Reader();
+}
 
-                // ignore the new line at the start of the buffer
-                newLines--;
+void SearchHistoryTask::readCandidateLines(const TrigramIndex *index, int startLine, int endLine)
+{
+    const QVector<int> candidates = index->candidateLines(_literal, startLine, endLine);
+    if (candidates.isEmpty()) {
+        return;
+    }
 
-                int findPos = qMin(line, endLine) + newLines;
+    // the lines of a wrapped line are read up to its end, also where that
+    // is in the next block, but a backwards search never reads past the
+    // line it started at
+    const bool startOfSearch = _direction == Enum::BackwardsSearch && endLine == _firstLine;
+    const int lastLine = startOfSearch ? endLine : _lastLine;
+
+    // a candidate is the first of the lines which wrap onto each other, and
+    // candidates close to each other are read together
+    const QVector<LineProperty> properties = _window->screen()->getLineProperties(startLine, endLine);
+    QVector<std::pair<int, int>> ranges;
+    for (const int line : candidates) {
+        int last = line;
+        while (last < endLine && (properties.at(last - startLine) & LINE_WRAPPED) != 0) {
+            last++;
+        }
+        if (last == endLine) {
+            last = wrappedLineEnd(endLine, lastLine);
+        }
 
-                highlightResult(window, findPos);
+        if (!ranges.isEmpty() && line <= ranges.last().second + CANDIDATE_GAP) {
+            ranges.last().second = qMax(ranges.last().second, last);
+        } else {
+            ranges.append({line, last});
+        }
+    }
 
-                emit completed(true);
+    // all of them are searched by one task
+    Block block;
+    block.reserve(ranges.size());
+    for (const auto &range : qAsConst(ranges)) {
+        block.append(readLines(range.first, range.second));
+    }
+    _blocks.append(block);
+}
 
-                return;
+// returns the last of the lines which @p line wraps onto, up to @p lastLine
+int SearchHistoryTask::wrappedLineEnd(int line, int lastLine) const
+{
+    const Screen *screen = _window->screen();
+
+    int last = line;
+    while (last < lastLine) {
+        const QVector<LineProperty> properties =
+            screen->getLineProperties(last, qMin(last + LINE_PROPERTIES_CHUNK - 1, lastLine - 1));
+        for (const LineProperty property : properties) {
+            if ((property & LINE_WRAPPED) == 0) {
+                return last;
             }
+            last++;
+        }
+    }
+    return last;
+}
+
+void SearchHistoryTask::searchNextBlock()
+{
+    if (_searching) {
+        return;
+    }
+    if (_blocks.isEmpty()) {
+        if (!_blocksLeft) {
+            windowSearched(-1);
+        }
+        return;
+    }
 
-            //clear the current block of text and move to the next one
-            string.clear();
-            line = endLine;
-        } while (startLine != endLine);
+    const Block block = _blocks.takeFirst();
+    const QRegularExpression regExp = _regExp;
+    const bool forwards = (_direction == Enum::ForwardsSearch);
+    const QPointer<SearchHistoryTask> task(this);
 
-        // if no match was found, clear selection to indicate this
-        window->clearSelection();
-        window->notifyOutputChanged();
+    _searching = true;
+    QThreadPool::globalInstance()->start(new SearchBlockTask([task, block, regExp, forwards]() mutable {
+        for (Lines &lines : block) {
+            decodeFileLines(lines);
+        }
+        const int line = findLine(block, regExp, forwards);
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [task, line]() {
+            if (!task.isNull()) {
+                task->blockSearched(line);
+            }
+        }, Qt::QueuedConnection);
+    }));
+
+    // read the next block while this one is searched
+    if (_blocksLeft) {
+        QTimer::singleShot(0, this, &Konsole::SearchHistoryTask::readNextBlock);
     }
+}
+
+void SearchHistoryTask::blockSearched(int line)
+{
+    _searching = false;
 
-    emit completed(false);
+    if (_cancelled) {
+        return;
+    }
+
+    // the line found is gone, and so are the lines still to be searched
+    if (historyCleared()) {
+        _blocks.clear();
+        _blocksLeft = false;
+        windowSearched(-1);
+        return;
+    }
+
+    if (line != -1) {
+        _blocks.clear();
+        _blocksLeft = false;
+        windowSearched(line);
+        return;
+    }
+
+    // otherwise the block being read ahead is searched once it is read
+    searchNextBlock();
+}
+
+bool SearchHistoryTask::historyCleared() const
+{
+    // the history may have been cleared while the search was running
+    return _session.isNull() || _window.isNull() || _window->lineCount() - 1 < _lastLine;
+}
+
+int SearchHistoryTask::findLine(const Block &block, const QRegularExpression &regExp, bool forwards)
+{
+    for (int i = 0; i < block.size(); i++) {
+        const int line = findLine(block.at(forwards ? i : block.size() - 1 - i), regExp, forwards);
+        if (line != -1) {
+            return line;
+        }
+    }
+    return -1;
+}
+
+int SearchHistoryTask::findLine(const Lines &lines, const QRegularExpression &regExp, bool forwards)
+{
+    int pos;
+    if (forwards) {
+        pos = lines.text.indexOf(regExp);
+    } else {
+        pos = lines.text.lastIndexOf(regExp);
+    }
+
+    if (pos == -1) {
+        return -1;
+    }
+
+    int newLines = 0;
+    while (newLines < lines.linePositions.count() && lines.linePositions[newLines] <= pos) {
+        newLines++;
+    }
+
+    // ignore the new line at the start of the buffer
+    newLines--;
+
+    return lines.firstLine + newLines;
 }
+
+void SearchHistoryTask::windowSearched(int line)
+{
+    if (!_window.isNull()) {
+        //if a match is found, position the cursor on that line and update the screen
+        if (line != -1) {
+            highlightResult(_window, line);
+        } else {
+            // if no match was found, clear selection to indicate this
+            _window->clearSelection();
+            _window->notifyOutputChanged();
+        }
+    }
+
+    emit completed(line != -1);
+
+    searchNextWindow();
+}
+
 void SearchHistoryTask::highlightResult(const ScreenWindowPtr& window , int findPos)
 {
     //work out how many lines into the current block of text the search result was found
@@ -192,6 +500,20 @@ SearchHistoryTask::SearchHistoryTask(QObject* parent)
     : SessionTask(parent)
     , _direction(Enum::BackwardsSearch)
     , _startLine(0)
+    , _literal(QString())
+    , _pendingSessions(QList<QPointer<Session>>())
+    , _session(nullptr)
+    , _window(nullptr)
+    , _firstLine(0)
+    , _lastLine(0)
+    , _line(0)
+    , _endLine(0)
+    , _delta(0)
+    , _hasWrapped(false)
+    , _blocksLeft(false)
+    , _blocks(QList<Block>())
+    , _searching(false)
+    , _cancelled(false)
 {
 }
 
@@ -21,17 +21,21 @@
 #ifndef SEARCHHISTORYTASK_H
 #define SEARCHHISTORYTASK_H
 
+#include <QList>
 #include <QPointer>
 #include <QMap>
 #include <QRegularExpression>
 
 #include "SessionTask.h"
 #include "Enumeration.h"
+#include "HistoryLineCache.h"
 #include "ScreenWindow.h"
 #include "Session.h"
+#include "konsoleprivate_export.h"
 
 namespace Konsole
 {
+class TrigramIndex;
 
 //class SearchHistoryThread;
 /**
@@ -48,7 +52,7 @@ namespace Konsole
  * TODO - Implementation requirements:
  *          May provide progress feedback to the user when searching very large output logs.
  */
-class SearchHistoryTask : public SessionTask
+class KONSOLEPRIVATE_EXPORT SearchHistoryTask : public SessionTask
 {
     Q_OBJECT
 
@@ -78,24 +82,87 @@ public:
      * Performs a search through the session's history, starting at the position
      * of the current selection, in the direction specified by setSearchDirection().
      *
+     * The history is read in blocks and each block is searched on a worker
+     * thread, so execute() returns straight away and the window stays
+     * responsive however long the history is.  The lines of a history kept
+     * in files are also read and decoded on the worker thread, only the
+     * lines on the screen and the last few of the history are read here.  completed() is emitted once the
+     * search has finished.
+     *
      * If it finds a match, the ScreenWindow specified in the constructor is
      * scrolled to the position where the match occurred and the selection
-     * is set to the matching text.  execute() then returns immediately.
+     * is set to the matching text.
      *
      * To continue the search looking for further matches, call execute() again.
      */
     void execute() override;
 
+    /**
+     * Stops a search started by execute(), for instance because a new search
+     * replaces it.  completed() is not emitted for a cancelled search.  If
+     * autoDelete() is set the task deletes itself.
+     */
+    void cancel();
+
 private:
     using ScreenWindowPtr = QPointer<ScreenWindow>;
 
-    void executeOnScreenWindow(const QPointer<Session> &session, const ScreenWindowPtr& window);
+    // the text of consecutive lines of the history
+    struct Lines {
+        QString text;
+        QList<int> linePositions;
+        int firstLine;
+        int lastLine;
+        // the number of lines at the start which are read from the files
+        // of the history by decodeFileLines(), on the worker thread; the
+        // text and positions only cover the lines after them until then
+        int fileLines;
+        HistoryLineCache::Reader history;
+        int columns;
+    };
+    // the lines searched together on a worker thread, in ascending order;
+    // a match must lie within one of them
+    using Block = QVector<Lines>;
+    static int findLine(const Lines &lines, const QRegularExpression &regExp, bool forwards);
+    static int findLine(const Block &block, const QRegularExpression &regExp, bool forwards);
+    static void decodeFileLines(Lines &lines);
+
+    void searchNextWindow();
+    void readNextBlock();
+    Lines readLines(int startLine, int endLine);
+    void readCandidateLines(const TrigramIndex *index, int startLine, int endLine);
+    int wrappedLineEnd(int line, int lastLine) const;
+    void searchNextBlock();
+    void blockSearched(int line);
+    bool historyCleared() const;
+    void windowSearched(int line);
     void highlightResult(const ScreenWindowPtr& window, int findPos);
 
     QMap< QPointer<Session>, ScreenWindowPtr > _windows;
     QRegularExpression _regExp;
     Enum::SearchDirection _direction;
     int _startLine;
+    // a text every match contains, to look up in the index of the history
+    QString _literal;
+
+    // the windows which are still to be searched
+    QList<QPointer<Session>> _pendingSessions;
+    QPointer<Session> _session;
+    ScreenWindowPtr _window;
+
+    // the state of the search through the current window, see readNextBlock()
+    int _firstLine;
+    int _lastLine;
+    int _line;
+    int _endLine;
+    int _delta;
+    bool _hasWrapped;
+    bool _blocksLeft;
+
+    // blocks read ahead while another one is being searched
+    QList<Block> _blocks;
+    bool _searching;
+    bool _cancelled;
 };
 
 }
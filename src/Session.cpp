@@ -36,6 +36,7 @@
 #include <QFile>
 #include <QStringList>
 #include <QKeyEvent>
+#include <QScreen>
 
 // KDE
 #include <KLocalizedString>
@@ -49,14 +50,18 @@
 // Konsole
 #include <sessionadaptor.h>
 
+#include "EmulationScheduler.h"
 #include "ProcessInfo.h"
 #include "Pty.h"
 #include "TerminalDisplay.h"
 #include "ShellCommand.h"
+#include "Tracer.h"
+#include "TtyRecording.h"
 #include "Vt102Emulation.h"
 #include "ZModemDialog.h"
 #include "History.h"
 #include "konsoledebug.h"
+#include "konsoleperformance.h"
 #include "SessionManager.h"
 #include "ProfileManager.h"
 #include "Profile.h"
@@ -93,6 +98,10 @@ Session::Session(QObject* parent) :
     , _iconText(QString())
     , _addToUtmp(true)
     , _flowControlEnabled(true)
+    , _readHighWaterMark(4096)
+    , _readThrottleCount(0)
+    , _recorder(nullptr)
+    , _tracer(nullptr)
     , _program(QString())
     , _arguments(QStringList())
     , _environment(QStringList())
@@ -118,9 +127,13 @@ Session::Session(QObject* parent) :
     _sessionId = ++lastSessionId;
     QDBusConnection::sessionBus().registerObject(QLatin1String("/Sessions/") + QString::number(_sessionId), this);
 
+    // deleted after the pty, which may still be using it in the reader thread
+    _tracer = new Tracer(this);
+
     //create emulation backend
     _emulation = new Vt102Emulation();
     _emulation->reset();
+    _emulation->setTracer(_tracer);
 
     connect(_emulation, &Konsole::Emulation::sessionAttributeChanged, this, &Konsole::Session::setSessionAttribute);
     connect(_emulation, &Konsole::Emulation::bell, this, [this]() {
@@ -140,6 +153,13 @@ Session::Session(QObject* parent) :
     //create new teletype for I/O with shell process
     openTeletype(-1, true);
 
+    const QString traceDirectory = QString::fromLocal8Bit(qgetenv("KONSOLE_TRACE_DIR"));
+    if (!traceDirectory.isEmpty()) {
+        startTracing(QDir(traceDirectory).filePath(QStringLiteral("konsole-%1-session-%2.json")
+                                                   .arg(QCoreApplication::applicationPid())
+                                                   .arg(_sessionId)));
+    }
+
     //setup timer for monitoring session activity & silence
     _silenceTimer = new QTimer(this);
     _silenceTimer->setSingleShot(true);
@@ -157,6 +177,7 @@ Session::~Session()
     delete _emulation;
     delete _shellProcess;
     delete _zmodemProc;
+    delete _recorder;
 }
 
 void Session::openTeletype(int fd, bool runShell)
@@ -175,6 +196,7 @@ void Session::openTeletype(int fd, bool runShell)
     }
 
     _shellProcess->setUtf8Mode(_emulation->utf8());
+    _shellProcess->setTracer(_tracer);
 
     // connect the I/O between emulator and pty process
     connect(_shellProcess, &Konsole::Pty::receivedData, this, &Konsole::Session::onReceiveBlock);
@@ -320,6 +342,13 @@ void Session::addView(TerminalDisplay* widget)
     Q_ASSERT(!_views.contains(widget));
 
     _views.append(widget);
+    widget->setTracer(_tracer);
+
+    // remember which view the key presses come from, before the emulation
+    // handles them, see scrollViewRequest() below
+    connect(widget, &Konsole::TerminalDisplay::keyPressedSignal, this, [this, widget]() {
+        _keyInputView = widget;
+    });
 
     // connect emulation - view signals and slots
     connect(widget, &Konsole::TerminalDisplay::keyPressedSignal, _emulation, &Konsole::Emulation::sendKeyEvent);
@@ -338,8 +367,23 @@ void Session::addView(TerminalDisplay* widget)
 
     widget->setBracketedPasteMode(_emulation->programBracketedPasteMode());
 
+    connect(_emulation, &Konsole::Emulation::floodModeChanged, widget, &Konsole::TerminalDisplay::setFloodMode);
+
+    widget->setFloodMode(_emulation->floodMode());
+
+    // only the view which the key press came from scrolls
+    connect(_emulation, &Konsole::Emulation::scrollViewRequest, widget,
+            [this, widget](ScreenWindow::RelativeScrollMode mode, int amount) {
+        if (_keyInputView == widget) {
+            widget->scrollScreenWindow(mode, amount);
+        }
+    });
+
     widget->setScreenWindow(_emulation->createWindow());
 
+    connect(widget, &Konsole::TerminalDisplay::screenChanged, this, &Konsole::Session::updateFrameInterval);
+    updateFrameInterval();
+
     //connect view signals and slots
     connect(widget, &Konsole::TerminalDisplay::changedContentSizeSignal, this, &Konsole::Session::onViewSizeChange);
 
@@ -353,6 +397,25 @@ void Session::addView(TerminalDisplay* widget)
     connect(widget, &Konsole::TerminalDisplay::keyPressedSignal, this, &Konsole::Session::resetNotifications);
 }
 
+void Session::updateFrameInterval()
+{
+    // There is no point in updating the views more often than the screen
+    // refreshes.  When the views are shown on screens with different
+    // refresh rates, pace the output for the fastest one so that none of
+    // them lags behind.
+    qreal refreshRate = 0;
+    for (const TerminalDisplay *view : qAsConst(_views)) {
+        const QScreen *screen = view->displayScreen();
+        if (screen != nullptr) {
+            refreshRate = qMax(refreshRate, screen->refreshRate());
+        }
+    }
+
+    if (refreshRate > 0) {
+        _emulation->setMinimumFrameInterval(qRound(1000 / refreshRate));
+    }
+}
+
 void Session::viewDestroyed(QObject* view)
 {
     auto* display = reinterpret_cast<TerminalDisplay*>(view);
@@ -365,6 +428,7 @@ void Session::viewDestroyed(QObject* view)
 void Session::removeView(TerminalDisplay* widget)
 {
     _views.removeAll(widget);
+    widget->setTracer(nullptr);
 
     disconnect(widget, nullptr, this, nullptr);
 
@@ -379,6 +443,8 @@ void Session::removeView(TerminalDisplay* widget)
     // disconnect state change signals emitted by emulation
     disconnect(_emulation, nullptr, widget, nullptr);
 
+    updateFrameInterval();
+
     // close the session automatically when the last view is removed
     if (_views.count() == 0) {
         close();
@@ -419,12 +485,15 @@ void Session::terminalWarning(const QString& message)
     static const char redPenOn[] = "\033[1m\033[31m";
     static const char redPenOff[] = "\033[0m";
 
-    _emulation->receiveData(redPenOn, qstrlen(redPenOn));
-    _emulation->receiveData("\n\r\n\r", 4);
-    _emulation->receiveData(warningText.constData(), qstrlen(warningText.constData()));
-    _emulation->receiveData(messageText.constData(), qstrlen(messageText.constData()));
-    _emulation->receiveData("\n\r\n\r", 4);
-    _emulation->receiveData(redPenOff, qstrlen(redPenOff));
+    // behind the output of the terminal program which is still queued
+    QByteArray text;
+    text.append(redPenOn);
+    text.append("\n\r\n\r");
+    text.append(warningText);
+    text.append(messageText);
+    text.append("\n\r\n\r");
+    text.append(redPenOff);
+    EmulationScheduler::instance()->receiveData(_emulation, text.constData(), text.size());
 }
 
 QString Session::shellSessionId() const
@@ -1482,7 +1551,39 @@ void Session::zmodemFinished()
 void Session::onReceiveBlock(const char* buf, int len)
 {
     handleActivity();
-    _emulation->receiveData(buf, len);
+
+    if (_recorder != nullptr) {
+        _recorder->record(buf, len);
+    }
+
+    EmulationScheduler *scheduler = EmulationScheduler::instance();
+    scheduler->receiveData(_emulation, buf, len);
+
+    // leave the output in the pty until the emulation has caught up,
+    // which blocks the process producing it
+    if (_readHighWaterMark > 0 && !_shellProcess->isReadSuspended()
+        && scheduler->pendingBytes(_emulation) > _readHighWaterMark * 1024) {
+        _shellProcess->setReadSuspended(true);
+        _readThrottleCount++;
+        qCDebug(KonsolePerformance) << "Session" << _sessionId << "suspended reading with"
+                                    << scheduler->pendingBytes(_emulation) << "bytes pending";
+
+        connect(scheduler, &Konsole::EmulationScheduler::dataProcessed,
+                this, &Konsole::Session::emulationDataProcessed, Qt::UniqueConnection);
+    }
+}
+
+void Session::emulationDataProcessed(Emulation *emulation, int pendingBytes)
+{
+    if (emulation != _emulation) {
+        return;
+    }
+
+    if (_readHighWaterMark <= 0 || pendingBytes <= _readHighWaterMark * 1024 / 2) {
+        disconnect(EmulationScheduler::instance(), &Konsole::EmulationScheduler::dataProcessed,
+                   this, &Konsole::Session::emulationDataProcessed);
+        _shellProcess->setReadSuspended(false);
+    }
 }
 
 QSize Session::size()
@@ -1583,6 +1684,16 @@ void Session::setHistorySize(int lines)
     }
 }
 
+void Session::setHistoryIndexEnabled(bool enabled)
+{
+    _emulation->setHistoryIndexEnabled(enabled);
+}
+
+bool Session::historyIndexEnabled() const
+{
+    return _emulation->historyIndexEnabled();
+}
+
 int Session::historySize() const
 {
     const HistoryType& currentHistory = historyType();
@@ -1598,6 +1709,65 @@ int Session::historySize() const
     }
 }
 
+void Session::setReadHighWaterMark(int kilobytes)
+{
+    _readHighWaterMark = qMax(0, kilobytes);
+}
+
+int Session::readHighWaterMark() const
+{
+    return _readHighWaterMark;
+}
+
+int Session::readThrottleCount() const
+{
+    return _readThrottleCount;
+}
+
+bool Session::startRecording(const QString &fileName)
+{
+    if (_recorder == nullptr) {
+        _recorder = new TtyRecorder();
+    }
+
+    if (!_recorder->open(fileName)) {
+        qCDebug(KonsoleDebug) << "Could not record to" << fileName << ":" << _recorder->errorString();
+        stopRecording();
+        return false;
+    }
+    return true;
+}
+
+void Session::stopRecording()
+{
+    delete _recorder;
+    _recorder = nullptr;
+}
+
+bool Session::isRecording() const
+{
+    return _recorder != nullptr;
+}
+
+bool Session::startTracing(const QString &fileName)
+{
+    if (!_tracer->start(fileName, QStringLiteral("Session %1").arg(_sessionId))) {
+        qCDebug(KonsoleDebug) << "Could not trace to" << fileName << ":" << _tracer->errorString();
+        return false;
+    }
+    return true;
+}
+
+void Session::stopTracing()
+{
+    _tracer->stop();
+}
+
+bool Session::isTracing() const
+{
+    return _tracer->isTracing();
+}
+
 QString Session::profile()
 {
     return SessionManager::instance()->sessionProfile(this)->name();
@@ -1745,6 +1915,7 @@ void Session::setReadOnly(bool readOnly)
 {
     if (_readOnly != readOnly) {
         _readOnly = readOnly;
+        _emulation->setReadOnly(readOnly);
 
         // Needed to update the tab icons and all
         // attached views.
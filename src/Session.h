@@ -29,6 +29,7 @@
 #include <QHash>
 #include <QUuid>
 #include <QSize>
+#include <QPointer>
 #include <QProcess>
 #include <QWidget>
 #include <QUrl>
@@ -48,6 +49,8 @@ class Emulation;
 class Pty;
 class ProcessInfo;
 class TerminalDisplay;
+class Tracer;
+class TtyRecorder;
 class ZModemDialog;
 class HistoryType;
 
@@ -625,6 +628,18 @@ public Q_SLOTS:
      */
     Q_SCRIPTABLE int historySize() const;
 
+    /**
+     * Sets whether the lines of output kept in the history of this session
+     * are indexed, so that searching a long history only reads the lines
+     * which can match.  Only lines added afterwards are indexed.
+     */
+    Q_SCRIPTABLE void setHistoryIndexEnabled(bool enabled);
+
+    /**
+     * Returns whether the history of this session is indexed.
+     */
+    Q_SCRIPTABLE bool historyIndexEnabled() const;
+
     /**
      * Sets the current session's profile
      */
@@ -635,6 +650,56 @@ public Q_SLOTS:
      */
     Q_SCRIPTABLE QString profile();
 
+    /**
+     * Sets how much output, in kilobytes, may be waiting to be processed
+     * by the terminal emulation before no more output is read from the
+     * terminal process.  Reading resumes once half of it has been
+     * processed.  0 means there is no limit.
+     */
+    Q_SCRIPTABLE void setReadHighWaterMark(int kilobytes);
+
+    /** Returns the limit set with setReadHighWaterMark() */
+    Q_SCRIPTABLE int readHighWaterMark() const;
+
+    /**
+     * Returns how often reading output from the terminal process has been
+     * suspended because the terminal emulation could not keep up with it.
+     */
+    Q_SCRIPTABLE int readThrottleCount() const;
+
+    /**
+     * Starts recording the output received from the terminal process,
+     * with the time each block of it arrived, to @p fileName.  The file
+     * uses the ttyrec format and can be replayed with the vtreplay tool.
+     *
+     * Returns false if the file could not be opened.
+     */
+    Q_SCRIPTABLE bool startRecording(const QString &fileName);
+
+    /** Stops recording the output.  See startRecording() */
+    Q_SCRIPTABLE void stopRecording();
+
+    /** Returns true if the output is being recorded.  See startRecording() */
+    Q_SCRIPTABLE bool isRecording() const;
+
+    /**
+     * Starts writing the time spent reading, decoding and parsing the
+     * output and updating and painting the views to @p fileName, in
+     * Chrome's trace event format.
+     *
+     * Every session is traced from the start if the KONSOLE_TRACE_DIR
+     * environment variable names a directory to write the traces to.
+     *
+     * Returns false if the file could not be opened.
+     */
+    Q_SCRIPTABLE bool startTracing(const QString &fileName);
+
+    /** Finishes the trace started with startTracing() */
+    Q_SCRIPTABLE void stopTracing();
+
+    /** Returns true if a trace is being written.  See startTracing() */
+    Q_SCRIPTABLE bool isTracing() const;
+
 Q_SIGNALS:
 
     /** Emitted when the terminal process starts. */
@@ -750,11 +815,15 @@ private Q_SLOTS:
     void fireZModemUploadDetected();
 
     void onReceiveBlock(const char *buf, int len);
+    void emulationDataProcessed(Konsole::Emulation *emulation, int pendingBytes);
     void silenceTimerDone();
     void activityTimerDone();
     void resetNotifications();
 
     void onViewSizeChange(int height, int width);
+    // passes the refresh interval of the screens the views are shown on
+    // to the emulation
+    void updateFrameInterval();
 
     //automatically detach views from sessions when view is destroyed
     void viewDestroyed(QObject *view);
@@ -807,6 +876,8 @@ private:
     Emulation *_emulation;
 
     QList<TerminalDisplay *> _views;
+    // the view which the last key press came from
+    QPointer<TerminalDisplay> _keyInputView;
 
     // monitor activity & silence
     bool _monitorActivity;
@@ -839,6 +910,14 @@ private:
     QString _iconText;        // not actually used
     bool _addToUtmp;
     bool _flowControlEnabled;
+    // in kilobytes
+    int _readHighWaterMark;
+    int _readThrottleCount;
+
+    // records the output, see startRecording()
+    TtyRecorder *_recorder;
+    // times the stages of the output, see startTracing()
+    Tracer *_tracer;
 
     QString _program;
     QStringList _arguments;
@@ -96,6 +96,7 @@ SessionController::SessionController(Session* session , TerminalDisplay* view, Q
     , _sessionIcon(QIcon())
     , _sessionIconName(QString())
     , _searchFilter(nullptr)
+    , _searchTask(nullptr)
     , _urlFilter(nullptr)
     , _fileFilter(nullptr)
     , _copyInputToAllTabsAction(nullptr)
@@ -764,6 +765,11 @@ void SessionController::setupExtraActions()
     action = collection->addAction(QStringLiteral("monitor-process-finish"), toggleAction);
     connect(action, &QAction::toggled, this, &Konsole::SessionController::monitorProcessFinish);
 
+    // Performance overlay
+    toggleAction = new KToggleAction(i18n("Show &Performance Overlay"), this);
+    action = collection->addAction(QStringLiteral("show-performance-overlay"), toggleAction);
+    connect(action, &QAction::toggled, this, &Konsole::SessionController::togglePerformanceOverlay);
+
     // Text Size
     action = collection->addAction(QStringLiteral("enlarge-font"), this, SLOT(increaseFontSize()));
     action->setText(i18n("Enlarge Font"));
@@ -1222,6 +1228,7 @@ void SessionController::updateFilterList(Profile::Ptr profile)
         _fileFilter = nullptr;
     } else if (underlineFiles && (_fileFilter == nullptr)) {
         _fileFilter = new FileFilter(_session);
+        connect(_fileFilter, &Konsole::FileFilter::outdated, _view.data(), &Konsole::TerminalDisplay::updateFilters);
         _view->filterChain()->addFilter(_fileFilter);
     }
 
@@ -1362,6 +1369,10 @@ void SessionController::searchHistory(bool showSearchBar)
         } else {
             setFindNextPrevEnabled(false);
 
+            if (!_searchTask.isNull()) {
+                _searchTask->cancel();
+            }
+
             removeSearchFilter();
 
             _view->setFocus(Qt::ActiveWindowFocusReason);
@@ -1410,6 +1421,11 @@ void SessionController::beginSearch(const QString& text, Enum::SearchDirection d
     QRegularExpression regExp = regexpFromSearchBarOptions();
     _searchFilter->setRegExp(regExp);
 
+    // a search still running was for the previous text or direction
+    if (!_searchTask.isNull()) {
+        _searchTask->cancel();
+    }
+
     if (_searchStartLine < 0 || _searchStartLine > _view->screenWindow()->lineCount()) {
         if (direction == Enum::ForwardsSearch) {
             setSearchStartTo(_view->screenWindow()->currentLine());
@@ -1421,6 +1437,7 @@ void SessionController::beginSearch(const QString& text, Enum::SearchDirection d
     if (!regExp.pattern().isEmpty()) {
         _view->screenWindow()->setCurrentResultLine(-1);
         auto task = new SearchHistoryTask(this);
+        _searchTask = task;
 
         connect(task, &Konsole::SearchHistoryTask::completed, this, &Konsole::SessionController::searchCompleted);
 
@@ -1620,6 +1637,13 @@ void SessionController::monitorProcessFinish(bool monitor)
 {
     _monitorProcessFinish = monitor;
 }
+
+void SessionController::togglePerformanceOverlay(bool visible)
+{
+    if (!_view.isNull()) {
+        _view->setPerformanceOverlayVisible(visible);
+    }
+}
 void SessionController::updateSessionIcon()
 {
     // If the default profile icon is being used, don't put it on the tab
@@ -54,6 +54,7 @@ class TerminalDisplay;
 class IncrementalSearchBar;
 class ProfileList;
 class RegExpFilter;
+class SearchHistoryTask;
 class UrlFilter;
 class FileFilter;
 class EditProfileDialog;
@@ -256,6 +257,7 @@ private Q_SLOTS:
     void sendForegroundColor();
     void sendBackgroundColor();
     void toggleReadOnly();
+    void togglePerformanceOverlay(bool visible);
 
     // other
     void setupSearchBar();
@@ -323,6 +325,8 @@ private:
     QString _sessionIconName;
 
     RegExpFilter *_searchFilter;
+    // the search through the history which is running, if any
+    QPointer<SearchHistoryTask> _searchTask;
     UrlFilter *_urlFilter;
     FileFilter *_fileFilter;
 
@@ -25,6 +25,7 @@
 #include "konsoledebug.h"
 
 // Qt
+#include <QMutexLocker>
 #include <QStringList>
 #include <QTextCodec>
 
@@ -37,6 +38,7 @@
 #include "ProfileManager.h"
 #include "History.h"
 #include "Enumeration.h"
+#include "ExtendedCharTable.h"
 #include "TerminalDisplay.h"
 
 using namespace Konsole;
@@ -51,10 +53,26 @@ SessionManager::SessionManager() :
     ProfileManager *profileMananger = ProfileManager::instance();
     connect(profileMananger, &Konsole::ProfileManager::profileChanged, this,
             &Konsole::SessionManager::profileChanged);
+
+    // the extended characters which are in use are those on the screens
+    // shown by any of the views
+    ExtendedCharTable::instance.usedExtendedChars = [this]() {
+        QSet<uint> usedExtendedChars;
+        for (const Session *s : qAsConst(_sessions)) {
+            const QList<TerminalDisplay *> displayList = s->views();
+            for (const TerminalDisplay *display : displayList) {
+                QMutexLocker locker(display->screenWindow()->mutex());
+                usedExtendedChars += display->screenWindow()->screen()->usedExtendedChars();
+            }
+        }
+        return usedExtendedChars;
+    };
 }
 
 SessionManager::~SessionManager()
 {
+    ExtendedCharTable::instance.usedExtendedChars = nullptr;
+
     if (!_sessions.isEmpty()) {
         qCDebug(KonsoleDebug) << "Konsole SessionManager destroyed with"
                               << _sessions.count()
@@ -269,11 +287,17 @@ void SessionManager::applyProfile(Session *session, const Profile::Ptr &profile,
             break;
         }
     }
+    if (apply.shouldApply(Profile::HistoryIndexEnabled)) {
+        session->setHistoryIndexEnabled(profile->property<bool>(Profile::HistoryIndexEnabled));
+    }
 
     // Terminal features
     if (apply.shouldApply(Profile::FlowControlEnabled)) {
         session->setFlowControlEnabled(profile->flowControlEnabled());
     }
+    if (apply.shouldApply(Profile::ReadHighWaterMark)) {
+        session->setReadHighWaterMark(profile->readHighWaterMark());
+    }
 
     // Encoding
     if (apply.shouldApply(Profile::DefaultEncoding)) {
@@ -26,6 +26,7 @@
 #include <QPointer>
 
 #include "Session.h"
+#include "konsoleprivate_export.h"
 
 namespace Konsole {
 
@@ -38,7 +39,7 @@ namespace Konsole {
  * Finally, call the execute() method to perform the sub-class specific action on each
  * of the sessions.
  */
-class SessionTask : public QObject
+class KONSOLEPRIVATE_EXPORT SessionTask : public QObject
 {
     Q_OBJECT
 
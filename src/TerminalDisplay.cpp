@@ -26,21 +26,35 @@
 // Config
 #include "config-konsole.h"
 
+// Std
+#include <algorithm>
+#include <functional>
+
 // Qt
 #include <QApplication>
 #include <QClipboard>
 #include <QKeyEvent>
 #include <QEvent>
 #include <QFileInfo>
+#include <QFontDatabase>
+#include <QLocale>
 #include <QVBoxLayout>
 #include <QAction>
 #include <QLabel>
 #include <QMimeData>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QPixmap>
+#include <QScreen>
+#include <QRunnable>
 #include <QScrollBar>
+#include <QSemaphore>
 #include <QStyle>
+#include <QThreadPool>
 #include <QTimer>
+#include <QtMath>
+#include <QVarLengthArray>
+#include <QWindow>
 #include <QDrag>
 #include <QDesktopServices>
 #include <QAccessible>
@@ -72,6 +86,7 @@
 #include "Profile.h"
 #include "ViewManager.h" // for colorSchemeForProfile. // TODO: Rewrite this.
 #include "LineBlockCharacters.h"
+#include "TrigramIndex.h"
 
 using namespace Konsole;
 
@@ -83,6 +98,35 @@ using namespace Konsole;
 // more information can be found in: https://unicode.org/reports/tr9/
 const QChar LTR_OVERRIDE_CHAR(0x202D);
 
+// the fewest lines worth handing to a thread of their own in paintThreaded()
+static const int MINIMUM_BAND_LINES = 8;
+
+// the threads which rasterize the bands of all displays
+Q_GLOBAL_STATIC(QThreadPool, renderThreadPool)
+
+namespace {
+// paints a band of a display on the render thread pool
+class BandTask : public QRunnable
+{
+public:
+    BandTask(std::function<void()> paint, QSemaphore *done) :
+        _paint(std::move(paint)),
+        _done(done)
+    {
+    }
+
+    void run() override
+    {
+        _paint();
+        _done->release();
+    }
+
+private:
+    std::function<void()> _paint;
+    QSemaphore *_done;
+};
+}
+
 inline int TerminalDisplay::loc(int x, int y) const {
     Q_ASSERT(y >= 0 && y < _lines);
     Q_ASSERT(x >= 0 && x < _columns);
@@ -255,6 +299,8 @@ void TerminalDisplay::fontChange(const QFont&)
 
     _fontAscent = fm.ascent();
 
+    updateGlyphCaches();
+
     emit changedFontMetricSignal(_fontHeight, _fontWidth);
     propagateSize();
     update();
@@ -476,13 +522,23 @@ TerminalDisplay::TerminalDisplay(QWidget* parent)
     , _filterChain(new TerminalImageFilterChain())
     , _mouseOverHotspotArea(QRegion())
     , _filterUpdateRequired(true)
+    , _floodMode(false)
     , _cursorShape(Enum::BlockCursor)
     , _cursorColor(QColor())
     , _cursorTextColor(QColor())
     , _antialiasText(true)
+    , _threadedRendering(qEnvironmentVariableIntValue("KONSOLE_THREADED_RENDERING") == 1)
+    , _backingStore(QImage())
+    , _bandGlyphCaches(QVector<GlyphCache *>())
     , _useFontLineCharacters(false)
     , _printerFriendly(false)
     , _sessionController(nullptr)
+    , _tracer(nullptr)
+    , _performanceOverlayTimer(nullptr)
+    , _performanceTotals()
+    , _performanceSampleTime(0)
+    , _performanceOverlayText(QStringList())
+    , _performanceOverlayRect(QRect())
     , _trimLeadingSpaces(false)
     , _trimTrailingSpaces(false)
     , _mouseWheelZoom(false)
@@ -525,6 +581,11 @@ TerminalDisplay::TerminalDisplay(QWidget* parent)
     _blinkCursorTimer->setInterval(QApplication::cursorFlashTime() / 2);
     connect(_blinkCursorTimer, &QTimer::timeout, this, &Konsole::TerminalDisplay::blinkCursorEvent);
 
+    // setup timer for refreshing the figures of the performance overlay
+    _performanceOverlayTimer = new QTimer(this);
+    _performanceOverlayTimer->setInterval(500);
+    connect(_performanceOverlayTimer, &QTimer::timeout, this, &Konsole::TerminalDisplay::updatePerformanceOverlay);
+
     // hide mouse cursor on keystroke or idle
     KCursor::setAutoHideCursor(this, true);
     setMouseTracking(true);
@@ -574,10 +635,13 @@ TerminalDisplay::~TerminalDisplay()
     disconnect(_blinkTextTimer);
     disconnect(_blinkCursorTimer);
 
+    setPerformanceOverlayVisible(false);
+
     delete _readOnlyMessageWidget;
     delete _outputSuspendedMessageWidget;
     delete[] _image;
     delete _filterChain;
+    qDeleteAll(_bandGlyphCaches);
 
     _readOnlyMessageWidget = nullptr;
     _outputSuspendedMessageWidget = nullptr;
@@ -618,7 +682,7 @@ void TerminalDisplay::showDragTarget(const QPoint& cursorPos)
 /* ------------------------------------------------------------------------- */
 
 void TerminalDisplay::drawLineCharString(QPainter& painter, int x, int y, const QString& str,
-        const Character* attributes)
+        const Character* attributes) const
 {
     // only turn on anti-aliasing during this short time for the "text"
     // for the normal text we have TextAntialiasing on demand on
@@ -697,7 +761,7 @@ void TerminalDisplay::setWallpaper(const ColorSchemeWallpaper::Ptr &p)
     _wallpaper = p;
 }
 
-void TerminalDisplay::drawBackground(QPainter& painter, const QRect& rect, const QColor& backgroundColor, bool useOpacitySetting)
+void TerminalDisplay::drawBackground(QPainter& painter, const QRect& rect, const QColor& backgroundColor, bool useOpacitySetting) const
 {
     // the area of the widget showing the contents of the terminal display is drawn
     // using the background color from the color scheme set with setColorTable()
@@ -732,7 +796,8 @@ void TerminalDisplay::drawCursor(QPainter& painter,
                                  const QRect& rect,
                                  const QColor& foregroundColor,
                                  const QColor& backgroundColor,
-                                 QColor& characterColor)
+                                 QColor& characterColor,
+                                 const PaintState& state) const
 {
     // don't draw cursor which is currently blinking
     if (_cursorBlinking) {
@@ -758,7 +823,7 @@ void TerminalDisplay::drawCursor(QPainter& painter,
         painter.drawRect(cursorRect.adjusted(halfWidth, halfWidth, -halfWidth, -halfWidth));
 
         // draw the cursor body only when the widget has focus
-        if (hasFocus()) {
+        if (state.hasFocus) {
             painter.fillRect(cursorRect, cursorColor);
 
             // if the cursor text color is valid then use it to draw the character under the cursor,
@@ -786,7 +851,9 @@ void TerminalDisplay::drawCharacters(QPainter& painter,
                                      const QRect& rect,
                                      const QString& text,
                                      const Character* style,
-                                     const QColor& characterColor)
+                                     const QColor& characterColor,
+                                     bool clip,
+                                     const PaintState& state) const
 {
     // don't draw text which is currently blinking
     if (_textBlinking && ((style->rendition & RE_BLINK) != 0)) {
@@ -800,7 +867,7 @@ void TerminalDisplay::drawCharacters(QPainter& painter,
 
     static constexpr int MaxFontWeight = 99; // https://doc.qt.io/qt-5/qfont.html#Weight-enum
 
-    const int normalWeight = font().weight();
+    const int normalWeight = state.font.weight();
     // +26 makes "bold" from "normal", "normal" from "light", etc. It is 26 instead of not 25 to prefer
     // bolder weight when 25 falls in the middle between two weights. See QFont::Weight
     const int boldWeight = qMin(normalWeight + 26, MaxFontWeight);
@@ -808,10 +875,10 @@ void TerminalDisplay::drawCharacters(QPainter& painter,
     const auto isBold = [boldWeight](const QFont &font) { return font.weight() >= boldWeight; };
 
     const bool useBold = (((style->rendition & RE_BOLD) != 0) && _boldIntense);
-    const bool useUnderline = ((style->rendition & RE_UNDERLINE) != 0) || font().underline();
-    const bool useItalic = ((style->rendition & RE_ITALIC) != 0) || font().italic();
-    const bool useStrikeOut = ((style->rendition & RE_STRIKEOUT) != 0) || font().strikeOut();
-    const bool useOverline = ((style->rendition & RE_OVERLINE) != 0) || font().overline();
+    const bool useUnderline = ((style->rendition & RE_UNDERLINE) != 0) || state.font.underline();
+    const bool useItalic = ((style->rendition & RE_ITALIC) != 0) || state.font.italic();
+    const bool useStrikeOut = ((style->rendition & RE_STRIKEOUT) != 0) || state.font.strikeOut();
+    const bool useOverline = ((style->rendition & RE_OVERLINE) != 0) || state.font.overline();
 
     QFont currentFont = painter.font();
 
@@ -837,11 +904,31 @@ void TerminalDisplay::drawCharacters(QPainter& painter,
         painter.setPen(color);
     }
 
-    const bool origClipping = painter.hasClipping();
-    const auto origClipRegion = painter.clipRegion();
-    painter.setClipRect(rect);
+    const bool drawLineChars = isLineCharString(text) && !_useFontLineCharacters;
+
+    // cached glyphs are cut to their cell already, so they need no clipping.
+    // Italic glyphs lean into the neighbouring cells and are never cached.
+    if (!drawLineChars && !useItalic && state.glyphCache != nullptr) {
+        int fontVariant = 0;
+        fontVariant |= useBold ? GlyphCache::Bold : 0;
+        fontVariant |= useUnderline ? GlyphCache::Underline : 0;
+        fontVariant |= useStrikeOut ? GlyphCache::StrikeOut : 0;
+        fontVariant |= useOverline ? GlyphCache::Overline : 0;
+
+        if (drawCachedGlyphs(painter, rect, text, style, color, fontVariant, state)) {
+            return;
+        }
+    }
+
+    bool origClipping = false;
+    QRegion origClipRegion;
+    if (clip) {
+        origClipping = painter.hasClipping();
+        origClipRegion = painter.clipRegion();
+        painter.setClipRect(rect);
+    }
     // draw text
-    if (isLineCharString(text) && !_useFontLineCharacters) {
+    if (drawLineChars) {
         drawLineCharString(painter, rect.x(), rect.y(), text, style);
     } else {
         // Force using LTR as the document layout for the terminal area, because
@@ -856,49 +943,57 @@ void TerminalDisplay::drawCharacters(QPainter& painter,
             painter.drawText(rect.x(), rect.y() + _fontAscent + _lineSpacing, LTR_OVERRIDE_CHAR + text);
         }
     }
-    painter.setClipRegion(origClipRegion);
-    painter.setClipping(origClipping);
+    if (clip) {
+        painter.setClipRegion(origClipRegion);
+        painter.setClipping(origClipping);
+    }
 }
 
-void TerminalDisplay::drawTextFragment(QPainter& painter ,
+bool TerminalDisplay::drawCachedGlyphs(QPainter& painter,
                                        const QRect& rect,
                                        const QString& text,
-                                       const Character* style)
-{
-    // setup painter
-    const QColor foregroundColor = style->foregroundColor.color(_colorTable);
-    const QColor backgroundColor = style->backgroundColor.color(_colorTable);
-
-    // draw background if different from the display's background color
-    if (backgroundColor != getBackgroundColor()) {
-        drawBackground(painter, rect, backgroundColor,
-                       false /* do not use transparency */);
+                                       const Character* style,
+                                       const QColor& color,
+                                       int fontVariant,
+                                       const PaintState& state) const
+{
+    // Drawing one cached glyph per cell gives the same result as drawing
+    // the text only if every character takes up one cell of a fixed pitch
+    // font, the text is not reordered by the bidi algorithm, the line is not
+    // scaled to double width or height and the glyphs are drawn onto the
+    // plain color they were cached with.
+    if (!_fixedFont || _bidiEnabled || _printerFriendly || painter.worldTransform().isScaling()
+            || (style->rendition & RE_CURSOR) != 0) {
+        return false;
     }
 
-    // draw cursor shape if the current character is the cursor
-    // this may alter the foreground and background colors
-    QColor characterColor;
-    if ((style->rendition & RE_CURSOR) != 0) {
-        drawCursor(painter, rect, foregroundColor, backgroundColor, characterColor);
+    const QColor backgroundColor = style->backgroundColor.color(_colorTable);
+    if (backgroundColor == state.backgroundColor && (qAlpha(_blendColor) < 0xff || !_wallpaper->isNull())) {
+        return false;
     }
 
-    // draw text
-    drawCharacters(painter, rect, text, style, characterColor);
-}
+    // a lone character is drawn at the start of its fragment, just as
+    // drawText() would, no matter how many cells the fragment spans
+    const QVector<uint> characters = text.toUcs4();
+    if (characters.isEmpty() || (characters.size() > 1 && characters.size() * _fontWidth != rect.width())) {
+        return false;
+    }
 
-void TerminalDisplay::drawPrinterFriendlyTextFragment(QPainter& painter,
-        const QRect& rect,
-        const QString& text,
-        const Character* style)
-{
-    // Set the colors used to draw to black foreground and white
-    // background for printer friendly output when printing
-    Character print_style = *style;
-    print_style.foregroundColor = CharacterColor(COLOR_SPACE_RGB, 0x00000000);
-    print_style.backgroundColor = CharacterColor(COLOR_SPACE_RGB, 0xFFFFFFFF);
+    QVarLengthArray<QImage, 256> glyphs;
+    glyphs.reserve(characters.size());
+    for (const uint c : characters) {
+        const QImage &glyph = state.glyphCache->glyph(c, painter.font(), fontVariant, color.rgba(),
+                                                      backgroundColor.rgba(), state.devicePixelRatio);
+        if (glyph.isNull()) {
+            return false;
+        }
+        glyphs.append(glyph);
+    }
 
-    // draw text
-    drawCharacters(painter, rect, text, &print_style, QColor());
+    for (int i = 0; i < glyphs.size(); i++) {
+        painter.drawImage(QPoint(rect.x() + i * _fontWidth, rect.y()), glyphs.at(i));
+    }
+    return true;
 }
 
 void TerminalDisplay::setRandomSeed(uint randomSeed)
@@ -1002,6 +1097,12 @@ void TerminalDisplay::scrollImage(int lines , const QRect& screenWindowRegion)
 
         //scroll internal image down
         memmove(firstCharPos , lastCharPos , bytesToMove);
+
+        // the text runs move along with the lines, the lines left behind
+        // at the bottom are segmented again when they change
+        auto runs = _textRuns.begin() + region.top();
+        std::rotate(runs, runs + lines, runs + region.height());
+        invalidateTextRuns(region.top() + linesToMove, lines);
     } else {
         // check that the memory areas that we are going to move are valid
         Q_ASSERT((char*)firstCharPos + bytesToMove <
@@ -1009,6 +1110,10 @@ void TerminalDisplay::scrollImage(int lines , const QRect& screenWindowRegion)
 
         //scroll internal image up
         memmove(lastCharPos , firstCharPos , bytesToMove);
+
+        auto runs = _textRuns.begin() + region.top();
+        std::rotate(runs, runs + linesToMove, runs + region.height());
+        invalidateTextRuns(region.top(), -lines);
     }
 
     //scroll the display vertically to match internal _image
@@ -1057,6 +1162,14 @@ void TerminalDisplay::processFilters()
         return;
     }
 
+    // the text is scrolling past too fast for links or search results to be
+    // of any use; the filters are run again once the output has calmed down
+    if (_floodMode) {
+        return;
+    }
+
+    TraceScope trace(_tracer, Tracer::FilterStage);
+
     QRegion preUpdateHotSpots = hotSpotRegion();
 
     // use _screenWindow->getImage() here rather than _image because
@@ -1068,7 +1181,18 @@ void TerminalDisplay::processFilters()
                            _screenWindow->windowLines(),
                            _screenWindow->windowColumns(),
                            _screenWindow->getLineProperties());
-    _filterChain->process();
+
+    // the hotspots on the lines which changed appear once the search on
+    // the worker thread is done, rather than holding up this frame
+    _filterChain->processInBackground([this](bool processed) {
+        if (processed) {
+            update(hotSpotRegion());
+        } else {
+            // the screen moved on while the search was running
+            _filterUpdateRequired = true;
+            processFilters();
+        }
+    });
 
     QRegion postUpdateHotSpots = hotSpotRegion();
 
@@ -1076,12 +1200,24 @@ void TerminalDisplay::processFilters()
     _filterUpdateRequired = false;
 }
 
+void TerminalDisplay::updateFilters()
+{
+    _filterUpdateRequired = true;
+    processFilters();
+}
+
 void TerminalDisplay::updateImage()
 {
     if (_screenWindow.isNull()) {
         return;
     }
 
+    TraceScope trace(_tracer, Tracer::UpdateStage);
+
+    // the output may be processed meanwhile, so the screen is locked
+    // while it is copied; the rest works on the copy
+    QMutexLocker locker(_screenWindow->mutex());
+
     // optimization - scroll the existing image where possible and
     // avoid expensive text drawing for parts of the image that
     // can simply be moved up or down
@@ -1097,12 +1233,18 @@ void TerminalDisplay::updateImage()
         updateImageSize();
     }
 
-    Character* const newimg = _screenWindow->getImage();
+    Character* newimg;
+    {
+        TraceScope imageTrace(_tracer, Tracer::ImageStage);
+        newimg = _screenWindow->getImage();
+    }
     const int lines = _screenWindow->windowLines();
     const int columns = _screenWindow->windowColumns();
 
     setScroll(_screenWindow->currentLine() , _screenWindow->lineCount());
 
+    locker.unlock();
+
     Q_ASSERT(_usedLines <= _lines);
     Q_ASSERT(_usedColumns <= _columns);
 
@@ -1131,6 +1273,7 @@ void TerminalDisplay::updateImage()
         const Character* const newLine = &newimg[y * columns];
 
         bool updateLine = false;
+        bool lineChanged = false;
 
         // The dirty mask indicates which characters need repainting. We also
         // mark surrounding neighbors dirty, in case the character exceeds
@@ -1140,8 +1283,12 @@ void TerminalDisplay::updateImage()
         for (x = 0 ; x < columnsToUpdate ; ++x) {
             if (newLine[x] != currentLine[x]) {
                 dirtyMask[x] = 1;
+                lineChanged = true;
             }
         }
+        if (lineChanged) {
+            invalidateTextRuns(y, 1);
+        }
 
         if (!_resizing) { // not while _resizing, we're expecting a paintEvent
             for (x = 0; x < columnsToUpdate; ++x) {
@@ -1181,17 +1328,7 @@ void TerminalDisplay::updateImage()
                         }
                     }
 
-                    const bool saveFixedFont = _fixedFont;
-                    if (lineDraw) {
-                        _fixedFont = false;
-                    }
-                    if (doubleWidth) {
-                        _fixedFont = false;
-                    }
-
                     updateLine = true;
-
-                    _fixedFont = saveFixedFont;
                     x += len - 1;
                 }
             }
@@ -1241,6 +1378,9 @@ void TerminalDisplay::updateImage()
                              _fontWidth * (_usedColumns - columnsToUpdate) ,
                              _fontHeight * _lines);
     }
+    if (columnsToUpdate != _usedColumns) {
+        invalidateAllTextRuns();
+    }
     _usedColumns = columnsToUpdate;
 
     dirtyRegion |= _inputMethodData.previousPreeditRect;
@@ -1252,6 +1392,10 @@ void TerminalDisplay::updateImage()
         dirtyRegion |= QRect(0, _contentRect.top() + (_screenWindow->currentResultLine() - _screenWindow->currentLine()) * _fontHeight,
                              _columns * _fontWidth, _fontHeight);
     }
+    if (!_tracer.isNull() && _tracer->isActive()) {
+        _tracer->addCount(Tracer::ScrolledLinesCounter, qAbs(_screenWindow->scrollCount()));
+        _tracer->addCount(Tracer::DirtyLinesCounter, dirtyLineCount);
+    }
     _screenWindow->resetScrollCount();
 
 
@@ -1268,10 +1412,15 @@ void TerminalDisplay::updateImage()
     delete[] dirtyMask;
 
 #ifndef QT_NO_ACCESSIBILITY
-    QAccessibleEvent dataChangeEvent(this, QAccessible::VisibleDataChanged);
-    QAccessible::updateAccessibility(&dataChangeEvent);
-    QAccessibleTextCursorEvent cursorEvent(this, _usedColumns * screenWindow()->screen()->getCursorY() + screenWindow()->screen()->getCursorX());
-    QAccessible::updateAccessibility(&cursorEvent);
+    // while flooded the screen reader would only be told about text that
+    // is gone a moment later; it is updated when the output stops
+    if (!_floodMode) {
+        QAccessibleEvent dataChangeEvent(this, QAccessible::VisibleDataChanged);
+        QAccessible::updateAccessibility(&dataChangeEvent);
+        const QPoint cursor = _screenWindow->cursorPosition();
+        QAccessibleTextCursorEvent cursorEvent(this, _usedColumns * cursor.y() + cursor.x());
+        QAccessible::updateAccessibility(&cursorEvent);
+    }
 #endif
 }
 
@@ -1302,6 +1451,8 @@ void TerminalDisplay::showResizeNotification()
 
 void TerminalDisplay::paintEvent(QPaintEvent* pe)
 {
+    TraceScope trace(_tracer, Tracer::PaintStage);
+
     QPainter paint(this);
 
     // Determine which characters should be repainted (1 region unit = 1 character)
@@ -1310,19 +1461,23 @@ void TerminalDisplay::paintEvent(QPaintEvent* pe)
 
     for (const QRect &rect : region) {
         dirtyImageRegion += widgetToImage(rect);
-        drawBackground(paint, rect, getBackgroundColor(), true /* use opacity setting */);
     }
 
-    // only turn on text anti-aliasing, never turn on normal antialiasing
-    // set https://bugreports.qt.io/browse/QTBUG-66036
-    paint.setRenderHint(QPainter::TextAntialiasing, _antialiasText);
+    segmentLines(dirtyImageRegion);
+    if (!_threadedRendering || !paintThreaded(paint, region, dirtyImageRegion)) {
+        for (const QRect &rect : region) {
+            drawBackground(paint, rect, getBackgroundColor(), true /* use opacity setting */);
+        }
 
-    for (const QRect &rect : qAsConst(dirtyImageRegion)) {
-        drawContents(paint, rect);
+        // only turn on text anti-aliasing, never turn on normal antialiasing
+        // set https://bugreports.qt.io/browse/QTBUG-66036
+        paint.setRenderHint(QPainter::TextAntialiasing, _antialiasText);
+
+        drawContents(paint, dirtyImageRegion, paintState(&_glyphCache));
     }
     drawCurrentResultRect(paint);
     drawInputMethodPreeditString(paint, preeditRect());
-    paintFilters(paint);
+    paintFilters(paint, dirtyImageRegion);
 
     const bool drawDimmed = _dimWhenInactive && !hasFocus();
     const QColor dimColor(0, 0, 0, 128);
@@ -1344,6 +1499,167 @@ void TerminalDisplay::paintEvent(QPaintEvent* pe)
         paint.setBrush(QColor(100,100,100, 127));
         paint.drawRect(rect);
     }
+
+    if (isPerformanceOverlayVisible()) {
+        drawPerformanceOverlay(paint);
+    }
+}
+
+bool TerminalDisplay::paintThreaded(QPainter& painter, const QRegion& region, const QRegion& imageRegion)
+{
+    // the wallpaper is drawn from a QPixmap, which can only be used on the
+    // GUI thread, and the top half of a double height line would be cut
+    // off at the bottom of its band
+    if (!QFontDatabase::supportsThreadedFontRendering() || !_wallpaper->isNull() || _image == nullptr) {
+        return false;
+    }
+    for (const LineProperty lineProperty : qAsConst(_lineProperties)) {
+        if ((lineProperty & LINE_DOUBLEHEIGHT) != 0) {
+            return false;
+        }
+    }
+
+    const QRect imageBounds = imageRegion.boundingRect();
+    const int firstLine = qMax(imageBounds.top(), 0);
+    const int lastLine = qMin(imageBounds.bottom(), _textRuns.size() - 1);
+    const int lineCount = lastLine - firstLine + 1;
+    const int bandCount = qMin(renderThreadPool()->maxThreadCount() + 1, lineCount / MINIMUM_BAND_LINES);
+    if (bandCount < 2) {
+        return false;
+    }
+
+    const qreal devicePixelRatio = devicePixelRatioF();
+    const QSize storeSize(qCeil(width() * devicePixelRatio), qCeil(height() * devicePixelRatio));
+    if (_backingStore.size() != storeSize || _backingStore.devicePixelRatio() != devicePixelRatio) {
+        _backingStore = QImage(storeSize, QImage::Format_ARGB32_Premultiplied);
+        _backingStore.setDevicePixelRatio(devicePixelRatio);
+    }
+
+    while (_bandGlyphCaches.size() < bandCount - 1) {
+        auto glyphCache = new GlyphCache();
+        glyphCache->setCellSize(_fontWidth, _fontHeight, _fontAscent + _lineSpacing);
+        glyphCache->setAntialias(_antialiasText);
+        _bandGlyphCaches.append(glyphCache);
+    }
+
+    // the first and the last band extend to the edges of the widget, so
+    // that they include the margins.  Each band gets a copy of the state
+    // of the widget, taken here, as QWidget must not be used by the pool.
+    const PaintState state = paintState(&_glyphCache);
+    const int contentTop = state.contentsOrigin.y();
+    uchar *const bits = _backingStore.bits();
+    QVector<RenderBand> bands;
+    bands.reserve(bandCount);
+    int bandFirstLine = firstLine;
+    int top = 0;
+    int pixelTop = 0;
+    for (int band = 0; band < bandCount; band++) {
+        const bool lastBand = band == bandCount - 1;
+        const int bandLastLine = lastBand ? lastLine : firstLine + lineCount * (band + 1) / bandCount - 1;
+        const int bottom = lastBand ? height() : contentTop + (bandLastLine + 1) * _fontHeight;
+        const int pixelBottom = lastBand ? storeSize.height() : qRound(bottom * devicePixelRatio);
+
+        PaintState bandState = state;
+        bandState.glyphCache = band == 0 ? &_glyphCache : _bandGlyphCaches.at(band - 1);
+        bands.append(RenderBand{bits + pixelTop * _backingStore.bytesPerLine(),
+                                pixelBottom - pixelTop,
+                                pixelTop / devicePixelRatio,
+                                region & QRect(0, top, width(), bottom - top),
+                                imageRegion & QRect(0, bandFirstLine, _columns, bandLastLine - bandFirstLine + 1),
+                                bandFirstLine,
+                                bandState});
+
+        bandFirstLine = bandLastLine + 1;
+        top = bottom;
+        pixelTop = pixelBottom;
+    }
+
+    // the GUI thread paints the first band itself
+    QSemaphore bandsDone;
+    for (int band = 1; band < bandCount; band++) {
+        renderThreadPool()->start(new BandTask([this, &bands, band]() { paintBand(bands.at(band)); },
+                                               &bandsDone));
+    }
+    paintBand(bands.at(0));
+    bandsDone.acquire(bandCount - 1);
+
+    // a glyph which overhangs its cell, e.g. an italic letter or a
+    // descender, is cut off by the clip of its band where it reaches into
+    // the neighbouring band.  The last line above and the first line below
+    // each boundary are therefore drawn again, together with the lines
+    // next to them, whose glyphs may reach into the two.
+    {
+        QPainter storePainter(&_backingStore);
+        storePainter.setFont(state.font);
+        storePainter.setRenderHint(QPainter::TextAntialiasing, _antialiasText);
+        for (int band = 1; band < bandCount; band++) {
+            const int line = bands.at(band).firstLine;
+            const QRegion boundary = region & QRect(0, contentTop + (line - 1) * _fontHeight, width(), 2 * _fontHeight);
+            if (boundary.isEmpty()) {
+                continue;
+            }
+            storePainter.setClipRegion(boundary);
+            for (const QRect &rect : boundary) {
+                drawBackground(storePainter, rect, state.backgroundColor, true /* use opacity setting */);
+            }
+            drawContents(storePainter, imageRegion & QRect(0, line - 2, _columns, 4), state);
+        }
+    }
+
+    const QPainter::CompositionMode originalMode = painter.compositionMode();
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (const QRect &rect : region) {
+        painter.drawImage(QRectF(rect), _backingStore,
+                          QRectF(QPointF(rect.topLeft()) * devicePixelRatio, QSizeF(rect.size()) * devicePixelRatio));
+    }
+    painter.setCompositionMode(originalMode);
+
+    return true;
+}
+
+void TerminalDisplay::paintBand(const RenderBand& band) const
+{
+    QImage image(band.bits, _backingStore.width(), band.pixelHeight, _backingStore.bytesPerLine(),
+                 _backingStore.format());
+    image.setDevicePixelRatio(band.state.devicePixelRatio);
+
+    QPainter painter(&image);
+    painter.setFont(band.state.font);
+    painter.translate(0, -band.top);
+    painter.setClipRegion(band.region);
+
+    for (const QRect &rect : band.region) {
+        drawBackground(painter, rect, band.state.backgroundColor, true /* use opacity setting */);
+    }
+
+    painter.setRenderHint(QPainter::TextAntialiasing, _antialiasText);
+    drawContents(painter, band.imageRegion, band.state);
+}
+
+void TerminalDisplay::setThreadedRendering(bool enabled)
+{
+    _threadedRendering = enabled;
+    if (!enabled) {
+        _backingStore = QImage();
+        qDeleteAll(_bandGlyphCaches);
+        _bandGlyphCaches.clear();
+    }
+    update();
+}
+
+bool TerminalDisplay::threadedRendering() const
+{
+    return _threadedRendering;
+}
+
+void TerminalDisplay::updateGlyphCaches()
+{
+    _glyphCache.setCellSize(_fontWidth, _fontHeight, _fontAscent + _lineSpacing);
+    _glyphCache.setAntialias(_antialiasText);
+    for (GlyphCache *glyphCache : qAsConst(_bandGlyphCaches)) {
+        glyphCache->setCellSize(_fontWidth, _fontHeight, _fontAscent + _lineSpacing);
+        glyphCache->setAntialias(_antialiasText);
+    }
 }
 
 void TerminalDisplay::printContent(QPainter& painter, bool friendly)
@@ -1362,7 +1678,8 @@ void TerminalDisplay::printContent(QPainter& painter, bool friendly)
         drawBackground(painter, rect, getBackgroundColor(),
                        true /* use opacity setting */);
     }
-    drawContents(painter, rect);
+    segmentLines(rect);
+    drawContents(painter, rect, paintState(&_glyphCache));
     _printerFriendly = false;
     setVTFont(savedFont);
 }
@@ -1387,7 +1704,7 @@ FilterChain* TerminalDisplay::filterChain() const
     return _filterChain;
 }
 
-void TerminalDisplay::paintFilters(QPainter& painter)
+void TerminalDisplay::paintFilters(QPainter& painter, const QRegion &dirtyImageRegion)
 {
     if (_filterUpdateRequired) {
         return;
@@ -1404,126 +1721,117 @@ void TerminalDisplay::paintFilters(QPainter& painter)
 
     painter.setPen(QPen(cursorCharacter.foregroundColor.color(_colorTable)));
 
-    // iterate over hotspots identified by the display's currently active filters
-    // and draw appropriate visuals to indicate the presence of the hotspot
+    const QFontMetrics metrics(font());
+    const int hotSpotCount = _filterChain->hotSpotCount();
 
-    const auto spots = _filterChain->hotSpots();
-    int urlNumber, urlNumInc;
-    if (_reverseUrlHints) {
-        urlNumber = spots.size() + 1;
-        urlNumInc = -1;
-    } else {
-        urlNumber = 0;
-        urlNumInc = 1;
-    }
-    for (const auto &spot : spots) {
-        urlNumber += urlNumInc;
+    // the area of a hotspot on one line, as used for the mouse-over test
+    const auto spotLineRect = [this](const Filter::HotSpot &spot, int line) {
+        QRect r;
+        r.setCoords((line == spot.startLine() ? spot.startColumn() : 0) * _fontWidth + _contentRect.left(),
+                    line * _fontHeight + _contentRect.top(),
+                    (line == spot.endLine() ? spot.endColumn() : _columns) * _fontWidth + _contentRect.left() - 1,
+                    (line + 1) * _fontHeight + _contentRect.top() - 1);
+        return r;
+    };
+    const int mouseOverLine = (cursorPos.y() - _contentRect.top()) / _fontHeight;
+    const auto isMouseOver = [&](const Filter::HotSpot &spot) {
+        return mouseOverLine >= spot.startLine() && mouseOverLine <= spot.endLine()
+               && spotLineRect(spot, mouseOverLine).contains(cursorPos);
+    };
 
-        QRegion region;
-        if (spot->type() == Filter::HotSpot::Link) {
-            QRect r;
-            if (spot->startLine() == spot->endLine()) {
-                r.setCoords(spot->startColumn()*_fontWidth + _contentRect.left(),
-                            spot->startLine()*_fontHeight + _contentRect.top(),
-                            (spot->endColumn())*_fontWidth + _contentRect.left() - 1,
-                            (spot->endLine() + 1)*_fontHeight + _contentRect.top() - 1);
-                region |= r;
-            } else {
-                r.setCoords(spot->startColumn()*_fontWidth + _contentRect.left(),
-                            spot->startLine()*_fontHeight + _contentRect.top(),
-                            (_columns)*_fontWidth + _contentRect.left() - 1,
-                            (spot->startLine() + 1)*_fontHeight + _contentRect.top() - 1);
-                region |= r;
-                for (int line = spot->startLine() + 1 ; line < spot->endLine() ; line++) {
-                    r.setCoords(0 * _fontWidth + _contentRect.left(),
-                                line * _fontHeight + _contentRect.top(),
-                                (_columns)*_fontWidth + _contentRect.left() - 1,
-                                (line + 1)*_fontHeight + _contentRect.top() - 1);
-                    region |= r;
-                }
-                r.setCoords(0 * _fontWidth + _contentRect.left(),
-                            spot->endLine()*_fontHeight + _contentRect.top(),
-                            (spot->endColumn())*_fontWidth + _contentRect.left() - 1,
-                            (spot->endLine() + 1)*_fontHeight + _contentRect.top() - 1);
-                region |= r;
-            }
+    // draw appropriate visuals to indicate the presence of the hotspots
+    // identified by the display's currently active filters, visiting
+    // only those on the lines being repainted
+    const auto paintLine = [&](const QSharedPointer<Filter::HotSpot> &spot, int index, int line) {
+        // Check image size so _image[] is valid (see makeImage)
+        if (line >= _lines) {
+            return;
+        }
 
-            if (_showUrlHint && urlNumber < 10) {
+        if (spot->type() == Filter::HotSpot::Link && _showUrlHint && line == spot->startLine()) {
+            const int urlNumber = _reverseUrlHints ? hotSpotCount - index : index + 1;
+            if (urlNumber < 10) {
                 // Position at the beginning of the URL
-                QRect hintRect(*region.begin());
-                hintRect.setWidth(r.height());
+                QRect hintRect = spotLineRect(*spot, line);
+                hintRect.setWidth(_fontHeight);
+                painter.save();
                 painter.fillRect(hintRect, QColor(0, 0, 0, 128));
                 painter.setPen(Qt::white);
                 painter.drawRect(hintRect.adjusted(0, 0, -1, -1));
                 painter.drawText(hintRect, Qt::AlignCenter, QString::number(urlNumber));
+                painter.restore();
             }
         }
 
-        for (int line = spot->startLine() ; line <= spot->endLine() ; line++) {
-            int startColumn = 0;
-            int endColumn = _columns - 1; // TODO use number of _columns which are actually
-            // occupied on this line rather than the width of the
-            // display in _columns
+        int startColumn = 0;
+        int endColumn = _columns - 1; // TODO use number of _columns which are actually
+        // occupied on this line rather than the width of the
+        // display in _columns
 
-            // Check image size so _image[] is valid (see makeImage)
-            if (endColumn >= _columns || line >= _lines) {
-                break;
-            }
+        // ignore whitespace at the end of the lines
+        while (_image[loc(endColumn, line)].isSpace() && endColumn > 0) {
+            endColumn--;
+        }
 
-            // ignore whitespace at the end of the lines
-            while (_image[loc(endColumn, line)].isSpace() && endColumn > 0) {
-                endColumn--;
-            }
+        // increment here because the column which we want to set 'endColumn' to
+        // is the first whitespace character at the end of the line
+        endColumn++;
 
-            // increment here because the column which we want to set 'endColumn' to
-            // is the first whitespace character at the end of the line
-            endColumn++;
+        if (line == spot->startLine()) {
+            startColumn = spot->startColumn();
+        }
+        if (line == spot->endLine()) {
+            endColumn = spot->endColumn();
+        }
 
-            if (line == spot->startLine()) {
-                startColumn = spot->startColumn();
-            }
-            if (line == spot->endLine()) {
-                endColumn = spot->endColumn();
+        // TODO: resolve this comment with the new margin/center code
+        // subtract one pixel from
+        // the right and bottom so that
+        // we do not overdraw adjacent
+        // hotspots
+        //
+        // subtracting one pixel from all sides also prevents an edge case where
+        // moving the mouse outside a link could still leave it underlined
+        // because the check below for the position of the cursor
+        // finds it on the border of the target area
+        QRect r;
+        r.setCoords(startColumn * _fontWidth + _contentRect.left(),
+                    line * _fontHeight + _contentRect.top(),
+                    endColumn * _fontWidth + _contentRect.left() - 1,
+                    (line + 1)*_fontHeight + _contentRect.top() - 1);
+        // Underline link hotspots
+        if (spot->type() == Filter::HotSpot::Link) {
+            // find the baseline (which is the invisible line that the characters in the font sit on,
+            // with some having tails dangling below)
+            const int baseline = r.bottom() - metrics.descent();
+            // find the position of the underline below that
+            const int underlinePos = baseline + metrics.underlinePos();
+            if (_showUrlHint || isMouseOver(*spot)) {
+                painter.drawLine(r.left() , underlinePos ,
+                                 r.right() , underlinePos);
             }
 
-            // TODO: resolve this comment with the new margin/center code
-            // subtract one pixel from
-            // the right and bottom so that
-            // we do not overdraw adjacent
-            // hotspots
-            //
-            // subtracting one pixel from all sides also prevents an edge case where
-            // moving the mouse outside a link could still leave it underlined
-            // because the check below for the position of the cursor
-            // finds it on the border of the target area
-            QRect r;
-            r.setCoords(startColumn * _fontWidth + _contentRect.left(),
-                        line * _fontHeight + _contentRect.top(),
-                        endColumn * _fontWidth + _contentRect.left() - 1,
-                        (line + 1)*_fontHeight + _contentRect.top() - 1);
-            // Underline link hotspots
-            if (spot->type() == Filter::HotSpot::Link) {
-                QFontMetrics metrics(font());
-
-                // find the baseline (which is the invisible line that the characters in the font sit on,
-                // with some having tails dangling below)
-                const int baseline = r.bottom() - metrics.descent();
-                // find the position of the underline below that
-                const int underlinePos = baseline + metrics.underlinePos();
-                if (_showUrlHint || region.contains(mapFromGlobal(QCursor::pos()))) {
-                    painter.drawLine(r.left() , underlinePos ,
-                                     r.right() , underlinePos);
-                }
+            // Marker hotspots simply have a transparent rectangular shape
+            // drawn on top of them
+        } else if (spot->type() == Filter::HotSpot::Marker) {
+            //TODO - Do not use a hardcoded color for this
+            const bool isCurrentResultLine = (_screenWindow->currentResultLine() == (spot->startLine() + _screenWindow->currentLine()));
+            QColor color = isCurrentResultLine ? QColor(255, 255, 0, 120) : QColor(255, 0, 0, 120);
+            painter.fillRect(r, color);
+        }
+    };
 
-                // Marker hotspots simply have a transparent rectangular shape
-                // drawn on top of them
-            } else if (spot->type() == Filter::HotSpot::Marker) {
-                //TODO - Do not use a hardcoded color for this
-                const bool isCurrentResultLine = (_screenWindow->currentResultLine() == (spot->startLine() + _screenWindow->currentLine()));
-                QColor color = isCurrentResultLine ? QColor(255, 255, 0, 120) : QColor(255, 0, 0, 120);
-                painter.fillRect(r, color);
-            }
+    // the rectangles of a region are sorted by their top edge and rectangles
+    // side by side share the same lines, so each line is visited once
+    int lastLine = -1;
+    for (const QRect &rect : dirtyImageRegion) {
+        const int bottom = qMin(rect.bottom(), _lines - 1);
+        for (int line = qMax(rect.top(), lastLine + 1); line <= bottom; line++) {
+            _filterChain->visitHotSpotsAtLine(line, [&](const QSharedPointer<Filter::HotSpot> &spot, int index) {
+                paintLine(spot, index, line);
+            });
         }
+        lastLine = qMax(lastLine, bottom);
     }
 }
 
@@ -1538,163 +1846,233 @@ static uint baseCodePoint(const Character &ch) {
     }
 }
 
-void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
+void TerminalDisplay::segmentLine(int y, QVector<TextRun> &runs) const
 {
+    runs.clear();
+
+    const Character *line = &_image[loc(0, y)];
     const int numberOfColumns = _usedColumns;
     QVector<uint> univec;
     univec.reserve(numberOfColumns);
-    for (int y = rect.y(); y <= rect.bottom(); y++) {
-        int x = rect.x();
-        if ((_image[loc(rect.x(), y)].character == 0u) && (x != 0)) {
-            x--; // Search for start of multi-column character
-        }
-        for (; x <= rect.right(); x++) {
-            int len = 1;
-            int p = 0;
-
-            // reset our buffer to the number of columns
-            int bufferSize = numberOfColumns;
-            univec.resize(bufferSize);
-            uint *disstrU = univec.data();
-
-            // is this a single character or a sequence of characters ?
-            if ((_image[loc(x, y)].rendition & RE_EXTENDED_CHAR) != 0) {
-                // sequence of characters
-                ushort extendedCharLength = 0;
-                const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(_image[loc(x, y)].character, extendedCharLength);
-                if (chars != nullptr) {
-                    Q_ASSERT(extendedCharLength > 1);
-                    bufferSize += extendedCharLength - 1;
-                    univec.resize(bufferSize);
-                    disstrU = univec.data();
-                    for (int index = 0 ; index < extendedCharLength ; index++) {
-                        Q_ASSERT(p < bufferSize);
-                        disstrU[p++] = chars[index];
-                    }
-                }
-            } else {
-                // single character
-                const uint c = _image[loc(x, y)].character;
-                if (c != 0u) {
-                    Q_ASSERT(p < bufferSize);
-                    disstrU[p++] = c;
-                }
-            }
 
-            const bool lineDraw = LineBlockCharacters::canDraw(_image[loc(x, y)].character);
-            const bool doubleWidth = (_image[qMin(loc(x, y) + 1, _imageSize - 1)].character == 0);
-            const CharacterColor currentForeground = _image[loc(x, y)].foregroundColor;
-            const CharacterColor currentBackground = _image[loc(x, y)].backgroundColor;
-            const RenditionFlags currentRendition = _image[loc(x, y)].rendition;
-            const QChar::Script currentScript = QChar::script(baseCodePoint(_image[loc(x, y)]));
-
-            const auto isInsideDrawArea = [&](int column) { return column <= rect.right(); };
-            const auto hasSameColors = [&](int column) {
-                return _image[loc(column, y)].foregroundColor == currentForeground
-                    && _image[loc(column, y)].backgroundColor == currentBackground;
-            };
-            const auto hasSameRendition = [&](int column) {
-                return (_image[loc(column, y)].rendition & ~RE_EXTENDED_CHAR)
-                    == (currentRendition & ~RE_EXTENDED_CHAR);
-            };
-            const auto hasSameWidth = [&](int column) {
-                const int characterLoc = qMin(loc(column, y) + 1, _imageSize - 1);
-                return (_image[characterLoc].character == 0) == doubleWidth;
-            };
-            const auto hasSameLineDrawStatus = [&](int column) {
-                return LineBlockCharacters::canDraw(_image[loc(column, y)].character)
-                    == lineDraw;
-            };
-            const auto isSameScript = [&](int column) {
-                const QChar::Script script = QChar::script(baseCodePoint(_image[loc(column, y)]));
-                if (currentScript == QChar::Script_Common || script == QChar::Script_Common
-                    || currentScript == QChar::Script_Inherited || script == QChar::Script_Inherited) {
-                    return true;
+    const auto appendCharacter = [&](const Character &ch) {
+        if ((ch.rendition & RE_EXTENDED_CHAR) != 0) {
+            // sequence of characters
+            ushort extendedCharLength = 0;
+            const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(ch.character, extendedCharLength);
+            if (chars != nullptr) {
+                Q_ASSERT(extendedCharLength > 1);
+                for (int index = 0 ; index < extendedCharLength ; index++) {
+                    univec.append(chars[index]);
                 }
-                return currentScript == script;
-            };
-            const auto canBeGrouped = [&](int column) {
-                return _image[loc(column, y)].character <= 0x7e
-                       || (_image[loc(column, y)].rendition & RE_EXTENDED_CHAR)
-                       || (_bidiEnabled && !doubleWidth);
-            };
-
-            if (canBeGrouped(x)) {
-                while (isInsideDrawArea(x + len) && hasSameColors(x + len)
-                       && hasSameRendition(x + len) && hasSameWidth(x + len)
-                       && hasSameLineDrawStatus(x + len) && isSameScript(x + len)
-                       && canBeGrouped(x + len)) {
-                    const uint c = _image[loc(x + len, y)].character;
-                    if ((_image[loc(x + len, y)].rendition & RE_EXTENDED_CHAR) != 0) {
-                        // sequence of characters
-                        ushort extendedCharLength = 0;
-                        const uint* chars = ExtendedCharTable::instance.lookupExtendedChar(c, extendedCharLength);
-                        if (chars != nullptr) {
-                            Q_ASSERT(extendedCharLength > 1);
-                            bufferSize += extendedCharLength - 1;
-                            univec.resize(bufferSize);
-                            disstrU = univec.data();
-                            for (int index = 0 ; index < extendedCharLength ; index++) {
-                                Q_ASSERT(p < bufferSize);
-                                disstrU[p++] = chars[index];
-                            }
-                        }
-                    } else {
-                        // single character
-                        if (c != 0u) {
-                            Q_ASSERT(p < bufferSize);
-                            disstrU[p++] = c;
-                        }
-                    }
+            }
+        } else if (ch.character != 0u) {
+            // single character
+            univec.append(ch.character);
+        }
+    };
+    const auto isDoubleWidth = [&](int column) {
+        return column + 1 < _columns && line[column + 1].character == 0;
+    };
 
-                    if (doubleWidth) { // assert((_image[loc(x+len,y)+1].character == 0)), see above if condition
-                        len++; // Skip trailing part of multi-column character
-                    }
-                    len++;
-                }
-            } else {
-                // Group spaces following any non-wide character with the character. This allows for
-                // rendering ambiguous characters with wide glyphs without clipping them.
-                while (!doubleWidth && isInsideDrawArea(x + len)
-                        && _image[loc(x + len, y)].character == ' ' && hasSameColors(x + len)
-                        && hasSameRendition(x + len)) {
-                    // disstrU intentionally not modified - trailing spaces are meaningless
-                    len++;
+    for (int x = 0; x < numberOfColumns;) {
+        int len = 1;
+        univec.resize(0);
+        appendCharacter(line[x]);
+
+        const bool lineDraw = LineBlockCharacters::canDraw(line[x].character);
+        const bool doubleWidth = isDoubleWidth(x);
+        const CharacterColor currentForeground = line[x].foregroundColor;
+        const CharacterColor currentBackground = line[x].backgroundColor;
+        const RenditionFlags currentRendition = line[x].rendition;
+        const QChar::Script currentScript = QChar::script(baseCodePoint(line[x]));
+
+        const auto isInsideLine = [&](int column) { return column < numberOfColumns; };
+        const auto hasSameColors = [&](int column) {
+            return line[column].foregroundColor == currentForeground
+                && line[column].backgroundColor == currentBackground;
+        };
+        const auto hasSameRendition = [&](int column) {
+            return (line[column].rendition & ~RE_EXTENDED_CHAR)
+                == (currentRendition & ~RE_EXTENDED_CHAR);
+        };
+        const auto hasSameWidth = [&](int column) {
+            return isDoubleWidth(column) == doubleWidth;
+        };
+        const auto hasSameLineDrawStatus = [&](int column) {
+            return LineBlockCharacters::canDraw(line[column].character)
+                == lineDraw;
+        };
+        const auto isSameScript = [&](int column) {
+            const QChar::Script script = QChar::script(baseCodePoint(line[column]));
+            if (currentScript == QChar::Script_Common || script == QChar::Script_Common
+                || currentScript == QChar::Script_Inherited || script == QChar::Script_Inherited) {
+                return true;
+            }
+            return currentScript == script;
+        };
+        const auto canBeGrouped = [&](int column) {
+            return line[column].character <= 0x7e
+                   || (line[column].rendition & RE_EXTENDED_CHAR)
+                   || (_bidiEnabled && !doubleWidth);
+        };
+
+        if (canBeGrouped(x)) {
+            while (isInsideLine(x + len) && hasSameColors(x + len)
+                   && hasSameRendition(x + len) && hasSameWidth(x + len)
+                   && hasSameLineDrawStatus(x + len) && isSameScript(x + len)
+                   && canBeGrouped(x + len)) {
+                appendCharacter(line[x + len]);
+
+                if (doubleWidth) { // assert((line[x+len+1].character == 0)), see above if condition
+                    len++; // Skip trailing part of multi-column character
                 }
+                len++;
             }
-            if ((x + len < _usedColumns) && (_image[loc(x + len, y)].character == 0u)) {
-                len++; // Adjust for trailing part of multi-column character
+        } else {
+            // Group spaces following any non-wide character with the character. This allows for
+            // rendering ambiguous characters with wide glyphs without clipping them.
+            while (!doubleWidth && isInsideLine(x + len)
+                    && line[x + len].character == ' ' && hasSameColors(x + len)
+                    && hasSameRendition(x + len)) {
+                // univec intentionally not modified - trailing spaces are meaningless
+                len++;
             }
+        }
+        if (isInsideLine(x + len) && (line[x + len].character == 0u)) {
+            len++; // Adjust for trailing part of multi-column character
+        }
 
-            const bool save__fixedFont = _fixedFont;
-            if (lineDraw) {
-                _fixedFont = false;
-            }
-            if (doubleWidth) {
-                _fixedFont = false;
-            }
-            univec.resize(p);
+        bool blank = true;
+        bool singleCell = !doubleWidth && (line[x].rendition & RE_EXTENDED_CHAR) == 0;
+        for (const uint c : qAsConst(univec)) {
+            blank = blank && c == ' ';
+            singleCell = singleCell && GlyphCache::isCacheable(c);
+        }
 
-            // Create a text scaling matrix for double width and double height lines.
-            QMatrix textScale;
+        runs.append(TextRun{x, len, QString::fromUcs4(univec.constData(), univec.size()), blank, singleCell});
+        x += len;
+    }
+}
 
-            if (y < _lineProperties.size()) {
-                if ((_lineProperties[y] & LINE_DOUBLEWIDTH) != 0) {
-                    textScale.scale(2, 1);
-                }
+void TerminalDisplay::segmentLines(const QRegion &region)
+{
+    const QRect bounds = region.boundingRect();
+    const int lastLine = qMin(bounds.bottom(), _textRuns.size() - 1);
+    for (int y = qMax(bounds.top(), 0); y <= lastLine; y++) {
+        QVector<TextRun> &runs = _textRuns[y];
+        if (runs.isEmpty()) {
+            segmentLine(y, runs);
+        }
+    }
+}
 
-                if ((_lineProperties[y] & LINE_DOUBLEHEIGHT) != 0) {
-                    textScale.scale(1, 2);
-                }
+TerminalDisplay::PaintState TerminalDisplay::paintState(GlyphCache *glyphCache) const
+{
+    return PaintState{font(),
+                      _contentRect.topLeft() + contentsRect().topLeft(),
+                      getBackgroundColor(),
+                      hasFocus(),
+                      devicePixelRatioF(),
+                      glyphCache};
+}
+
+void TerminalDisplay::invalidateTextRuns(int firstLine, int count)
+{
+    const int lastLine = qMin(firstLine + count, _textRuns.size());
+    for (int line = qMax(firstLine, 0); line < lastLine; line++) {
+        _textRuns[line].clear();
+    }
+}
+
+void TerminalDisplay::invalidateAllTextRuns()
+{
+    invalidateTextRuns(0, _textRuns.size());
+}
+
+// returns the scaling applied to the text of double width and double height lines
+static QTransform lineScale(LineProperty lineProperty)
+{
+    QTransform textScale;
+
+    if ((lineProperty & LINE_DOUBLEWIDTH) != 0) {
+        textScale.scale(2, 1);
+    }
+
+    if ((lineProperty & LINE_DOUBLEHEIGHT) != 0) {
+        textScale.scale(1, 2);
+    }
+
+    return textScale;
+}
+
+void TerminalDisplay::drawContents(QPainter& paint, const QRegion& region, const PaintState& state) const
+{
+    // a text run whose text is drawn in the second pass
+    struct TextItem {
+        const TextRun *run;
+        const Character *style;
+        QRect area;
+        QColor color;
+        LineProperty lineProperty;
+        int fontKey;
+    };
+
+    const QRect bounds = region.boundingRect();
+    const int lastLine = qMin(bounds.bottom(), _textRuns.size() - 1);
+    const QColor displayBackgroundColor = state.backgroundColor;
+
+    // the renditions which select the font the text is drawn with
+    const RenditionFlags fontRenditions = RE_UNDERLINE | RE_ITALIC | RE_STRIKEOUT | RE_OVERLINE
+                                          | (_boldIntense ? RE_BOLD : 0);
+    // the renditions which are drawn even for blank text
+    const RenditionFlags lineRenditions = RE_UNDERLINE | RE_STRIKEOUT | RE_OVERLINE;
+    const bool decoratedFont = state.font.underline() || state.font.strikeOut() || state.font.overline();
+
+    QVector<TextItem> textItems;
+
+    // first pass: fill the backgrounds, merging those of adjacent runs of
+    // the same color, and draw the cursor
+    for (int y = qMax(bounds.top(), 0); y <= lastLine; y++) {
+        if (!region.intersects(QRect(bounds.left(), y, bounds.width(), 1))) {
+            continue;
+        }
+
+        const LineProperty lineProperty = y < _lineProperties.size() ? _lineProperties[y] : LineProperty(LINE_DEFAULT);
+        const bool scaled = (lineProperty & (LINE_DOUBLEWIDTH | LINE_DOUBLEHEIGHT)) != 0;
+        const QTransform textScale = lineScale(lineProperty);
+
+        //Apply text scaling matrix.
+        if (scaled) {
+            paint.setWorldTransform(textScale, true);
+        }
+
+        QRect backgroundRect;
+        QColor backgroundRectColor;
+        const auto fillBackground = [&]() {
+            if (!backgroundRect.isNull()) {
+                drawBackground(paint, backgroundRect, backgroundRectColor,
+                               false /* do not use transparency */);
+                backgroundRect = QRect();
             }
+        };
 
-            //Apply text scaling matrix.
-            paint.setWorldTransform(QTransform(textScale), true);
+        for (const TextRun &run : _textRuns.at(y)) {
+            if (run.column > bounds.right()) {
+                break;
+            }
+            // runs are drawn whole, a run reaching into more than one of
+            // the region's rectangles is drawn only once
+            if (!region.intersects(QRect(run.column, y, run.length, 1))) {
+                continue;
+            }
+
+            const Character *style = &_image[loc(run.column, y)];
 
             //calculate the area in which the text will be drawn
-            QRect textArea = QRect(_contentRect.left() + contentsRect().left() + _fontWidth * x,
-                                   _contentRect.top() + contentsRect().top() + _fontHeight * y,
-                                   _fontWidth * len,
+            QRect textArea = QRect(state.contentsOrigin.x() + _fontWidth * run.column,
+                                   state.contentsOrigin.y() + _fontHeight * y,
+                                   _fontWidth * run.length,
                                    _fontHeight);
 
             //move the calculated area to take account of scaling applied to the painter.
@@ -1703,40 +2081,92 @@ void TerminalDisplay::drawContents(QPainter& paint, const QRect& rect)
             //transformation has been applied to the painter.  this ensures that
             //painting does actually start from textArea.topLeft()
             //(instead of textArea.topLeft() * painter-scale)
-            textArea.moveTopLeft(textScale.inverted().map(textArea.topLeft()));
+            if (scaled) {
+                textArea.moveTopLeft(textScale.inverted().map(textArea.topLeft()));
+            }
 
-            QString unistr = QString::fromUcs4(univec.data(), univec.length());
+            const QColor foregroundColor = style->foregroundColor.color(_colorTable);
+            QColor characterColor;
 
-            //paint text fragment
             if (_printerFriendly) {
-                drawPrinterFriendlyTextFragment(paint,
-                                                textArea,
-                                                unistr,
-                                                &_image[loc(x, y)]);
+                // black text without backgrounds for printer friendly output
+                characterColor = Qt::black;
             } else {
-                drawTextFragment(paint,
-                                 textArea,
-                                 unistr,
-                                 &_image[loc(x, y)]);
+                // draw background if different from the display's background color
+                const QColor backgroundColor = style->backgroundColor.color(_colorTable);
+                if (backgroundColor != displayBackgroundColor) {
+                    if (!scaled && !backgroundRect.isNull() && backgroundColor == backgroundRectColor
+                            && backgroundRect.right() + 1 == textArea.left()) {
+                        backgroundRect.setRight(textArea.right());
+                    } else {
+                        fillBackground();
+                        backgroundRect = textArea;
+                        backgroundRectColor = backgroundColor;
+                    }
+                }
+
+                // draw cursor shape if the current character is the cursor
+                // this may alter the foreground and background colors
+                if ((style->rendition & RE_CURSOR) != 0) {
+                    fillBackground();
+                    drawCursor(paint, textArea, foregroundColor, backgroundColor, characterColor, state);
+                }
             }
 
-            _fixedFont = save__fixedFont;
+            if ((_textBlinking && (style->rendition & RE_BLINK) != 0)
+                    || (style->rendition & RE_CONCEAL) != 0
+                    || (run.blank && !decoratedFont && (style->rendition & lineRenditions) == 0)) {
+                continue;
+            }
 
-            //reset back to single-width, single-height _lines
-            paint.setWorldTransform(QTransform(textScale.inverted()), true);
+            textItems.append(TextItem{&run, style, textArea,
+                                      characterColor.isValid() ? characterColor : foregroundColor,
+                                      lineProperty, int(style->rendition & fontRenditions)});
+        }
+        fillBackground();
 
-            if (y < _lineProperties.size() - 1) {
-                //double-height _lines are represented by two adjacent _lines
-                //containing the same characters
-                //both _lines will have the LINE_DOUBLEHEIGHT attribute.
-                //If the current line has the LINE_DOUBLEHEIGHT attribute,
-                //we can therefore skip the next line
-                if ((_lineProperties[y] & LINE_DOUBLEHEIGHT) != 0) {
-                    y++;
-                }
+        //reset back to single-width, single-height _lines
+        if (scaled) {
+            paint.setWorldTransform(textScale.inverted(), true);
+        }
+
+        if (y < _lineProperties.size() - 1) {
+            //double-height _lines are represented by two adjacent _lines
+            //containing the same characters
+            //both _lines will have the LINE_DOUBLEHEIGHT attribute.
+            //If the current line has the LINE_DOUBLEHEIGHT attribute,
+            //we can therefore skip the next line
+            if ((_lineProperties[y] & LINE_DOUBLEHEIGHT) != 0) {
+                y++;
             }
+        }
+    }
 
-            x += len - 1;
+    // second pass: draw the text, grouped by font and color so that
+    // drawCharacters() rarely has to change the painter's font or pen
+    std::stable_sort(textItems.begin(), textItems.end(), [](const TextItem &a, const TextItem &b) {
+        if (a.fontKey != b.fontKey) {
+            return a.fontKey < b.fontKey;
+        }
+        return a.color.rgba() < b.color.rgba();
+    });
+
+    // glyphs of a fixed pitch font only reach out of their cells when
+    // they are italic or the characters need more than one cell each
+    const bool italicFont = state.font.italic();
+    for (const TextItem &item : qAsConst(textItems)) {
+        const bool scaled = (item.lineProperty & (LINE_DOUBLEWIDTH | LINE_DOUBLEHEIGHT)) != 0;
+        const bool clip = !_fixedFont || !item.run->singleCell || italicFont
+                          || (item.style->rendition & RE_ITALIC) != 0;
+
+        if (scaled) {
+            paint.setWorldTransform(lineScale(item.lineProperty), true);
+        }
+
+        drawCharacters(paint, item.area, item.run->text, item.style, item.color, clip, state);
+
+        if (scaled) {
+            paint.setWorldTransform(lineScale(item.lineProperty).inverted(), true);
         }
     }
 }
@@ -1966,6 +2396,7 @@ void TerminalDisplay::makeImage()
     _imageSize = _lines * _columns;
 
     _image = new Character[_imageSize];
+    _textRuns.resize(_lines);
 
     clearImage();
 }
@@ -1975,6 +2406,7 @@ void TerminalDisplay::clearImage()
     for (int i = 0; i < _imageSize; ++i) {
         _image[i] = Screen::DefaultChar;
     }
+    invalidateAllTextRuns();
 }
 
 void TerminalDisplay::calcGeometry()
@@ -2049,7 +2481,24 @@ void TerminalDisplay::showEvent(QShowEvent*)
 {
     propagateSize();
     emit changedContentSizeSignal(_contentRect.height(), _contentRect.width());
+
+    // the window handle only exists once the display is shown, and changes
+    // when the display is moved into another window
+    QWindow *handle = window()->windowHandle();
+    if (handle != nullptr) {
+        connect(handle, &QWindow::screenChanged, this, &Konsole::TerminalDisplay::screenChanged, Qt::UniqueConnection);
+    }
+    emit screenChanged();
 }
+QScreen *TerminalDisplay::displayScreen() const
+{
+    const QWindow *handle = window()->windowHandle();
+    if (handle != nullptr && handle->screen() != nullptr) {
+        return handle->screen();
+    }
+    return QGuiApplication::primaryScreen();
+}
+
 void TerminalDisplay::hideEvent(QHideEvent*)
 {
     emit changedContentSizeSignal(_contentRect.height(), _contentRect.width());
@@ -2747,7 +3196,6 @@ void TerminalDisplay::wheelEvent(QWheelEvent* ev)
             QKeyEvent keyEvent(QEvent::KeyPress, keyCode, Qt::NoModifier);
 
             for (int i = 0; i < abs(lines); i++) {
-                _screenWindow->screen()->setCurrentTerminalDisplay(this);
                 emit keyPressedSignal(&keyEvent);
             }
         } else if (_usesMouseTracking) {
@@ -2784,6 +3232,8 @@ void TerminalDisplay::viewScrolledByUser()
 */
 QPoint TerminalDisplay::findLineStart(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->mutex());
+
     const int visibleScreenLines = _lineProperties.size();
     const int topVisibleLine = _screenWindow->currentLine();
     Screen *screen = _screenWindow->screen();
@@ -2817,6 +3267,8 @@ QPoint TerminalDisplay::findLineStart(const QPoint &pnt)
 */
 QPoint TerminalDisplay::findLineEnd(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->mutex());
+
     const int visibleScreenLines = _lineProperties.size();
     const int topVisibleLine = _screenWindow->currentLine();
     const int maxY = _screenWindow->lineCount() - 1;
@@ -2842,6 +3294,8 @@ QPoint TerminalDisplay::findLineEnd(const QPoint &pnt)
 
 QPoint TerminalDisplay::findWordStart(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->mutex());
+
     const int regSize = qMax(_screenWindow->windowLines(), 10);
     const int firstVisibleLine = _screenWindow->currentLine();
 
@@ -2914,6 +3368,8 @@ out:
 
 QPoint TerminalDisplay::findWordEnd(const QPoint &pnt)
 {
+    QMutexLocker locker(_screenWindow->mutex());
+
     const int regSize = qMax(_screenWindow->windowLines(), 10);
     const int curLine = _screenWindow->currentLine();
     int i = pnt.y();
@@ -3139,6 +3595,28 @@ bool TerminalDisplay::bracketedPasteMode() const
     return _bracketedPasteMode;
 }
 
+void TerminalDisplay::setFloodMode(bool flooding)
+{
+    if (flooding && !_floodMode) {
+        // The filters are not run while flooded, so the hotspots would soon
+        // be over text which has scrolled into their place.  Drop them now
+        // rather than have links open the wrong target when clicked.
+        const QRegion staleHotSpots = hotSpotRegion() | _mouseOverHotspotArea;
+        _filterChain->clearImage();
+        _mouseOverHotspotArea = QRegion();
+        if (cursor().shape() == Qt::PointingHandCursor) {
+            setCursor(_usesMouseTracking ? Qt::ArrowCursor : Qt::IBeamCursor);
+        }
+        update(staleHotSpots);
+    }
+
+    _floodMode = flooding;
+    if (!flooding) {
+        // make sure the filters are brought up to date with the final output
+        _filterUpdateRequired = true;
+    }
+}
+
 /* ------------------------------------------------------------------------- */
 /*                                                                           */
 /*                               Clipboard                                   */
@@ -3450,9 +3928,10 @@ void TerminalDisplay::drawInputMethodPreeditString(QPainter& painter , const QRe
     const QColor foreground = _colorTable[DEFAULT_FORE_COLOR];
     const Character* style = &_image[loc(cursorPos.x(), cursorPos.y())];
 
+    const PaintState state = paintState(&_glyphCache);
     drawBackground(painter, rect, background, true);
-    drawCursor(painter, rect, foreground, background, characterColor);
-    drawCharacters(painter, rect, _inputMethodData.preeditString, style, characterColor);
+    drawCursor(painter, rect, foreground, background, characterColor, state);
+    drawCharacters(painter, rect, _inputMethodData.preeditString, style, characterColor, true, state);
 
     _inputMethodData.previousPreeditRect = rect;
 }
@@ -3545,7 +4024,7 @@ void TerminalDisplay::scrollScreenWindow(enum ScreenWindow::RelativeScrollMode m
 void TerminalDisplay::keyPressEvent(QKeyEvent* event)
 {
     if ((_urlHintsModifiers != 0u) && event->modifiers() == _urlHintsModifiers) {
-        int nHotSpots = _filterChain->hotSpots().count();
+        int nHotSpots = _filterChain->hotSpotCount();
         int hintSelected = event->key() - 0x31;
         if (hintSelected >= 0 && hintSelected < 10 && hintSelected < nHotSpots) {
             if (_reverseUrlHints) {
@@ -3564,8 +4043,6 @@ void TerminalDisplay::keyPressEvent(QKeyEvent* event)
         }
     }
 
-    _screenWindow->screen()->setCurrentTerminalDisplay(this);
-
     if (!_readOnly) {
         _actSel = 0; // Key stroke implies a screen update, so TerminalDisplay won't
                      // know where the current selection is.
@@ -3588,7 +4065,8 @@ void TerminalDisplay::keyPressEvent(QKeyEvent* event)
 
 #ifndef QT_NO_ACCESSIBILITY
     if (!_readOnly) {
-        QAccessibleTextCursorEvent textCursorEvent(this, _usedColumns * screenWindow()->screen()->getCursorY() + screenWindow()->screen()->getCursorX());
+        const QPoint cursor = _screenWindow->cursorPosition();
+        QAccessibleTextCursorEvent textCursorEvent(this, _usedColumns * cursor.y() + cursor.x());
         QAccessible::updateAccessibility(&textCursorEvent);
     }
 #endif
@@ -3902,6 +4380,151 @@ SessionController* TerminalDisplay::sessionController()
     return _sessionController;
 }
 
+void TerminalDisplay::setTracer(Tracer *tracer)
+{
+    if (tracer == _tracer) {
+        return;
+    }
+
+    const bool overlayVisible = isPerformanceOverlayVisible();
+    if (overlayVisible && !_tracer.isNull()) {
+        _tracer->removeCollector();
+    }
+    _tracer = tracer;
+    if (overlayVisible && !_tracer.isNull()) {
+        _tracer->addCollector();
+        resetPerformanceOverlay();
+    }
+}
+
+void TerminalDisplay::setPerformanceOverlayVisible(bool visible)
+{
+    if (visible == isPerformanceOverlayVisible()) {
+        return;
+    }
+
+    if (visible) {
+        if (!_tracer.isNull()) {
+            _tracer->addCollector();
+        }
+        resetPerformanceOverlay();
+        _performanceOverlayTimer->start();
+    } else {
+        _performanceOverlayTimer->stop();
+        if (!_tracer.isNull()) {
+            _tracer->removeCollector();
+        }
+        update(_performanceOverlayRect);
+        _performanceOverlayRect = QRect();
+    }
+}
+
+bool TerminalDisplay::isPerformanceOverlayVisible() const
+{
+    return _performanceOverlayTimer->isActive();
+}
+
+void TerminalDisplay::resetPerformanceOverlay()
+{
+    _performanceTotals = _tracer.isNull() ? Tracer::Totals() : _tracer->totals();
+    _performanceSampleTime = Tracer::now();
+    _performanceOverlayText = QStringList(i18n("Collecting performance data..."));
+    update(_performanceOverlayRect);
+}
+
+void TerminalDisplay::updatePerformanceOverlay()
+{
+    if (_tracer.isNull() || _screenWindow.isNull()) {
+        return;
+    }
+
+    const Tracer::Totals totals = _tracer->totals();
+    const qint64 now = Tracer::now();
+    const double seconds = qMax<qint64>(1, now - _performanceSampleTime) / 1e9;
+
+    auto perSecond = [&](Tracer::Counter counter) {
+        return (totals.counters[counter] - _performanceTotals.counters[counter]) / seconds;
+    };
+    // milliseconds spent in a stage per second
+    auto busy = [&](Tracer::Stage stage) {
+        return (totals.time[stage] - _performanceTotals.time[stage]) / 1e6 / seconds;
+    };
+    const qint64 frames = totals.runs[Tracer::UpdateStage] - _performanceTotals.runs[Tracer::UpdateStage];
+    const qint64 paints = totals.runs[Tracer::PaintStage] - _performanceTotals.runs[Tracer::PaintStage];
+    // milliseconds per run of a stage
+    auto average = [&](Tracer::Stage stage, qint64 runs) {
+        return runs > 0 ? (totals.time[stage] - _performanceTotals.time[stage]) / 1e6 / runs : 0.0;
+    };
+    const double dirtyLines = frames > 0
+                              ? double(totals.counters[Tracer::DirtyLinesCounter] - _performanceTotals.counters[Tracer::DirtyLinesCounter]) / frames
+                              : 0.0;
+
+    QMutexLocker locker(_screenWindow->mutex());
+
+    const QLocale locale;
+    _performanceOverlayText = QStringList({
+        i18n("Input: %1/s, %2 lines/s",
+             locale.formattedDataSize(qRound64(perSecond(Tracer::ReceivedBytesCounter))),
+             QString::number(qRound64(perSecond(Tracer::ScrolledLinesCounter)))),
+        i18n("Parse: %1 ms/s, decode: %2 ms/s",
+             QString::number(busy(Tracer::ParseStage), 'f', 1),
+             QString::number(busy(Tracer::DecodeStage), 'f', 1)),
+        i18n("Frames: %1/s, update: %2 ms, paint: %3 ms",
+             QString::number(qRound64(frames / seconds)),
+             QString::number(average(Tracer::UpdateStage, frames), 'f', 2),
+             QString::number(average(Tracer::PaintStage, paints), 'f', 2)),
+        i18n("Dirty lines per frame: %1", QString::number(dirtyLines, 'f', 1)),
+        i18n("History: %1, extended characters: %2",
+             locale.formattedDataSize(_screenWindow->screen()->historyMemoryUsage()),
+             QString::number(ExtendedCharTable::instance.size())),
+    });
+    const TrigramIndex *historyIndex = _screenWindow->screen()->historyIndex();
+    if (historyIndex != nullptr) {
+        _performanceOverlayText << i18n("History index: %1 of %2, %3 lines",
+                                        locale.formattedDataSize(historyIndex->memoryUsage()),
+                                        locale.formattedDataSize(historyIndex->maximumMemoryUsage()),
+                                        QString::number(historyIndex->lineCount() - historyIndex->firstIndexedLine()));
+    }
+    locker.unlock();
+
+    _performanceTotals = totals;
+    _performanceSampleTime = now;
+
+    update(_performanceOverlayRect);
+}
+
+void TerminalDisplay::drawPerformanceOverlay(QPainter &painter)
+{
+    const QFontMetrics metrics(painter.font());
+    const int margin = metrics.height() / 2;
+
+    int textWidth = 0;
+    for (const QString &line : qAsConst(_performanceOverlayText)) {
+        textWidth = qMax(textWidth, metrics.horizontalAdvance(line));
+    }
+    const QSize size(textWidth + 2 * margin, _performanceOverlayText.count() * metrics.height() + 2 * margin);
+    const QRect rect(contentsRect().right() - size.width() - margin, contentsRect().top() + margin,
+                     size.width(), size.height());
+
+    painter.save();
+    painter.fillRect(rect, QColor(0, 0, 0, 192));
+    painter.setPen(Qt::white);
+    int y = rect.top() + margin + metrics.ascent();
+    for (const QString &line : qAsConst(_performanceOverlayText)) {
+        painter.drawText(rect.left() + margin, y, line);
+        y += metrics.height();
+    }
+    painter.restore();
+
+    // the text changes size as the figures change, remember where it was
+    // drawn so that it can be cleared
+    if (rect != _performanceOverlayRect) {
+        const QRect previous = _performanceOverlayRect;
+        _performanceOverlayRect = rect;
+        update(previous);
+    }
+}
+
 IncrementalSearchBar *TerminalDisplay::searchBar() const
 {
     return _searchBar;
@@ -3977,6 +4600,7 @@ void TerminalDisplay::applyProfile(const Profile::Ptr &profile)
 
     // load font
     _antialiasText = profile->antiAliasFonts();
+    updateGlyphCaches();
     _boldIntense = profile->boldIntense();
     _useFontLineCharacters = profile->useFontLineCharacters();
     setVTFont(profile->font());
@@ -3997,6 +4621,7 @@ void TerminalDisplay::applyProfile(const Profile::Ptr &profile)
     _ctrlRequiredForDrag = profile->property<bool>(Profile::CtrlRequiredForDrag);
     _dropUrlsAsText = profile->property<bool>(Profile::DropUrlsAsText);
     _bidiEnabled = profile->bidiRenderingEnabled();
+    invalidateAllTextRuns();
     setLineSpacing(uint(profile->lineSpacing()));
     _trimLeadingSpaces = profile->property<bool>(Profile::TrimLeadingSpacesInSelectedText);
     _trimTrailingSpaces = profile->property<bool>(Profile::TrimTrailingSpacesInSelectedText);
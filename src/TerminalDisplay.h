@@ -36,6 +36,8 @@
 #include "Profile.h"
 #include "TerminalHeaderBar.h"
 #include "Filter.h"
+#include "GlyphCache.h"
+#include "Tracer.h"
 
 class QDrag;
 class QDragEnterEvent;
@@ -46,6 +48,7 @@ class QEvent;
 class QVBoxLayout;
 class QKeyEvent;
 class QScrollBar;
+class QScreen;
 class QShowEvent;
 class QHideEvent;
 class QTimerEvent;
@@ -134,8 +137,8 @@ public:
      * Updates the filters in the display's filter chain.  This will cause
      * the hotspots to be updated to match the current image.
      *
-     * WARNING:  This function can be expensive depending on the
-     * image size and number of filters in the filterChain()
+     * Only the lines which changed are searched, on a worker thread, so
+     * the hotspots on them appear a little after this returns.
      *
      * TODO - This API does not really allow efficient usage.  Revise it so
      * that the processing can be done in a better way.
@@ -146,6 +149,12 @@ public:
      */
     void processFilters();
 
+    /**
+     * Processes all of the text again, for filters whose hotspots became
+     * outdated without the text changing, see FileFilter::outdated()
+     */
+    void updateFilters();
+
     /**
      * Returns a list of menu actions created by the filters for the content
      * at the given @p position.
@@ -164,6 +173,15 @@ public:
     void setSessionController(SessionController *controller);
     SessionController *sessionController();
 
+    /** Sets the tracer which times updating and painting the display */
+    void setTracer(Tracer *tracer);
+
+    /**
+     * Returns the screen the display is shown on, or the primary screen if
+     * it is not shown yet.  See screenChanged()
+     */
+    QScreen *displayScreen() const;
+
     /**
      * Sets the shape of the keyboard cursor.  This is the cursor drawn
      * at the position in the terminal where keyboard input will appear.
@@ -464,6 +482,39 @@ public Q_SLOTS:
 
     void setBracketedPasteMode(bool on);
 
+    /**
+     * Enables or disables flood mode, see Emulation::floodModeChanged().
+     * While enabled, filters are not run and no accessibility updates are
+     * sent for changes to the screen.
+     */
+    void setFloodMode(bool flooding);
+
+    /**
+     * Shows or hides an overlay with live performance figures of the
+     * session: its throughput, the time spent parsing the output and
+     * updating and painting the display, the number of lines changed per
+     * frame and the memory used by the history and extended characters.
+     * The figures are collected by the tracer, see setTracer().
+     */
+    void setPerformanceOverlayVisible(bool visible);
+    /** Returns true if the performance overlay is shown */
+    bool isPerformanceOverlayVisible() const;
+
+    /**
+     * Sets whether the display is rasterized by a pool of threads.  The
+     * dirty lines are split into horizontal bands, each of which is drawn
+     * by a thread of its own into an offscreen image, and the image is then
+     * copied onto the widget.  This speeds up painting large displays with
+     * software rendering, but it is only used where fonts can be rendered
+     * outside of the GUI thread and there is no wallpaper.
+     *
+     * It is enabled by default if the KONSOLE_THREADED_RENDERING
+     * environment variable is set to 1.
+     */
+    void setThreadedRendering(bool enabled);
+    /** Returns true if the display is rasterized by a pool of threads */
+    bool threadedRendering() const;
+
     /**
      * Shows a notification that a bell event has occurred in the terminal.
      * TODO: More documentation here
@@ -553,6 +604,12 @@ Q_SIGNALS:
 
     void compositeFocusChanged(bool focused);
 
+    /**
+     * Emitted when the display is shown, or when its window is moved to
+     * another screen, which may have a different refresh rate.
+     */
+    void screenChanged();
+
 protected:
     // events
     bool event(QEvent *event) override;
@@ -622,40 +679,100 @@ private Q_SLOTS:
 
     void dismissOutputSuspendedMessage();
 
+    // takes a sample of the tracer's totals for the performance overlay
+    void updatePerformanceOverlay();
+
 private:
     Q_DISABLE_COPY(TerminalDisplay)
 
     // -- Drawing helpers --
 
-    // divides the part of the display specified by 'rect' into
-    // fragments according to their colors and styles and calls
-    // drawTextFragment() or drawPrinterFriendlyTextFragment()
-    // to draw the fragments
-    void drawContents(QPainter &painter, const QRect &rect);
+    // The state of the widget which the drawing helpers depend on.  It is
+    // taken on the GUI thread by paintState(), so that the helpers below
+    // call no QWidget methods and can also draw on other threads.
+    struct PaintState {
+        QFont font;
+        QPoint contentsOrigin; // top left of the character image in the widget
+        QColor backgroundColor;
+        bool hasFocus;
+        qreal devicePixelRatio;
+        // must not be used by another thread while drawing with this state
+        GlyphCache *glyphCache;
+    };
+    PaintState paintState(GlyphCache *glyphCache) const;
+
+    // draws the text runs of the image which intersect 'region', given in
+    // image coordinates.  The backgrounds and the cursor are drawn first,
+    // then the text of all runs ordered by font and color, so that the
+    // painter's state changes as seldom as possible.  The lines of the
+    // region must have been segmented with segmentLines() beforehand.
+    void drawContents(QPainter &painter, const QRegion &region, const PaintState &state) const;
+
+    // a horizontal band of the display rasterized into _backingStore
+    struct RenderBand {
+        uchar *bits; // first scan line of the band in _backingStore
+        int pixelHeight;
+        qreal top; // in widget coordinates
+        QRegion region; // the part of the paint event's region in the band
+        QRegion imageRegion; // the same in image coordinates
+        int firstLine; // the first line of the image in the band
+        PaintState state;
+    };
+    // rasterizes 'region', in widget coordinates, in bands on a pool of
+    // threads, redraws the lines at the boundaries of the bands on the GUI
+    // thread and copies the result onto the widget.  Returns false if
+    // the display has to be painted directly instead.
+    bool paintThreaded(QPainter &painter, const QRegion &region, const QRegion &imageRegion);
+    // draws the background and contents of a band, may run on any thread.
+    // Only reads the display's members, which the GUI thread does not
+    // modify until all bands are done.
+    void paintBand(const RenderBand &band) const;
+    // applies the display's font metrics and antialiasing to all glyph caches
+    void updateGlyphCaches();
+
+    // a fragment of a line of the image in which all characters have a
+    // common color and style, drawn with a single drawCharacters() call
+    struct TextRun {
+        int column;
+        int length; // in cells
+        QString text;
+        bool blank; // contains nothing but spaces
+        bool singleCell; // each character is drawn within a cell of its own
+    };
+    // divides line 'y' of the image into text runs according to the colors,
+    // styles, widths and scripts of its characters
+    void segmentLine(int y, QVector<TextRun> &runs) const;
+    // divides the lines of 'region', in image coordinates, into text runs
+    // if they have changed since they were last painted, see _textRuns
+    void segmentLines(const QRegion &region);
+    void invalidateTextRuns(int firstLine, int count);
+    void invalidateAllTextRuns();
     // draw a transparent rectangle over the line of the current match
     void drawCurrentResultRect(QPainter &painter);
-    // draws a section of text, all the text in this section
-    // has a common color and style
-    void drawTextFragment(QPainter &painter, const QRect &rect, const QString &text,
-                          const Character *style);
-
-    void drawPrinterFriendlyTextFragment(QPainter &painter, const QRect &rect, const QString &text,
-                                         const Character *style);
     // draws the background for a text fragment
     // if useOpacitySetting is true then the color's alpha value will be set to
     // the display's transparency (set with setOpacity()), otherwise the background
     // will be drawn fully opaque
     void drawBackground(QPainter &painter, const QRect &rect, const QColor &backgroundColor,
-                        bool useOpacitySetting);
+                        bool useOpacitySetting) const;
     // draws the cursor character
     void drawCursor(QPainter &painter, const QRect &rect, const QColor &foregroundColor,
-                    const QColor &backgroundColor, QColor &characterColor);
-    // draws the characters or line graphics in a text fragment
+                    const QColor &backgroundColor, QColor &characterColor,
+                    const PaintState &state) const;
+    // draws the characters or line graphics in a text fragment, clipped
+    // to 'rect' if 'clip' is true, using glyphs from the state's glyph
+    // cache if it is not null
     void drawCharacters(QPainter &painter, const QRect &rect, const QString &text,
-                        const Character *style, const QColor &characterColor);
+                        const Character *style, const QColor &characterColor, bool clip,
+                        const PaintState &state) const;
+    // draws a text fragment from the glyph cache, returns false if it has
+    // to be drawn with QPainter::drawText() instead
+    bool drawCachedGlyphs(QPainter &painter, const QRect &rect, const QString &text,
+                          const Character *style, const QColor &color, int fontVariant,
+                          const PaintState &state) const;
     // draws a string of line graphics
     void drawLineCharString(QPainter &painter, int x, int y, const QString &str,
-                            const Character *attributes);
+                            const Character *attributes) const;
 
     // draws the preedit string for input methods
     void drawInputMethodPreeditString(QPainter &painter, const QRect &rect);
@@ -691,7 +808,9 @@ private:
     void updateImageSize();
     void makeImage();
 
-    void paintFilters(QPainter &painter);
+    // draws the hotspots found by the filters on the lines of the
+    // image within dirtyImageRegion
+    void paintFilters(QPainter &painter, const QRegion &dirtyImageRegion);
 
     // returns a region covering all of the areas of the widget which contain
     // a hotspot
@@ -757,6 +876,11 @@ private:
     int _imageSize;
     QVector<LineProperty> _lineProperties;
 
+    // the text runs of each line of _image.  A line without runs has
+    // changed since it was last painted and is segmented again on the
+    // next paint.
+    QVector<QVector<TextRun>> _textRuns;
+
     ColorEntry _colorTable[TABLE_COLORS];
 
     uint _randomSeed;
@@ -830,6 +954,8 @@ private:
     TerminalImageFilterChain *_filterChain;
     QRegion _mouseOverHotspotArea;
     bool _filterUpdateRequired;
+    // true while the terminal receives output faster than it can be read
+    bool _floodMode;
 
     Enum::CursorShapeEnum _cursorShape;
 
@@ -848,6 +974,13 @@ private:
     InputMethodData _inputMethodData;
 
     bool _antialiasText;   // do we anti-alias or not
+    GlyphCache _glyphCache;
+
+    bool _threadedRendering;
+    // the contents of the display as rasterized by paintThreaded()
+    QImage _backingStore;
+    // the glyph caches of the bands painted on other threads than the GUI thread
+    QVector<GlyphCache *> _bandGlyphCaches;
     bool _useFontLineCharacters;
 
     bool _printerFriendly; // are we currently painting to a printer in black/white mode
@@ -859,6 +992,18 @@ private:
     static const int SIZE_HINT_DURATION = 1000;
 
     SessionController *_sessionController;
+    // owned by the session, which may be closed before the display is gone
+    QPointer<Tracer> _tracer;
+
+    // see setPerformanceOverlayVisible()
+    void drawPerformanceOverlay(QPainter &painter);
+    void resetPerformanceOverlay();
+    QTimer *_performanceOverlayTimer;
+    // totals when the overlay was last updated and the time they were taken
+    Tracer::Totals _performanceTotals;
+    qint64 _performanceSampleTime;
+    QStringList _performanceOverlayText;
+    QRect _performanceOverlayRect;
 
     bool _trimLeadingSpaces;   // trim leading spaces in selected text
     bool _trimTrailingSpaces;   // trim trailing spaces in selected text
@@ -21,6 +21,7 @@
 
 #include "TerminalDisplayAccessible.h"
 #include "SessionController.h"
+#include <QMutexLocker>
 #include <klocalizedstring.h>
 
 using namespace Konsole;
@@ -49,8 +50,8 @@ int TerminalDisplayAccessible::cursorPosition() const
         return 0;
     }
 
-    int offset = display()->_usedColumns * display()->screenWindow()->screen()->getCursorY();
-    return offset + display()->screenWindow()->screen()->getCursorX();
+    const QPoint cursor = display()->screenWindow()->cursorPosition();
+    return display()->_usedColumns * cursor.y() + cursor.x();
 }
 
 void TerminalDisplayAccessible::selection(int selectionIndex, int *startOffset,
@@ -98,6 +99,7 @@ QString TerminalDisplayAccessible::visibleText() const
         return QString();
     }
 
+    QMutexLocker locker(display->screenWindow()->mutex());
     return display->screenWindow()->screen()->text(0, display->_usedColumns * display->_usedLines, Screen::PreserveLineBreaks);
 }
 
@@ -158,6 +160,7 @@ void TerminalDisplayAccessible::setCursorPosition(int position)
         return;
     }
 
+    QMutexLocker locker(display()->screenWindow()->mutex());
     display()->screenWindow()->screen()->setCursorYX(lineForOffset(position),
                                                      columnForOffset(position));
 }
@@ -185,6 +188,7 @@ QString TerminalDisplayAccessible::text(int startOffset, int endOffset) const
         return QString();
     }
 
+    QMutexLocker locker(display()->screenWindow()->mutex());
     return display()->screenWindow()->screen()->text(startOffset, endOffset, Screen::PreserveLineBreaks);
 }
 
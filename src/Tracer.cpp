@@ -0,0 +1,298 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "Tracer.h"
+
+// Std
+#include <algorithm>
+#include <chrono>
+
+// Qt
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QThread>
+
+using namespace Konsole;
+
+// the buffered events are written out once they take up this many bytes
+static const int FLUSH_SIZE = 64 * 1024;
+
+static QByteArray jsonString(const QString &text)
+{
+    QByteArray result = text.toUtf8();
+    result.replace('\\', "\\\\");
+    result.replace('"', "\\\"");
+    return '"' + result + '"';
+}
+
+// timestamps in the trace are in microseconds
+static QByteArray microseconds(qint64 nanoseconds)
+{
+    return QByteArray::number(nanoseconds / 1000.0, 'f', 3);
+}
+
+Tracer::Totals::Totals()
+{
+    std::fill(time, time + StageCount, 0);
+    std::fill(runs, runs + StageCount, 0);
+    std::fill(counters, counters + CounterCount, 0);
+}
+
+Tracer::Tracer(QObject *parent) :
+    QObject(parent),
+    _tracing(0),
+    _collectors(0),
+    _active(0),
+    _mutex(),
+    _file(),
+    _buffer(),
+    _pid(QCoreApplication::applicationPid()),
+    _firstEvent(true),
+    _namedThreads(),
+    _totals()
+{
+}
+
+Tracer::~Tracer()
+{
+    stop();
+}
+
+const char *Tracer::stageName(Stage stage)
+{
+    switch (stage) {
+    case ReadStage:
+        return "read";
+    case DecodeStage:
+        return "decode";
+    case ParseStage:
+        return "parse";
+    case ImageStage:
+        return "getImage";
+    case UpdateStage:
+        return "updateImage";
+    case FilterStage:
+        return "filters";
+    case PaintStage:
+        return "paint";
+    case StageCount:
+        break;
+    }
+    return "unknown";
+}
+
+const char *Tracer::counterName(Counter counter)
+{
+    switch (counter) {
+    case ReceivedBytesCounter:
+        return "bytes";
+    case ScrolledLinesCounter:
+        return "scrolled lines";
+    case DirtyLinesCounter:
+        return "dirty lines";
+    case CounterCount:
+        break;
+    }
+    return "unknown";
+}
+
+qint64 Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Tracer::start(const QString &fileName, const QString &processName)
+{
+    stop();
+
+    QMutexLocker locker(&_mutex);
+
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    // The JSON array format is used because trace viewers accept it even
+    // without the closing bracket, if Konsole ends before stop() is called
+    _buffer = "[";
+    _firstEvent = true;
+    _namedThreads.clear();
+
+    beginEvent();
+    _buffer += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(_pid)
+               + ",\"args\":{\"name\":" + jsonString(processName) + "}}";
+
+    _tracing.storeRelease(1);
+    updateActive();
+    return true;
+}
+
+void Tracer::stop()
+{
+    QMutexLocker locker(&_mutex);
+
+    if (!_file.isOpen()) {
+        return;
+    }
+
+    _tracing.storeRelease(0);
+    updateActive();
+    _buffer += "\n]\n";
+    flush();
+    _file.close();
+}
+
+void Tracer::addCollector()
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_collectors.fetchAndAddOrdered(1) == 0) {
+        _totals = Totals();
+    }
+    updateActive();
+}
+
+void Tracer::removeCollector()
+{
+    QMutexLocker locker(&_mutex);
+
+    _collectors.fetchAndAddOrdered(-1);
+    updateActive();
+}
+
+void Tracer::updateActive()
+{
+    _active.storeRelease(_tracing.loadAcquire() != 0 || _collectors.loadAcquire() > 0 ? 1 : 0);
+}
+
+Tracer::Totals Tracer::totals() const
+{
+    QMutexLocker locker(&_mutex);
+    return _totals;
+}
+
+QString Tracer::fileName() const
+{
+    QMutexLocker locker(&_mutex);
+    return _file.fileName();
+}
+
+QString Tracer::errorString() const
+{
+    QMutexLocker locker(&_mutex);
+    return _file.errorString();
+}
+
+void Tracer::addEvent(Stage stage, qint64 start, qint64 end)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_collectors.loadAcquire() > 0) {
+        _totals.time[stage] += end - start;
+        _totals.runs[stage]++;
+    }
+
+    // the trace may have been stopped while the event was timed
+    if (!_file.isOpen()) {
+        return;
+    }
+
+    const qint64 thread = currentThread();
+    beginEvent();
+    _buffer += "{\"name\":\"";
+    _buffer += stageName(stage);
+    _buffer += "\",\"cat\":\"konsole\",\"ph\":\"X\",\"ts\":" + microseconds(start)
+               + ",\"dur\":" + microseconds(end - start)
+               + ",\"pid\":" + QByteArray::number(_pid)
+               + ",\"tid\":" + QByteArray::number(thread) + '}';
+
+    if (_buffer.size() >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void Tracer::addCount(Counter counter, qint64 amount)
+{
+    QMutexLocker locker(&_mutex);
+
+    if (_collectors.loadAcquire() > 0) {
+        _totals.counters[counter] += amount;
+    }
+
+    if (!_file.isOpen()) {
+        return;
+    }
+
+    // shown by trace viewers as a graph of the amount over time
+    const qint64 thread = currentThread();
+    beginEvent();
+    _buffer += "{\"name\":\"";
+    _buffer += counterName(counter);
+    _buffer += "\",\"cat\":\"konsole\",\"ph\":\"C\",\"ts\":" + microseconds(now())
+               + ",\"pid\":" + QByteArray::number(_pid)
+               + ",\"tid\":" + QByteArray::number(thread)
+               + ",\"args\":{\"value\":" + QByteArray::number(amount) + "}}";
+
+    if (_buffer.size() >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+qint64 Tracer::currentThread()
+{
+    const qint64 thread = static_cast<qint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    if (_namedThreads.contains(thread)) {
+        return thread;
+    }
+    _namedThreads.insert(thread);
+
+    QString threadName = QThread::currentThread()->objectName();
+    if (threadName.isEmpty()) {
+        const bool mainThread = QCoreApplication::instance() != nullptr
+                                && QThread::currentThread() == QCoreApplication::instance()->thread();
+        threadName = mainThread ? QStringLiteral("main") : QString::number(thread);
+    }
+
+    beginEvent();
+    _buffer += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(_pid)
+               + ",\"tid\":" + QByteArray::number(thread)
+               + ",\"args\":{\"name\":" + jsonString(threadName) + "}}";
+    return thread;
+}
+
+void Tracer::beginEvent()
+{
+    if (!_firstEvent) {
+        _buffer += ',';
+    }
+    _buffer += '\n';
+    _firstEvent = false;
+}
+
+void Tracer::flush()
+{
+    // a failed write only loses part of the trace, errorString() tells why
+    _file.write(_buffer);
+    _buffer.clear();
+}
@@ -0,0 +1,213 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+// Qt
+#include <QAtomicInt>
+#include <QFile>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+/**
+ * Collects the time spent in the stages of the output pipeline of a
+ * session and writes it to a file in Chrome's trace event format, which
+ * can be loaded into chrome://tracing, Perfetto or similar trace viewers.
+ * The same times and counters are summed up for the performance overlay
+ * of the terminal display, see totals().
+ *
+ * The stages are timed by placing a TraceScope around them.  While the
+ * tracer is not active a trace point costs an atomic load, so they can
+ * stay in the code.  Tracer is thread-safe, the pty output is read in a
+ * thread of its own.
+ */
+class KONSOLEPRIVATE_EXPORT Tracer : public QObject
+{
+    Q_OBJECT
+
+public:
+    /** The stages of the output pipeline which are traced */
+    enum Stage {
+        /** Reading the output of the terminal process */
+        ReadStage,
+        /** Converting the output to unicode */
+        DecodeStage,
+        /** Parsing the escape sequences and updating the screen */
+        ParseStage,
+        /** Copying the visible part of the screen for a view */
+        ImageStage,
+        /** Comparing the new image with the displayed one */
+        UpdateStage,
+        /** Finding links and other hotspots */
+        FilterStage,
+        /** Painting the terminal display */
+        PaintStage,
+        StageCount
+    };
+
+    /** Quantities counted along the output pipeline */
+    enum Counter {
+        /** Bytes of output received from the terminal process */
+        ReceivedBytesCounter,
+        /** Lines a view has scrolled by */
+        ScrolledLinesCounter,
+        /** Lines of a view which have changed and need painting */
+        DirtyLinesCounter,
+        CounterCount
+    };
+
+    /** Sums of the times and counters since the tracer was created */
+    struct Totals {
+        Totals();
+
+        // in nanoseconds
+        qint64 time[StageCount];
+        // number of times each stage was run
+        qint64 runs[StageCount];
+        qint64 counters[CounterCount];
+    };
+
+    explicit Tracer(QObject *parent = nullptr);
+    ~Tracer() override;
+
+    /** Returns the name of @p stage as it appears in the trace */
+    static const char *stageName(Stage stage);
+    /** Returns the name of @p counter as it appears in the trace */
+    static const char *counterName(Counter counter);
+
+    /** Returns the current time of a monotonic clock, in nanoseconds */
+    static qint64 now();
+
+    /**
+     * Starts writing the trace to @p fileName, replacing any previous
+     * contents.  @p processName is what the trace viewer calls the
+     * events' process, usually the name of the session.
+     */
+    bool start(const QString &fileName, const QString &processName);
+
+    /** Finishes the trace and closes the file */
+    void stop();
+
+    bool isTracing() const
+    {
+        return _tracing.loadAcquire() != 0;
+    }
+
+    /**
+     * Starts summing up the times and counters for totals().  Calls nest,
+     * each has to be matched by a call to removeCollector().
+     */
+    void addCollector();
+    void removeCollector();
+
+    /**
+     * Returns true if a trace is being written or totals are collected,
+     * which is when the trace points have to report to the tracer.
+     */
+    bool isActive() const
+    {
+        return _active.loadAcquire() != 0;
+    }
+
+    /** Returns the name of the file the trace is written to */
+    QString fileName() const;
+    /** Returns a description of the last error which occurred */
+    QString errorString() const;
+
+    /**
+     * Adds an event for @p stage which took from @p start to @p end,
+     * both as returned by now(), in the calling thread.
+     */
+    void addEvent(Stage stage, qint64 start, qint64 end);
+
+    /** Adds @p amount to @p counter */
+    void addCount(Counter counter, qint64 amount);
+
+    /** Returns the times and counters collected since addCollector() */
+    Totals totals() const;
+
+private:
+    Q_DISABLE_COPY(Tracer)
+
+    // writes the buffered events to the file, _mutex must be held
+    void flush();
+    // starts a new event in the buffer, _mutex must be held
+    void beginEvent();
+    // returns the id of the calling thread and writes its name to the
+    // trace the first time, _mutex must be held
+    qint64 currentThread();
+    void updateActive();
+
+    QAtomicInt _tracing;
+    QAtomicInt _collectors;
+    QAtomicInt _active;
+    mutable QMutex _mutex;
+    QFile _file;
+    QByteArray _buffer;
+    qint64 _pid;
+    bool _firstEvent;
+    // threads whose name has been written to the trace
+    QSet<qint64> _namedThreads;
+    Totals _totals;
+};
+
+/**
+ * Adds an event for the time from its construction to its destruction
+ * to the trace, if the tracer is active.
+ *
+ * @code
+ * TraceScope trace(_tracer, Tracer::ParseStage);
+ * @endcode
+ */
+class TraceScope
+{
+public:
+    TraceScope(Tracer *tracer, Tracer::Stage stage) :
+        _tracer(tracer != nullptr && tracer->isActive() ? tracer : nullptr),
+        _stage(stage),
+        _start(_tracer != nullptr ? Tracer::now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (_tracer != nullptr) {
+            _tracer->addEvent(_stage, _start, Tracer::now());
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+
+    Tracer *_tracer;
+    Tracer::Stage _stage;
+    qint64 _start;
+};
+}
+
+#endif // TRACER_H
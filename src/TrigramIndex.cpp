@@ -0,0 +1,456 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TrigramIndex.h"
+
+// Std
+#include <algorithm>
+
+// Qt
+#include <QRegularExpression>
+#include <QVarLengthArray>
+
+using namespace Konsole;
+
+// default cap on the memory taken up by an index
+static const qint64 DEFAULT_MAXIMUM_MEMORY_USAGE = 64 * 1024 * 1024;
+// approximate bytes taken up by each trigram apart from its list of lines:
+// the hash node and the list's header
+static const int TRIGRAM_OVERHEAD = 64;
+// removed lines are only taken out of the postings once there are this many
+static const quint32 MINIMUM_COMPACTION = 4096;
+// ids are reset before they can overflow
+static const quint32 MAXIMUM_ID = 0xF0000000;
+
+static inline quint64 trigram(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | c.unicode();
+}
+
+static QString caseFolded(const QString &text)
+{
+    QString folded = text;
+    for (QChar &ch : folded) {
+        ch = ch.toCaseFolded();
+    }
+    return folded;
+}
+
+TrigramIndex::TrigramIndex(int lines) :
+    _firstId(0),
+    _nextId(0),
+    _firstIndexedId(0),
+    _compactedId(0),
+    _postings(QHash<quint64, QVector<quint32>>()),
+    _capacity(0),
+    _wrappedLines(QVector<std::pair<quint32, quint32>>()),
+    _maximumMemoryUsage(DEFAULT_MAXIMUM_MEMORY_USAGE),
+    _logicalLineId(0),
+    _previousWrapped(false),
+    _tail(QString()),
+    _text(QString()),
+    _stream(&_text)
+{
+    reset(lines);
+}
+
+TrigramIndex::~TrigramIndex() = default;
+
+void TrigramIndex::reset(int lines)
+{
+    _postings.clear();
+    _capacity = 0;
+    _wrappedLines.clear();
+    _wrappedLines.squeeze();
+    _firstId = 0;
+    _nextId = lines;
+    _firstIndexedId = lines;
+    _compactedId = lines;
+    _logicalLineId = lines;
+    _previousWrapped = false;
+    _tail.clear();
+}
+
+int TrigramIndex::lineCount() const
+{
+    return static_cast<int>(_nextId - _firstId);
+}
+
+int TrigramIndex::firstIndexedLine() const
+{
+    return static_cast<int>(_firstIndexedId - _firstId);
+}
+
+void TrigramIndex::addLine(const Character *characters, int count, bool wrapped)
+{
+    if (_nextId >= MAXIMUM_ID) {
+        reset(lineCount());
+    }
+
+    const quint32 id = _nextId++;
+    const bool continued = _previousWrapped;
+    _previousWrapped = wrapped;
+
+    if (continued) {
+        // the entry is gone if the line is no longer indexed
+        if (!_wrappedLines.isEmpty() && _wrappedLines.last().first == _logicalLineId) {
+            _wrappedLines.last().second = id;
+        }
+    } else {
+        _logicalLineId = id;
+        _tail.clear();
+    }
+    if (wrapped && !continued) {
+        _wrappedLines.append({id, id});
+    }
+
+    // the start of a wrapped line is no longer indexed, so neither is the rest
+    if (_logicalLineId < _firstIndexedId) {
+        _firstIndexedId = id + 1;
+        return;
+    }
+
+    // decode the line the way the search does, so that the trigrams are
+    // those of the text searched
+    _text.clear();
+    _decoder.begin(&_stream);
+    _decoder.decodeLine(characters, count, 0);
+    _decoder.end();
+    _stream.flush();
+
+    const QString text = _tail + caseFolded(_text);
+    for (int i = 0; i + 2 < text.size(); i++) {
+        addTrigram(trigram(text.at(i), text.at(i + 1), text.at(i + 2)), _logicalLineId);
+    }
+    _tail = text.right(2);
+
+    // make room by dropping the oldest half of the indexed lines
+    while (memoryUsage() > _maximumMemoryUsage && _firstIndexedId < _nextId) {
+        setFirstIndexedId(_firstIndexedId + qMax(1u, (_nextId - _firstIndexedId) / 2));
+        compact();
+    }
+}
+
+void TrigramIndex::addTrigram(quint64 key, quint32 id)
+{
+    QVector<quint32> &lines = _postings[key];
+    if (!lines.isEmpty() && lines.last() == id) {
+        return;
+    }
+
+    const int capacity = lines.capacity();
+    lines.append(id);
+    _capacity += lines.capacity() - capacity;
+}
+
+void TrigramIndex::removeLines(int count)
+{
+    _firstId = qMin(_firstId + count, _nextId);
+    setFirstIndexedId(_firstId);
+
+    // removing a line from the postings means going through all of them,
+    // so lines are taken out in batches
+    if (_firstIndexedId - _compactedId >= qMax(MINIMUM_COMPACTION, _nextId - _firstIndexedId)) {
+        compact();
+    }
+}
+
+void TrigramIndex::setFirstIndexedId(quint32 id)
+{
+    if (id <= _firstIndexedId) {
+        return;
+    }
+
+    // a wrapped line which is no longer indexed from its start is not
+    // indexed at all, as its trigrams are filed under its first line
+    auto it = std::upper_bound(_wrappedLines.cbegin(), _wrappedLines.cend(), id,
+                               [](quint32 id, const std::pair<quint32, quint32> &lines) {
+        return id < lines.first;
+    });
+    if (it != _wrappedLines.cbegin()) {
+        --it;
+        if (it->first < id && id <= it->second) {
+            id = it->second + 1;
+        }
+    }
+
+    _firstIndexedId = qMin(id, _nextId);
+}
+
+void TrigramIndex::compact()
+{
+    _capacity = 0;
+    for (auto it = _postings.begin(); it != _postings.end();) {
+        QVector<quint32> &lines = it.value();
+        const auto end = std::lower_bound(lines.begin(), lines.end(), _firstIndexedId);
+        if (end == lines.end()) {
+            it = _postings.erase(it);
+            continue;
+        }
+        if (end != lines.begin()) {
+            lines.erase(lines.begin(), end);
+            if (lines.capacity() > 2 * lines.size()) {
+                lines.squeeze();
+            }
+        }
+        _capacity += lines.capacity();
+        ++it;
+    }
+
+    const auto wrappedEnd = std::lower_bound(_wrappedLines.begin(), _wrappedLines.end(), _firstIndexedId,
+                                             [](const std::pair<quint32, quint32> &lines, quint32 id) {
+        return lines.second < id;
+    });
+    _wrappedLines.erase(_wrappedLines.begin(), wrappedEnd);
+
+    _compactedId = _firstIndexedId;
+}
+
+QVector<int> TrigramIndex::candidateLines(const QString &literal, int startLine, int endLine) const
+{
+    QVector<int> lines;
+
+    const QString text = caseFolded(literal);
+    const int indexedStart = qMax(startLine, firstIndexedLine());
+    const int indexedEnd = qMin(endLine, lineCount() - 1);
+
+    // lines before and after the indexed ones, or all if the text is too
+    // short to have trigrams
+    const int unindexedEnd = text.size() < 3 ? endLine : qMin(endLine, indexedStart - 1);
+    for (int line = startLine; line <= unindexedEnd; line++) {
+        lines.append(line);
+    }
+    if (text.size() < 3) {
+        return lines;
+    }
+
+    QVarLengthArray<const QVector<quint32> *, 16> postings;
+    bool found = indexedStart <= indexedEnd;
+    for (int i = 0; found && i + 2 < text.size(); i++) {
+        const auto it = _postings.constFind(trigram(text.at(i), text.at(i + 1), text.at(i + 2)));
+        if (it == _postings.constEnd()) {
+            found = false;
+        } else if (std::find(postings.cbegin(), postings.cend(), &it.value()) == postings.cend()) {
+            postings.append(&it.value());
+        }
+    }
+
+    if (found) {
+        // go through the lines of the rarest trigram and look up the others
+        std::sort(postings.begin(), postings.end(), [](const QVector<quint32> *a, const QVector<quint32> *b) {
+            return a->size() < b->size();
+        });
+        const QVector<quint32> &rarest = *postings.at(0);
+        const auto begin = std::lower_bound(rarest.cbegin(), rarest.cend(), wrappedLineStart(_firstId + indexedStart));
+        const auto end = std::upper_bound(begin, rarest.cend(), _firstId + indexedEnd);
+        for (auto it = begin; it != end; ++it) {
+            bool all = true;
+            for (int i = 1; all && i < postings.size(); i++) {
+                all = std::binary_search(postings.at(i)->cbegin(), postings.at(i)->cend(), *it);
+            }
+            if (all) {
+                lines.append(qMax(static_cast<int>(*it - _firstId), indexedStart));
+            }
+        }
+    }
+
+    // the last line of the history may continue on the screen, which is not
+    // indexed, so the text may start in the history and end on the screen
+    if (indexedStart <= indexedEnd && _previousWrapped && _logicalLineId >= _firstIndexedId
+        && endLine >= lineCount()) {
+        const int line = qMax(static_cast<int>(_logicalLineId - _firstId), indexedStart);
+        if (lines.isEmpty() || lines.last() != line) {
+            lines.append(line);
+        }
+    }
+
+    for (int line = qMax(startLine, lineCount()); line <= endLine; line++) {
+        lines.append(line);
+    }
+    return lines;
+}
+
+quint32 TrigramIndex::wrappedLineStart(quint32 id) const
+{
+    auto it = std::upper_bound(_wrappedLines.cbegin(), _wrappedLines.cend(), id,
+                               [](quint32 id, const std::pair<quint32, quint32> &lines) {
+        return id < lines.first;
+    });
+    if (it != _wrappedLines.cbegin()) {
+        --it;
+        if (it->first < id && id <= it->second) {
+            return it->first;
+        }
+    }
+    return id;
+}
+
+qint64 TrigramIndex::memoryUsage() const
+{
+    return _capacity * static_cast<qint64>(sizeof(quint32))
+           + _postings.size() * static_cast<qint64>(TRIGRAM_OVERHEAD)
+           + _wrappedLines.capacity() * static_cast<qint64>(sizeof(std::pair<quint32, quint32>));
+}
+
+void TrigramIndex::setMaximumMemoryUsage(qint64 bytes)
+{
+    _maximumMemoryUsage = bytes;
+}
+
+qint64 TrigramIndex::maximumMemoryUsage() const
+{
+    return _maximumMemoryUsage;
+}
+
+QString TrigramIndex::requiredLiteral(const QRegularExpression &regExp)
+{
+    if (!regExp.isValid() || (regExp.patternOptions() & QRegularExpression::ExtendedPatternSyntaxOption) != 0) {
+        return QString();
+    }
+
+    // only literal characters outside of groups are collected, as groups
+    // may be optional; anything which could make a literal optional that is
+    // not understood here gives up
+    const QString pattern = regExp.pattern();
+    const int length = pattern.size();
+    QString longest;
+    QString run;
+    bool lastWasLiteral = false;
+    int depth = 0;
+
+    for (int i = 0; i < length; i++) {
+        const QChar ch = pattern.at(i);
+        QChar literal;
+        bool isLiteral = false;
+        bool isQuantifier = false;
+        int minimum = 0;
+
+        if (ch == QLatin1Char('\\')) {
+            if (i + 1 == length) {
+                return QString();
+            }
+            const QChar next = pattern.at(++i);
+            if (!next.isLetterOrNumber()) {
+                literal = next;
+                isLiteral = true;
+            } else if (!QStringLiteral("dDwWsShHvVbBAzZG").contains(next)) {
+                // references, code points, \Q...\E quoting and the like
+                return QString();
+            }
+        } else if (ch == QLatin1Char('[')) {
+            int j = i + 1;
+            if (j < length && pattern.at(j) == QLatin1Char('^')) {
+                j++;
+            }
+            if (j < length && pattern.at(j) == QLatin1Char(']')) {
+                j++;
+            }
+            while (j < length && pattern.at(j) != QLatin1Char(']')) {
+                if (pattern.at(j) == QLatin1Char('\\')) {
+                    j++;
+                } else if (pattern.at(j) == QLatin1Char('[') && j + 1 < length && pattern.at(j + 1) == QLatin1Char(':')) {
+                    return QString();
+                }
+                j++;
+            }
+            if (j >= length) {
+                return QString();
+            }
+            i = j;
+        } else if (ch == QLatin1Char('(')) {
+            if (i + 1 < length && pattern.at(i + 1) == QLatin1Char('*')) {
+                return QString();
+            }
+            if (i + 1 < length && pattern.at(i + 1) == QLatin1Char('?')) {
+                // inline options which change how the pattern is read
+                for (int j = i + 2; j < length && pattern.at(j).isLetter(); j++) {
+                    if (pattern.at(j) == QLatin1Char('x')) {
+                        return QString();
+                    }
+                }
+            }
+            depth++;
+        } else if (ch == QLatin1Char(')')) {
+            depth--;
+        } else if (ch == QLatin1Char('|')) {
+            if (depth == 0) {
+                return QString();
+            }
+        } else if (ch == QLatin1Char('*') || ch == QLatin1Char('?')) {
+            isQuantifier = true;
+        } else if (ch == QLatin1Char('+')) {
+            isQuantifier = true;
+            minimum = 1;
+        } else if (ch == QLatin1Char('{')) {
+            // a quantifier if it has the form {n}, {n,} or {n,m}, else a literal
+            int j = i + 1;
+            while (j < length && pattern.at(j).isDigit()) {
+                j++;
+            }
+            const int digits = j - i - 1;
+            if (j < length && pattern.at(j) == QLatin1Char(',')) {
+                j++;
+                while (j < length && pattern.at(j).isDigit()) {
+                    j++;
+                }
+            }
+            if (digits > 0 && j < length && pattern.at(j) == QLatin1Char('}')) {
+                isQuantifier = true;
+                minimum = pattern.midRef(i + 1, digits).toInt();
+                i = j;
+            } else {
+                literal = ch;
+                isLiteral = true;
+            }
+        } else if (ch != QLatin1Char('.') && ch != QLatin1Char('^') && ch != QLatin1Char('$')) {
+            literal = ch;
+            isLiteral = true;
+        }
+
+        if (isQuantifier) {
+            // a character which may be left out is not required
+            if (lastWasLiteral && minimum == 0) {
+                run.chop(run.size() > 1 && run.at(run.size() - 1).isLowSurrogate() ? 2 : 1);
+            }
+            // lazy and possessive quantifiers
+            if (i + 1 < length && (pattern.at(i + 1) == QLatin1Char('?') || pattern.at(i + 1) == QLatin1Char('+'))) {
+                i++;
+            }
+        }
+
+        if (isLiteral && depth == 0) {
+            run.append(literal);
+            lastWasLiteral = true;
+        } else {
+            if (run.size() > longest.size()) {
+                longest = run;
+            }
+            run.clear();
+            lastWasLiteral = false;
+        }
+    }
+
+    if (run.size() > longest.size()) {
+        longest = run;
+    }
+    return longest;
+}
@@ -0,0 +1,147 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+// Std
+#include <utility>
+
+// Qt
+#include <QHash>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+// Konsole
+#include "Character.h"
+#include "TerminalCharacterDecoder.h"
+
+class QRegularExpression;
+
+namespace Konsole {
+/**
+ * An index of the three character sequences in the lines of a screen's
+ * history, used to find the lines which may contain a search text without
+ * decoding and searching all of them.
+ *
+ * Lines are added with addLine() as they move into the history and removed
+ * with removeLines() when the history drops them.  Each trigram maps to the
+ * sorted list of lines it occurs in; wrapped lines are indexed together with
+ * the lines they continue on, as the search sees them joined.  Trigrams are
+ * case folded, so the same index serves case sensitive and insensitive
+ * searches.
+ *
+ * The memory the index takes up is capped: when it grows beyond the cap the
+ * oldest half of the indexed lines is dropped from the index.  Lines which
+ * are not indexed, whether dropped or added before the index was created,
+ * are reported as candidates for every search.
+ */
+class KONSOLEPRIVATE_EXPORT TrigramIndex
+{
+public:
+    /**
+     * Constructs an index for a history which holds @p lines lines already.
+     * Those lines are not indexed.
+     */
+    explicit TrigramIndex(int lines = 0);
+    ~TrigramIndex();
+
+    /**
+     * Indexes a line added to the end of the history.  @p wrapped is true if
+     * the line continues on the next one.
+     */
+    void addLine(const Character *characters, int count, bool wrapped);
+    /** Forgets the @p count oldest lines, which the history has dropped */
+    void removeLines(int count);
+    /** Empties the index for a history which holds @p lines unindexed lines */
+    void reset(int lines);
+
+    /** Returns the number of lines in the history */
+    int lineCount() const;
+    /** Returns the first line of the history which is indexed */
+    int firstIndexedLine() const;
+
+    /**
+     * Returns the lines from @p startLine to @p endLine which may contain
+     * @p literal, in ascending order.  For the lines which are indexed these
+     * are the first lines of those (possibly wrapped) lines which contain all
+     * trigrams of @p literal, or @p startLine for such a line which starts
+     * before it and wraps onto it.  Lines which are not indexed, including
+     * those beyond the end of the history, are always returned, as are all
+     * lines if @p literal is shorter than three characters.  So is the last
+     * wrapped line of the history, as it continues beyond the end.
+     */
+    QVector<int> candidateLines(const QString &literal, int startLine, int endLine) const;
+
+    /** Returns the bytes of memory taken up by the index */
+    qint64 memoryUsage() const;
+    /** Sets the bytes of memory the index may take up */
+    void setMaximumMemoryUsage(qint64 bytes);
+    qint64 maximumMemoryUsage() const;
+
+    /**
+     * Returns the longest text which every match for @p regExp contains, or
+     * an empty string if there is none or the pattern is too involved to
+     * tell.  Case is ignored when looking up the result with candidateLines(),
+     * so it is also valid for case insensitive expressions.
+     */
+    static QString requiredLiteral(const QRegularExpression &regExp);
+
+private:
+    Q_DISABLE_COPY(TrigramIndex)
+
+    void addTrigram(quint64 key, quint32 id);
+    // returns the first line of the wrapped line which line @p id is part of
+    quint32 wrappedLineStart(quint32 id) const;
+    void setFirstIndexedId(quint32 id);
+    void compact();
+
+    // lines are identified by the number of lines added before them; line 0
+    // of the history has id _firstId
+    quint32 _firstId;
+    quint32 _nextId;
+    // lines before this one are not indexed
+    quint32 _firstIndexedId;
+    // lines before this one have been removed from the postings
+    quint32 _compactedId;
+
+    // the lines each trigram occurs in, by the id of their first line
+    QHash<quint64, QVector<quint32>> _postings;
+    // the entries allocated for the postings
+    qint64 _capacity;
+    // first and last lines of the lines which wrap onto the next one
+    QVector<std::pair<quint32, quint32>> _wrappedLines;
+    qint64 _maximumMemoryUsage;
+
+    // the first line of the line being added, which continues while
+    // _previousWrapped is set, and its last two characters
+    quint32 _logicalLineId;
+    bool _previousWrapped;
+    QString _tail;
+
+    PlainTextDecoder _decoder;
+    QString _text;
+    QTextStream _stream;
+};
+}
+
+#endif // TRIGRAMINDEX_H
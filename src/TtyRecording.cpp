@@ -0,0 +1,155 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TtyRecording.h"
+
+// Std
+#include <chrono>
+
+// Qt
+#include <QtEndian>
+
+using namespace Konsole;
+
+// size of the header in front of each block: seconds, microseconds, length
+static const int HEADER_SIZE = 3 * sizeof(quint32);
+// larger blocks are taken to be a sign of a damaged file
+static const quint32 MAXIMUM_FRAME_SIZE = 64 * 1024 * 1024;
+
+TtyRecorder::TtyRecorder() :
+    _file()
+{
+}
+
+TtyRecorder::~TtyRecorder()
+{
+    close();
+}
+
+bool TtyRecorder::open(const QString &fileName)
+{
+    close();
+    _file.setFileName(fileName);
+    return _file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+}
+
+void TtyRecorder::close()
+{
+    if (_file.isOpen()) {
+        _file.close();
+    }
+}
+
+bool TtyRecorder::isOpen() const
+{
+    return _file.isOpen();
+}
+
+QString TtyRecorder::fileName() const
+{
+    return _file.fileName();
+}
+
+QString TtyRecorder::errorString() const
+{
+    return _file.errorString();
+}
+
+void TtyRecorder::record(const char *data, int length)
+{
+    if (!_file.isOpen() || length <= 0) {
+        return;
+    }
+
+    const qint64 now = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::system_clock::now().time_since_epoch()).count();
+
+    uchar header[HEADER_SIZE];
+    qToLittleEndian<quint32>(static_cast<quint32>(now / 1000000), header);
+    qToLittleEndian<quint32>(static_cast<quint32>(now % 1000000), header + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(length), header + 8);
+
+    // QFile buffers the writes, so this does not cost a system call per block
+    _file.write(reinterpret_cast<const char *>(header), HEADER_SIZE);
+    _file.write(data, length);
+}
+
+TtyRecordingReader::TtyRecordingReader() :
+    _file(),
+    _errorString(QString())
+{
+}
+
+TtyRecordingReader::~TtyRecordingReader() = default;
+
+bool TtyRecordingReader::open(const QString &fileName)
+{
+    close();
+    _file.setFileName(fileName);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _errorString = _file.errorString();
+        return false;
+    }
+    _errorString.clear();
+    return true;
+}
+
+void TtyRecordingReader::close()
+{
+    if (_file.isOpen()) {
+        _file.close();
+    }
+}
+
+bool TtyRecordingReader::readFrame(Frame &frame)
+{
+    uchar header[HEADER_SIZE];
+    const qint64 headerRead = _file.read(reinterpret_cast<char *>(header), HEADER_SIZE);
+    if (headerRead == 0) {
+        return false;
+    }
+    if (headerRead != HEADER_SIZE) {
+        _errorString = QStringLiteral("Truncated block header");
+        return false;
+    }
+
+    const quint32 seconds = qFromLittleEndian<quint32>(header);
+    const quint32 microseconds = qFromLittleEndian<quint32>(header + 4);
+    const quint32 length = qFromLittleEndian<quint32>(header + 8);
+    if (microseconds >= 1000000 || length > MAXIMUM_FRAME_SIZE) {
+        _errorString = QStringLiteral("Invalid block header");
+        return false;
+    }
+
+    frame.time = static_cast<qint64>(seconds) * 1000000 + microseconds;
+    frame.data.resize(static_cast<int>(length));
+    if (_file.read(frame.data.data(), length) != length) {
+        _errorString = QStringLiteral("Truncated block");
+        return false;
+    }
+    return true;
+}
+
+QString TtyRecordingReader::errorString() const
+{
+    return _errorString;
+}
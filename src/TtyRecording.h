@@ -0,0 +1,106 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef TTYRECORDING_H
+#define TTYRECORDING_H
+
+// Qt
+#include <QByteArray>
+#include <QFile>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+/**
+ * Records the output received by a terminal to a file, so that it can be
+ * replayed later, for instance to reproduce a performance problem.
+ *
+ * The file uses the ttyrec format: every block of output is preceded by a
+ * header of three 32-bit little-endian integers, the seconds and
+ * microseconds of the time it was received and the length of the block.
+ * Such files can also be played back with ttyplay and similar tools.
+ */
+class KONSOLEPRIVATE_EXPORT TtyRecorder
+{
+public:
+    TtyRecorder();
+    ~TtyRecorder();
+
+    /** Starts recording to @p fileName, replacing any previous contents. */
+    bool open(const QString &fileName);
+    /** Stops recording and closes the file. */
+    void close();
+    bool isOpen() const;
+
+    /** Returns the name of the file being recorded to */
+    QString fileName() const;
+    /** Returns a description of the last error which occurred */
+    QString errorString() const;
+
+    /** Appends @p length bytes of @p data, received now, to the recording */
+    void record(const char *data, int length);
+
+private:
+    Q_DISABLE_COPY(TtyRecorder)
+
+    QFile _file;
+};
+
+/**
+ * Reads the blocks of output from a recording written by TtyRecorder.
+ */
+class KONSOLEPRIVATE_EXPORT TtyRecordingReader
+{
+public:
+    struct Frame {
+        // time the block was received, in microseconds since the epoch
+        qint64 time;
+        QByteArray data;
+    };
+
+    TtyRecordingReader();
+    ~TtyRecordingReader();
+
+    bool open(const QString &fileName);
+    void close();
+
+    /**
+     * Reads the next block of the recording into @p frame.  Returns false
+     * at the end of the recording or if it is damaged, see errorString().
+     */
+    bool readFrame(Frame &frame);
+
+    /**
+     * Returns a description of the last error which occurred, or an
+     * empty string if the end of the recording was reached.
+     */
+    QString errorString() const;
+
+private:
+    Q_DISABLE_COPY(TtyRecordingReader)
+
+    QFile _file;
+    QString _errorString;
+};
+}
+
+#endif // TTYRECORDING_H
@@ -0,0 +1,118 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "Utf8Decoder.h"
+
+using namespace Konsole;
+
+static const uint REPLACEMENT_CHARACTER = 0xFFFD;
+static const uint BYTE_ORDER_MARK = 0xFEFF;
+
+Utf8Decoder::Utf8Decoder() :
+    _codePoint(0),
+    _minimumCodePoint(0),
+    _remaining(0),
+    _headerDone(false)
+{
+}
+
+void Utf8Decoder::reset()
+{
+    _codePoint = 0;
+    _minimumCodePoint = 0;
+    _remaining = 0;
+    _headerDone = false;
+}
+
+void Utf8Decoder::decode(const char *text, int length, QVector<uint> &output)
+{
+    // Every input byte produces at most one code point, plus one replacement
+    // character for a sequence left incomplete by the previous call.
+    // QVector keeps its capacity when shrinking, so once the buffer has
+    // reached the size of a typical read this does not allocate.
+    output.resize(length + 1);
+
+    const auto *in = reinterpret_cast<const uchar *>(text);
+    const uchar *const end = in + length;
+    uint *out = output.data();
+
+    while (in != end) {
+        if (_remaining == 0) {
+            // ASCII fast path: the bulk of terminal output is plain 7-bit text
+            const uchar *runStart = in;
+            while (in != end && *in < 0x80) {
+                *out++ = *in++;
+            }
+            if (in != runStart) {
+                _headerDone = true;
+            }
+            if (in == end) {
+                break;
+            }
+
+            const uchar ch = *in++;
+            if (ch >= 0xC2 && ch <= 0xDF) {
+                _codePoint = ch & 0x1F;
+                _minimumCodePoint = 0x80;
+                _remaining = 1;
+            } else if (ch >= 0xE0 && ch <= 0xEF) {
+                _codePoint = ch & 0x0F;
+                _minimumCodePoint = 0x800;
+                _remaining = 2;
+            } else if (ch >= 0xF0 && ch <= 0xF4) {
+                _codePoint = ch & 0x07;
+                _minimumCodePoint = 0x10000;
+                _remaining = 3;
+            } else {
+                // stray continuation byte or a lead byte which can only
+                // start an overlong or out of range sequence
+                *out++ = REPLACEMENT_CHARACTER;
+                _headerDone = true;
+            }
+            continue;
+        }
+
+        const uchar ch = *in;
+        if ((ch & 0xC0) != 0x80) {
+            // the sequence was cut short; the current byte starts afresh
+            *out++ = REPLACEMENT_CHARACTER;
+            _remaining = 0;
+            _headerDone = true;
+            continue;
+        }
+
+        ++in;
+        _codePoint = (_codePoint << 6) | (ch & 0x3F);
+        if (--_remaining == 0) {
+            if (_codePoint < _minimumCodePoint || _codePoint > 0x10FFFF
+                || (_codePoint >= 0xD800 && _codePoint <= 0xDFFF)) {
+                *out++ = REPLACEMENT_CHARACTER;
+            } else if (_codePoint != BYTE_ORDER_MARK || _headerDone) {
+                *out++ = _codePoint;
+            }
+            // only a byte order mark at the very start of the stream is dropped
+            _headerDone = true;
+        }
+    }
+
+    output.resize(static_cast<int>(out - output.constData()));
+}
@@ -0,0 +1,77 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+#ifndef UTF8DECODER_H
+#define UTF8DECODER_H
+
+// Qt
+#include <QVector>
+
+// Konsole
+#include "konsoleprivate_export.h"
+
+namespace Konsole {
+/**
+ * An incremental UTF-8 to UCS-4 decoder for the terminal input stream.
+ *
+ * Unlike QTextDecoder, which produces a UTF-16 QString that then has to be
+ * converted again with QString::toUcs4(), this decodes straight into a
+ * caller-owned vector of code points.  The vector is resized in place, so
+ * once it has grown to the size of a typical read no further allocations
+ * take place.
+ *
+ * Multi-byte sequences which are split across calls to decode() are kept
+ * and completed by the next call.  Malformed input (stray continuation
+ * bytes, overlong forms, surrogates and values beyond U+10FFFF) is replaced
+ * by U+FFFD, matching what QTextCodec's UTF-8 decoder does.
+ */
+class KONSOLEPRIVATE_EXPORT Utf8Decoder
+{
+public:
+    Utf8Decoder();
+
+    /**
+     * Decodes @p length bytes from @p text and stores the resulting
+     * code points in @p output, replacing its previous contents.
+     *
+     * Bytes belonging to an incomplete sequence at the end of @p text are
+     * held back until the next call.
+     */
+    void decode(const char *text, int length, QVector<uint> &output);
+
+    /** Discards any partially decoded sequence and restarts the stream. */
+    void reset();
+
+private:
+    // the code point being assembled from a multi-byte sequence
+    uint _codePoint;
+    // smallest code point allowed for the current sequence length,
+    // used to reject overlong encodings
+    uint _minimumCodePoint;
+    // number of continuation bytes still expected for _codePoint
+    int _remaining;
+    // true once the first character of the stream has been seen, so that
+    // only a leading byte order mark is skipped
+    bool _headerDone;
+};
+}
+
+#endif // UTF8DECODER_H
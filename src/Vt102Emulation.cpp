@@ -29,6 +29,7 @@
 
 // Qt
 #include <QEvent>
+#include <QMutexLocker>
 #include <QTimer>
 #include <QKeyEvent>
 
@@ -36,9 +37,8 @@
 #include <KLocalizedString>
 
 // Konsole
+#include "EmulationScheduler.h"
 #include "KeyboardTranslator.h"
-#include "SessionController.h"
-#include "TerminalDisplay.h"
 
 using Konsole::Vt102Emulation;
 
@@ -79,16 +79,25 @@ Vt102Emulation::Vt102Emulation() :
     initTokenizer();
 }
 
-Vt102Emulation::~Vt102Emulation() = default;
+Vt102Emulation::~Vt102Emulation()
+{
+    // no chunk of output may still be processed once the members are gone
+    if (EmulationScheduler::instance() != nullptr) {
+        EmulationScheduler::instance()->cancel(this);
+    }
+}
 
 void Vt102Emulation::clearEntireScreen()
 {
+    QMutexLocker locker(mutex());
     _currentScreen->clearEntireScreen();
     bufferedUpdate();
 }
 
 void Vt102Emulation::reset()
 {
+    QMutexLocker locker(mutex());
+
     // Save the current codec so we can set it later.
     // Ideally we would want to use the profile setting
     const QTextCodec *currentCodec = codec();
@@ -159,6 +168,8 @@ void Vt102Emulation::reset()
                   (3rd field is a space)
    - CSI_PSP    - Escape codes of the form <ESC>'[' '{Pn}' ' ' C
                   (4th field is a space)
+   - CSI_PQ     - Escape codes of the form <ESC>'[' '?' {Pn} '$' C
+                  (mode queries, DECRQM)
    - VT52       - VT52 escape codes
                   - <ESC><Chr>
                   - <ESC>'Y'{Pc}{Pc}
@@ -229,6 +240,10 @@ constexpr int token_csi_psp(int a, int n)
 {
     return token_construct(12, a, n);
 }
+constexpr int token_csi_pq(int a)
+{
+    return token_construct(13, a, 0);
+}
 
 const int MAX_ARGUMENT = 4096;
 
@@ -341,6 +356,7 @@ void Vt102Emulation::initTokenizer()
 #define egt( )     (p >=  3  && s[2] == '>')
 #define esp( )     (p >=  4  && s[2] == SP )
 #define epsp( )    (p >=  5  && s[3] == SP )
+#define epq( )     (p >=  5  && s[2] == '?' && s[p-2] == '$')
 #define osc        (tokenBufferPos >= 2 && tokenBuffer[1] == ']')
 #define ces(C)     (cc < 256 && (charClass[cc] & (C)) == (C))
 #define dcs        (p >= 2   && s[0] == ESC && s[1] == 'P')
@@ -429,6 +445,9 @@ void Vt102Emulation::receiveChar(uint cc)
     if (esp (   )) { processToken(token_csi_sp(cc), 0, 0);           resetTokenizer(); return; }
     if (epsp(   )) { processToken(token_csi_psp(cc, argv[0]), 0, 0); resetTokenizer(); return; }
 
+    if (epq (   )) { processToken(token_csi_pq(cc), argv[0], 0);      resetTokenizer(); return; }
+    if (epp() && eec('$')) { return; }
+
     if (ees(DIG)) { addDigit(cc-'0'); return; }
     if (eec(';')) { addArgument();    return; }
     for (int i = 0; i <= argc; i++)
@@ -517,17 +536,22 @@ void Vt102Emulation::processSessionAttributeRequest(int tokenSize)
   }
 
   _pendingSessionAttributesUpdates[attribute] = value;
-  _sessionAttributesUpdateTimer->start(20);
+  runInOwnThread([this]() { _sessionAttributesUpdateTimer->start(20); });
 }
 
 void Vt102Emulation::updateSessionAttributes()
 {
-    QListIterator<int> iter(_pendingSessionAttributesUpdates.keys());
+    QHash<int, QString> updates;
+    {
+        QMutexLocker locker(mutex());
+        updates.swap(_pendingSessionAttributesUpdates);
+    }
+
+    QListIterator<int> iter(updates.keys());
     while (iter.hasNext()) {
         int arg = iter.next();
-        emit sessionAttributeChanged(arg , _pendingSessionAttributesUpdates[arg]);
+        emit sessionAttributeChanged(arg , updates.value(arg));
     }
-    _pendingSessionAttributesUpdates.clear();
 }
 
 // Interpreting Codes ---------------------------------------------------------
@@ -916,6 +940,16 @@ void Vt102Emulation::processToken(int token, int p, int q)
     case token_csi_pr('s', 2004) :         saveMode      (MODE_BracketedPaste); break; //XTERM
     case token_csi_pr('r', 2004) :      restoreMode      (MODE_BracketedPaste); break; //XTERM
 
+    // Synchronized output: programs such as tmux and neovim bracket a redraw
+    // with these so that a partially drawn frame is never shown
+    case token_csi_pr('h', 2026) :          setMode      (MODE_SynchronizedUpdate); break;
+    case token_csi_pr('l', 2026) :        resetMode      (MODE_SynchronizedUpdate); break;
+    case token_csi_pr('s', 2026) :         saveMode      (MODE_SynchronizedUpdate); break;
+    case token_csi_pr('r', 2026) :      restoreMode      (MODE_SynchronizedUpdate); break;
+
+    // Request private mode (DECRQM)
+    case token_csi_pq('p'      ) :      reportPrivateMode    (p         ); break; //VT300
+
     // Set Cursor Style (DECSCUSR), VT520, with the extra xterm sequences
     // the first one is a special case, 'ESC[ q', which mimics 'ESC[1 q'
     // Using 0 to reset to default is matching VTE, but not any official standard.
@@ -1024,6 +1058,43 @@ void Vt102Emulation::reportTerminalParms(int p)
     sendString(tmp);
 }
 
+/* DECRQM – Request Mode, DEC private modes
+    ESC [ ? <mode> $ y  is answered with  ESC [ ? <mode> ; <state> $ y
+
+    state: 0 = not recognized, 1 = set, 2 = reset
+*/
+void Vt102Emulation::reportPrivateMode(int p)
+{
+    int mode = -1;
+    switch (p) {
+    case 1:    mode = MODE_AppCuKeys;          break;
+    case 3:    mode = MODE_132Columns;         break;
+    case 25:   mode = MODE_Cursor;             break;
+    case 40:   mode = MODE_Allow132Columns;    break;
+    case 47:
+    case 1047:
+    case 1049: mode = MODE_AppScreen;          break;
+    case 1000: mode = MODE_Mouse1000;          break;
+    case 1002: mode = MODE_Mouse1002;          break;
+    case 1003: mode = MODE_Mouse1003;          break;
+    case 1005: mode = MODE_Mouse1005;          break;
+    case 1006: mode = MODE_Mouse1006;          break;
+    case 1007: mode = MODE_Mouse1007;          break;
+    case 1015: mode = MODE_Mouse1015;          break;
+    case 2004: mode = MODE_BracketedPaste;     break;
+    case 2026: mode = MODE_SynchronizedUpdate; break;
+    }
+
+    int state = 0;
+    if (mode >= 0) {
+        state = getMode(mode) ? 1 : 2;
+    }
+
+    char tmp[30];
+    snprintf(tmp, sizeof(tmp), "\033[?%d;%d$y", p, state);
+    sendString(tmp);
+}
+
 void Vt102Emulation::reportStatus()
 {
     sendString("\033[0n"); //VT100. Device status report. 0 = Ready.
@@ -1049,6 +1120,8 @@ void Vt102Emulation::reportAnswerBack()
 
 void Vt102Emulation::sendMouseEvent(int cb, int cx, int cy, int eventType)
 {
+    QMutexLocker locker(mutex());
+
     if (cx < 1 || cy < 1) {
         return;
     }
@@ -1105,6 +1178,7 @@ void Vt102Emulation::sendMouseEvent(int cb, int cx, int cy, int eventType)
  * https://github.com/sjl/vitality.vim
  */
 void Vt102Emulation::focusChanged(bool focused) {
+    QMutexLocker locker(mutex());
     if (_reportFocusEvents) {
         sendString(focused ? "\033[I" : "\033[O");
     }
@@ -1123,14 +1197,12 @@ void Vt102Emulation::sendText(const QString &text)
 
 void Vt102Emulation::sendKeyEvent(QKeyEvent *event)
 {
+    QMutexLocker locker(mutex());
+
     const Qt::KeyboardModifiers modifiers = event->modifiers();
     KeyboardTranslator::States states = KeyboardTranslator::NoState;
 
-    TerminalDisplay * currentView = _currentScreen->currentTerminalDisplay();
-    bool isReadOnly = false;
-    if (currentView != nullptr && currentView->sessionController() != nullptr) {
-        isReadOnly = currentView->sessionController()->isReadOnly();
-    }
+    const bool isReadOnly = this->isReadOnly();
 
     // get current states
     if (getMode(MODE_NewLine)) {
@@ -1199,21 +1271,19 @@ void Vt102Emulation::sendKeyEvent(QKeyEvent *event)
             if ((entry.command() & KeyboardTranslator::EraseCommand) != 0) {
                 textToSend += eraseChar();
             }
-            if (currentView != nullptr) {
-                if ((entry.command() & KeyboardTranslator::ScrollPageUpCommand) != 0) {
-                    currentView->scrollScreenWindow(ScreenWindow::ScrollPages, -1);
-                } else if ((entry.command() & KeyboardTranslator::ScrollPageDownCommand) != 0) {
-                    currentView->scrollScreenWindow(ScreenWindow::ScrollPages, 1);
-                } else if ((entry.command() & KeyboardTranslator::ScrollLineUpCommand) != 0) {
-                    currentView->scrollScreenWindow(ScreenWindow::ScrollLines, -1);
-                } else if ((entry.command() & KeyboardTranslator::ScrollLineDownCommand) != 0) {
-                    currentView->scrollScreenWindow(ScreenWindow::ScrollLines, 1);
-                } else if ((entry.command() & KeyboardTranslator::ScrollUpToTopCommand) != 0) {
-                    currentView->scrollScreenWindow(ScreenWindow::ScrollLines,
-                                                    - currentView->screenWindow()->currentLine());
-                } else if ((entry.command() & KeyboardTranslator::ScrollDownToBottomCommand) != 0) {
-                    currentView->scrollScreenWindow(ScreenWindow::ScrollLines, lineCount());
-                }
+            if ((entry.command() & KeyboardTranslator::ScrollPageUpCommand) != 0) {
+                emit scrollViewRequest(ScreenWindow::ScrollPages, -1);
+            } else if ((entry.command() & KeyboardTranslator::ScrollPageDownCommand) != 0) {
+                emit scrollViewRequest(ScreenWindow::ScrollPages, 1);
+            } else if ((entry.command() & KeyboardTranslator::ScrollLineUpCommand) != 0) {
+                emit scrollViewRequest(ScreenWindow::ScrollLines, -1);
+            } else if ((entry.command() & KeyboardTranslator::ScrollLineDownCommand) != 0) {
+                emit scrollViewRequest(ScreenWindow::ScrollLines, 1);
+            } else if ((entry.command() & KeyboardTranslator::ScrollUpToTopCommand) != 0) {
+                // scrolling is clamped to the top of the history
+                emit scrollViewRequest(ScreenWindow::ScrollLines, -lineCount());
+            } else if ((entry.command() & KeyboardTranslator::ScrollDownToBottomCommand) != 0) {
+                emit scrollViewRequest(ScreenWindow::ScrollLines, lineCount());
             }
         } else if (!entry.text().isEmpty()) {
             textToSend += entry.text(true,modifiers);
@@ -1222,6 +1292,7 @@ void Vt102Emulation::sendKeyEvent(QKeyEvent *event)
         }
 
         if (!isReadOnly) {
+            userInputSent();
             emit sendData(textToSend);
         }
     } else {
@@ -1383,6 +1454,7 @@ void Vt102Emulation::resetModes()
     resetMode(MODE_Mouse1006);  saveMode(MODE_Mouse1006);
     resetMode(MODE_Mouse1015);  saveMode(MODE_Mouse1015);
     resetMode(MODE_BracketedPaste);  saveMode(MODE_BracketedPaste);
+    resetMode(MODE_SynchronizedUpdate);  saveMode(MODE_SynchronizedUpdate);
 
     resetMode(MODE_AppScreen);  saveMode(MODE_AppScreen);
     resetMode(MODE_AppCuKeys);  saveMode(MODE_AppCuKeys);
@@ -1416,6 +1488,10 @@ void Vt102Emulation::setMode(int m)
         emit programBracketedPasteModeChanged(true);
         break;
 
+    case MODE_SynchronizedUpdate:
+        beginSynchronizedUpdate();
+        break;
+
     case MODE_AppScreen:
         _screen[1]->setDefaultRendition();
         _screen[1]->clearSelection();
@@ -1453,6 +1529,10 @@ void Vt102Emulation::resetMode(int m)
         emit programBracketedPasteModeChanged(false);
         break;
 
+    case MODE_SynchronizedUpdate:
+        endSynchronizedUpdate();
+        break;
+
     case MODE_AppScreen:
         _screen[0]->clearSelection();
         setScreen(0);
@@ -1466,6 +1546,15 @@ void Vt102Emulation::resetMode(int m)
     }
 }
 
+void Vt102Emulation::synchronizedUpdateTimedOut()
+{
+    QMutexLocker locker(mutex());
+
+    // the program has given up on (or forgotten) the update; report the
+    // mode as reset from now on, so that a late ?2026l finds nothing to end
+    resetMode(MODE_SynchronizedUpdate);
+}
+
 void Vt102Emulation::saveMode(int m)
 {
     _savedModes.mode[m] = _currentModes.mode[m];
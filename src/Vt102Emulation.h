@@ -48,7 +48,8 @@ class QKeyEvent;
 #define MODE_132Columns      (MODES_SCREEN+12)  // 80 <-> 132 column mode switch (DECCOLM)
 #define MODE_Allow132Columns (MODES_SCREEN+13)  // Allow DECCOLM mode
 #define MODE_BracketedPaste  (MODES_SCREEN+14)  // Xterm-style bracketed paste mode
-#define MODE_total           (MODES_SCREEN+15)
+#define MODE_SynchronizedUpdate (MODES_SCREEN+15)  // Hold back screen updates until the frame is complete
+#define MODE_total           (MODES_SCREEN+16)
 
 namespace Konsole {
 extern unsigned short vt100_graphics[32];
@@ -73,7 +74,7 @@ struct CharCodes {
  * sequences.
  *
  */
-class Vt102Emulation : public Emulation
+class KONSOLEPRIVATE_EXPORT Vt102Emulation : public Emulation
 {
     Q_OBJECT
 
@@ -99,6 +100,7 @@ protected:
     // reimplemented from Emulation
     void setMode(int mode) override;
     void resetMode(int mode) override;
+    void synchronizedUpdateTimedOut() override;
     void receiveChar(uint cc) override;
 
 private Q_SLOTS:
@@ -158,6 +160,7 @@ private:
     void reportAnswerBack();
     void reportCursorPosition();
     void reportTerminalParms(int p);
+    void reportPrivateMode(int p);
 
     // clears the screen and resizes it to the specified
     // number of columns
@@ -0,0 +1,119 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "DirectoryListingTest.h"
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+// KDE
+#include <qtest.h>
+
+#include "../DirectoryListing.h"
+
+using namespace Konsole;
+
+static void createFile(const QString &path)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+}
+
+void DirectoryListingTest::testContainsPrefixOf()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    createFile(dir.filePath(QStringLiteral("main.cpp")));
+    createFile(dir.filePath(QStringLiteral("main.h")));
+    createFile(dir.filePath(QStringLiteral("zeta")));
+    QVERIFY(QDir(dir.path()).mkdir(QStringLiteral("src")));
+
+    const QSharedPointer<DirectoryListing> listing = DirectoryListing::forDirectory(dir.path());
+    QCOMPARE(listing->path(), QDir(dir.path()).canonicalPath() + QLatin1Char('/'));
+    QCOMPARE(listing->entries(), QStringList({QStringLiteral("."), QStringLiteral(".."),
+                                              QStringLiteral("main.cpp"), QStringLiteral("main.h"),
+                                              QStringLiteral("src"), QStringLiteral("zeta")}));
+
+    QVERIFY(listing->containsPrefixOf(QStringLiteral("main.cpp")));
+    QVERIFY(listing->containsPrefixOf(QStringLiteral("main.cpp:12:5")));
+    QVERIFY(listing->containsPrefixOf(QStringLiteral("src/Filter.cpp")));
+    QVERIFY(listing->containsPrefixOf(QStringLiteral("zetas")));
+    QVERIFY(listing->containsPrefixOf(QStringLiteral("./main.h")));
+    QVERIFY(!listing->containsPrefixOf(QStringLiteral("main")));
+    QVERIFY(!listing->containsPrefixOf(QStringLiteral("main.c")));
+    QVERIFY(!listing->containsPrefixOf(QStringLiteral("sr")));
+    QVERIFY(!listing->containsPrefixOf(QStringLiteral("other")));
+    QVERIFY(!listing->containsPrefixOf(QString()));
+}
+
+void DirectoryListingTest::testShared()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QSharedPointer<DirectoryListing> listing = DirectoryListing::forDirectory(dir.path());
+    QCOMPARE(DirectoryListing::forDirectory(dir.path() + QStringLiteral("/.")), listing);
+
+    QTemporaryDir other;
+    QVERIFY(other.isValid());
+    QVERIFY(DirectoryListing::forDirectory(other.path()) != listing);
+}
+
+void DirectoryListingTest::testUpdatedOnChange()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QSharedPointer<DirectoryListing> listing = DirectoryListing::forDirectory(dir.path());
+    QVERIFY(!listing->containsPrefixOf(QStringLiteral("new.txt")));
+
+    createFile(dir.filePath(QStringLiteral("new.txt")));
+    QTRY_VERIFY(listing->containsPrefixOf(QStringLiteral("new.txt")));
+
+    QVERIFY(QFile::remove(dir.filePath(QStringLiteral("new.txt"))));
+    QTRY_VERIFY(!listing->containsPrefixOf(QStringLiteral("new.txt")));
+}
+
+void DirectoryListingTest::testChangesThrottled()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const QSharedPointer<DirectoryListing> listing = DirectoryListing::forDirectory(dir.path());
+    QSignalSpy changedSpy(listing.data(), &DirectoryListing::changed);
+    QVERIFY(listing->entries().contains(QStringLiteral(".")));
+
+    // the first change is reported right away, the others which follow
+    // it closely together at the end of the interval
+    for (int i = 0; i < 50; i++) {
+        createFile(dir.filePath(QStringLiteral("file%1").arg(i)));
+    }
+    QTRY_VERIFY(changedSpy.count() >= 1);
+    QTest::qWait(1000);
+    QVERIFY(changedSpy.count() <= 2);
+    QVERIFY(listing->containsPrefixOf(QStringLiteral("file49")));
+}
+
+QTEST_GUILESS_MAIN(DirectoryListingTest)
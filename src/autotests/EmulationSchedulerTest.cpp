@@ -0,0 +1,182 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "EmulationSchedulerTest.h"
+
+// Qt
+#include <QCoreApplication>
+#include <QSignalSpy>
+#include <QThread>
+
+// KDE
+#include <qtest.h>
+
+#include "../EmulationScheduler.h"
+#include "../Vt102Emulation.h"
+
+using namespace Konsole;
+
+namespace {
+// Collects the replies the emulation sends to the terminal program.  The
+// receiver lives in the GUI thread, so they are queued to it.
+class ReplyCollector : public QObject
+{
+public:
+    explicit ReplyCollector(Emulation *emulation)
+    {
+        connect(emulation, &Emulation::sendData, this, [this](const QByteArray &data) {
+            replies << data;
+            inGuiThread = inGuiThread && QThread::currentThread() == qApp->thread();
+        });
+    }
+
+    QList<QByteArray> replies;
+    bool inGuiThread = true;
+};
+}
+
+void EmulationSchedulerTest::testOutputIsProcessed()
+{
+    Vt102Emulation emulation;
+    ReplyCollector collector(&emulation);
+
+    EmulationScheduler::instance()->receiveData(&emulation, "\033[5n", 4);
+    QTRY_COMPARE(collector.replies.count(), 1);
+    QCOMPARE(collector.replies.first(), QByteArray("\033[0n"));
+    QVERIFY(collector.inGuiThread);
+    QTRY_COMPARE(EmulationScheduler::instance()->pendingBytes(&emulation), 0);
+}
+
+void EmulationSchedulerTest::testOrder()
+{
+    EmulationScheduler *scheduler = EmulationScheduler::instance();
+
+    Vt102Emulation emulation;
+    ReplyCollector collector(&emulation);
+
+    // each write moves the cursor and asks for its position, which is
+    // only right if the writes are processed in order
+    const QByteArray padding = QByteArray("0123456789abcdefghijklmnopqrstuvwxyz\r\n").repeated(1000);
+    for (int column = 1; column <= 50; column++) {
+        scheduler->receiveData(&emulation, padding.constData(), padding.size());
+        const QByteArray request = QByteArrayLiteral("\033[1;") + QByteArray::number(column) + QByteArrayLiteral("H\033[6n");
+        scheduler->receiveData(&emulation, request.constData(), request.size());
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(collector.replies.count(), 50, 60000);
+    for (int column = 1; column <= 50; column++) {
+        QCOMPARE(collector.replies.at(column - 1), QByteArrayLiteral("\033[1;") + QByteArray::number(column) + QByteArrayLiteral("R"));
+    }
+}
+
+void EmulationSchedulerTest::testSignalsInGuiThread()
+{
+    Vt102Emulation emulation;
+
+    QObject receiver;
+    int bells = 0;
+    QString title;
+    bool inGuiThread = true;
+    connect(&emulation, &Emulation::bell, &receiver, [&]() {
+        bells++;
+        inGuiThread = inGuiThread && QThread::currentThread() == qApp->thread();
+    });
+    connect(&emulation, &Emulation::sessionAttributeChanged, &receiver, [&](int attribute, const QString &value) {
+        if (attribute == 2) {
+            title = value;
+        }
+        inGuiThread = inGuiThread && QThread::currentThread() == qApp->thread();
+    });
+
+    EmulationScheduler::instance()->receiveData(&emulation, "\a\033]2;Title\a", 11);
+    QTRY_COMPARE(bells, 1);
+    QTRY_COMPARE(title, QStringLiteral("Title"));
+    QVERIFY(inGuiThread);
+}
+
+void EmulationSchedulerTest::testFairness()
+{
+    EmulationScheduler *scheduler = EmulationScheduler::instance();
+
+    Vt102Emulation busy;
+    Vt102Emulation quiet;
+    ReplyCollector busyCollector(&busy);
+    ReplyCollector quietCollector(&quiet);
+
+    // far more output than can be processed in one chunk, followed by a
+    // status request which must only be answered once all of the output
+    // before it has been processed
+    const QByteArray flood = QByteArray("0123456789abcdefghijklmnopqrstuvwxyz\r\n").repeated(500000);
+    scheduler->receiveData(&busy, flood.constData(), flood.size());
+    scheduler->receiveData(&busy, "\033[5n", 4);
+    QVERIFY(scheduler->pendingBytes(&busy) > 0);
+
+    // the quiet emulation gets its turn long before the busy one is done
+    scheduler->receiveData(&quiet, "\033[5n", 4);
+    QTRY_COMPARE(quietCollector.replies.count(), 1);
+    QVERIFY(scheduler->pendingBytes(&busy) > 0);
+    QCOMPARE(busyCollector.replies.count(), 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(busyCollector.replies.count(), 1, 60000);
+    QCOMPARE(scheduler->pendingBytes(&busy), 0);
+}
+
+void EmulationSchedulerTest::testCancel()
+{
+    EmulationScheduler *scheduler = EmulationScheduler::instance();
+
+    // destroying an emulation while its output is processed neither
+    // crashes nor processes the rest of it
+    auto emulation = new Vt102Emulation();
+    const QByteArray flood = QByteArray("0123456789abcdefghijklmnopqrstuvwxyz\r\n").repeated(100000);
+    scheduler->receiveData(emulation, flood.constData(), flood.size());
+    QVERIFY(scheduler->pendingBytes(emulation) > 0);
+    delete emulation;
+    QCOMPARE(scheduler->pendingBytes(emulation), 0);
+}
+
+void EmulationSchedulerTest::testDataProcessed()
+{
+    EmulationScheduler *scheduler = EmulationScheduler::instance();
+
+    Vt102Emulation emulation;
+    QSignalSpy processedSpy(scheduler, &EmulationScheduler::dataProcessed);
+
+    const QByteArray flood = QByteArray("0123456789abcdefghijklmnopqrstuvwxyz\r\n").repeated(100000);
+    scheduler->receiveData(&emulation, flood.constData(), flood.size());
+    const int pending = scheduler->pendingBytes(&emulation);
+    QVERIFY(pending > 0);
+
+    // the amount reported as pending only ever goes down, down to nothing
+    QTRY_VERIFY_WITH_TIMEOUT(scheduler->pendingBytes(&emulation) == 0, 60000);
+    QVERIFY(!processedSpy.isEmpty());
+    int previous = pending;
+    for (const QList<QVariant> &arguments : qAsConst(processedSpy)) {
+        QCOMPARE(arguments.at(0).value<Emulation *>(), static_cast<Emulation *>(&emulation));
+        const int remaining = arguments.at(1).toInt();
+        QVERIFY(remaining < previous);
+        previous = remaining;
+    }
+    QCOMPARE(previous, 0);
+}
+
+QTEST_GUILESS_MAIN(EmulationSchedulerTest)
@@ -0,0 +1,359 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "FilterTest.h"
+
+// Std
+#include <algorithm>
+
+// Qt
+#include <QFile>
+#include <QRect>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+// KDE
+#include <qtest.h>
+
+#include "../Filter.h"
+#include "../Session.h"
+
+using namespace Konsole;
+
+static const int LINES = 3;
+static const int COLUMNS = 20;
+
+// replaces a line of the image the way Screen does, with the right half
+// of each wide character left empty
+static void setLine(QVector<Character> &image, int line, const QString &text)
+{
+    std::fill(image.begin() + line * COLUMNS, image.begin() + (line + 1) * COLUMNS, Character());
+    int column = 0;
+    for (const uint ch : text.toUcs4()) {
+        image[line * COLUMNS + column].character = ch;
+        column += qMax(1, Character::width(ch));
+        if (Character::width(ch) == 2) {
+            image[line * COLUMNS + column - 1].character = 0;
+        }
+    }
+}
+
+void FilterTest::testHotSpotColumns()
+{
+    QVector<Character> image(LINES * COLUMNS);
+    setLine(image, 0, QStringLiteral("\u65E5\u672C foo.cpp"));
+    setLine(image, 1, QStringLiteral("x \U0001F600 bar.cpp"));
+    setLine(image, 2, QStringLiteral("baz.cpp"));
+    const QVector<LineProperty> lineProperties(LINES, LINE_DEFAULT);
+
+    auto *filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("[a-z]+\\.cpp")));
+
+    TerminalImageFilterChain chain;
+    chain.addFilter(filter);
+    chain.setImage(image.constData(), LINES, COLUMNS, lineProperties);
+    chain.process();
+
+    const auto spots = chain.hotSpots();
+    QCOMPARE(spots.size(), 3);
+
+    // two wide characters and a space come before the match
+    QCOMPARE(spots.at(0)->startLine(), 0);
+    QCOMPARE(spots.at(0)->startColumn(), 5);
+    QCOMPARE(spots.at(0)->endLine(), 0);
+    QCOMPARE(spots.at(0)->endColumn(), 12);
+
+    // the emoji takes two QChars and two columns
+    QCOMPARE(spots.at(1)->startLine(), 1);
+    QCOMPARE(spots.at(1)->startColumn(), 5);
+    QCOMPARE(spots.at(1)->endColumn(), 12);
+
+    QCOMPARE(spots.at(2)->startLine(), 2);
+    QCOMPARE(spots.at(2)->startColumn(), 0);
+    QCOMPARE(spots.at(2)->endColumn(), 7);
+
+    QCOMPARE(chain.hotSpotAt(1, 6), spots.at(1));
+    QVERIFY(chain.hotSpotAt(1, 3).isNull());
+}
+
+// the positions of the hotspots a chain found, to compare with another chain
+static QList<QRect> hotSpotPositions(const FilterChain &chain)
+{
+    QList<QRect> positions;
+    for (const auto &spot : chain.hotSpots()) {
+        positions << QRect(QPoint(spot->startColumn(), spot->startLine()),
+                           QPoint(spot->endColumn(), spot->endLine()));
+    }
+    return positions;
+}
+
+void FilterTest::testIncrementalUpdate()
+{
+    const int lines = 8;
+    QVector<Character> image(lines * COLUMNS);
+    for (int line = 0; line < lines; line++) {
+        setLine(image, line, QStringLiteral("%1 file%1.cpp").arg(line));
+    }
+    QVector<LineProperty> lineProperties(lines, LINE_DEFAULT);
+
+    auto *filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("[a-z]+[0-9]*\\.cpp")));
+    TerminalImageFilterChain chain;
+    chain.addFilter(filter);
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    QCOMPARE(chain.hotSpotCount(), lines);
+    const auto firstSpots = chain.hotSpots();
+
+    const auto compareWithFullUpdate = [&]() {
+        auto *reference = new RegExpFilter();
+        reference->setRegExp(filter->regExp());
+        TerminalImageFilterChain referenceChain;
+        referenceChain.addFilter(reference);
+        referenceChain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+        referenceChain.process();
+        QCOMPARE(hotSpotPositions(chain), hotSpotPositions(referenceChain));
+    };
+
+    // change one line; the hotspots on the others are kept as they were
+    setLine(image, 5, QStringLiteral("x changed.cpp"));
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    compareWithFullUpdate();
+    QCOMPARE(chain.hotSpots().at(0), firstSpots.at(0));
+    QVERIFY(chain.hotSpots().at(5) != firstSpots.at(5));
+
+    // scroll up by two lines, the way new output at the bottom does
+    image.remove(0, 2 * COLUMNS);
+    image.resize(lines * COLUMNS);
+    setLine(image, 6, QStringLiteral("new.cpp"));
+    setLine(image, 7, QStringLiteral("newer.cpp"));
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    compareWithFullUpdate();
+    QCOMPARE(chain.hotSpots().at(0), firstSpots.at(2));
+    QCOMPARE(chain.hotSpots().at(0)->startLine(), 0);
+
+    // wrap line 2 onto line 3 and split a name across them
+    lineProperties[2] = LINE_WRAPPED;
+    image[2 * COLUMNS + COLUMNS - 1].character = 'a';
+    setLine(image, 3, QStringLiteral("b.cpp"));
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    compareWithFullUpdate();
+    QVERIFY(chain.hotSpotAt(2, COLUMNS - 1) != nullptr);
+    QCOMPARE(chain.hotSpotAt(2, COLUMNS - 1)->endLine(), 3);
+
+    // a new regular expression means examining everything again
+    filter->setRegExp(QRegularExpression(QStringLiteral("new")));
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    compareWithFullUpdate();
+    QCOMPARE(chain.hotSpotCount(), 2);
+}
+
+void FilterTest::testOutdatedFilter()
+{
+    const int lines = 6;
+    QVector<Character> image(lines * COLUMNS);
+    for (int line = 0; line < lines; line++) {
+        setLine(image, line, QStringLiteral("%1 file%1.cpp").arg(line));
+    }
+    const QVector<LineProperty> lineProperties(lines, LINE_DEFAULT);
+
+    auto *files = new RegExpFilter();
+    files->setRegExp(QRegularExpression(QStringLiteral("[a-z]+[0-9]*\\.cpp")));
+    auto *numbers = new RegExpFilter();
+    numbers->setRegExp(QRegularExpression(QStringLiteral("[0-9] ")));
+    TerminalImageFilterChain chain;
+    chain.addFilter(files);
+    chain.addFilter(numbers);
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    QCOMPARE(files->hotSpots().size(), lines);
+    QCOMPARE(numbers->hotSpots().size(), lines);
+    const auto fileSpots = files->hotSpots();
+
+    // only the filter whose settings changed examines all lines again, the
+    // other one keeps its hotspots and does not find them a second time
+    numbers->setRegExp(QRegularExpression(QStringLiteral("[0-9]\\.")));
+    QVERIFY(numbers->isOutdated());
+    QVERIFY(!files->isOutdated());
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    QCOMPARE(files->hotSpots(), fileSpots);
+    QCOMPARE(numbers->hotSpots().size(), lines);
+    QCOMPARE(numbers->hotSpots().at(2)->startColumn(), 6);
+    QVERIFY(!numbers->isOutdated());
+
+    // along with a changed line
+    setLine(image, 3, QStringLiteral("x changed.cpp"));
+    numbers->setRegExp(QRegularExpression(QStringLiteral("[0-9]")));
+    chain.setImage(image.constData(), lines, COLUMNS, lineProperties);
+    chain.process();
+    QCOMPARE(files->hotSpots().size(), lines);
+    QCOMPARE(files->hotSpots().at(0), fileSpots.at(0));
+    QVERIFY(files->hotSpots().at(3) != fileSpots.at(3));
+    QCOMPARE(numbers->hotSpots().size(), 2 * (lines - 1));
+}
+
+void FilterTest::testProcessInBackground()
+{
+    QVector<Character> image(LINES * COLUMNS);
+    for (int line = 0; line < LINES; line++) {
+        setLine(image, line, QStringLiteral("file%1.cpp").arg(line));
+    }
+    const QVector<LineProperty> lineProperties(LINES, LINE_DEFAULT);
+
+    auto *filter = new RegExpFilter();
+    filter->setRegExp(QRegularExpression(QStringLiteral("[a-z]+[0-9]*\\.cpp")));
+    TerminalImageFilterChain chain;
+    chain.addFilter(filter);
+
+    int calls = 0;
+    bool processed = false;
+    const auto done = [&](bool result) {
+        calls++;
+        processed = result;
+    };
+
+    chain.setImage(image.constData(), LINES, COLUMNS, lineProperties);
+    chain.processInBackground(done);
+    QTRY_COMPARE(calls, 1);
+    QVERIFY(processed);
+    QCOMPARE(chain.hotSpotCount(), LINES);
+
+    // the results for an image which has since been replaced are thrown away
+    setLine(image, 1, QStringLiteral("other.cpp"));
+    chain.setImage(image.constData(), LINES, COLUMNS, lineProperties);
+    chain.processInBackground(done);
+    chain.setImage(image.constData(), LINES, COLUMNS, lineProperties);
+    QTRY_COMPARE(calls, 2);
+    QVERIFY(!processed);
+    QVERIFY(chain.hotSpotAt(1, 0).isNull());
+
+    // and the line which changed is still searched the next time
+    chain.setImage(image.constData(), LINES, COLUMNS, lineProperties);
+    chain.processInBackground(done);
+    QTRY_COMPARE(calls, 3);
+    QVERIFY(processed);
+    QCOMPARE(chain.hotSpotCount(), LINES);
+    QVERIFY(!chain.hotSpotAt(1, 0).isNull());
+    QCOMPARE(chain.hotSpotAt(1, 0)->endColumn(), 9);
+}
+
+void FilterTest::testFindMatchesWithAnchors()
+{
+    const QString text = QStringLiteral("see https://kde.org and WWW.kde.org\n"
+                                        "plain words only\n"
+                                        "mail me@kde.org, www.example.com\n"
+                                        "\n"
+                                        "last line: ftp://host");
+    const UrlFilter urlFilter;
+    const QVector<RegExpFilter::Pattern> patterns = {
+        {urlFilter.regExp(), urlFilter.anchors()},
+        {QRegularExpression(QStringLiteral("www\\.\\w+"), QRegularExpression::CaseInsensitiveOption),
+         {QStringLiteral("www.")}},
+        {QRegularExpression(QStringLiteral("[a-z]+")), {}},
+        {QRegularExpression(QStringLiteral("nowhere")), {QStringLiteral("nowhere")}},
+        {QRegularExpression(), {QStringLiteral("://")}}
+    };
+
+    const auto matches = RegExpFilter::findMatches(patterns, text);
+    QCOMPARE(matches.size(), patterns.size());
+
+    // anchors only decide which lines are searched, never what is found
+    for (int i = 0; i < patterns.size(); i++) {
+        const auto expected = RegExpFilter::findMatches(patterns.at(i).regExp, text);
+        QCOMPARE(matches.at(i).size(), expected.size());
+        for (int j = 0; j < expected.size(); j++) {
+            QCOMPARE(matches.at(i).at(j).start, expected.at(j).start);
+            QCOMPARE(matches.at(i).at(j).end, expected.at(j).end);
+            QCOMPARE(matches.at(i).at(j).capturedTexts, expected.at(j).capturedTexts);
+        }
+    }
+
+    QCOMPARE(matches.at(0).size(), 4);
+    QCOMPARE(matches.at(1).size(), 2);
+    QVERIFY(matches.at(3).isEmpty());
+    QVERIFY(matches.at(4).isEmpty());
+}
+
+static void createFile(const QString &path)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+}
+
+void FilterTest::testFileFilterFollowsDirectory()
+{
+    QTemporaryDir first;
+    QTemporaryDir second;
+    QVERIFY(first.isValid());
+    QVERIFY(second.isValid());
+    createFile(first.filePath(QStringLiteral("first.txt")));
+    createFile(second.filePath(QStringLiteral("second.txt")));
+
+    Session session;
+    session.setSessionAttribute(Session::CurrentDirectory, first.path());
+
+    auto *filter = new FileFilter(&session);
+    QSignalSpy outdatedSpy(filter, &FileFilter::outdated);
+    TerminalImageFilterChain chain;
+    chain.addFilter(filter);
+
+    QVector<Character> image(LINES * COLUMNS);
+    setLine(image, 0, QStringLiteral("first.txt"));
+    setLine(image, 1, QStringLiteral("second.txt"));
+    setLine(image, 2, QStringLiteral("third.txt"));
+    const QVector<LineProperty> lineProperties(LINES, LINE_DEFAULT);
+
+    // the names of the files found in the image, which does not change
+    const auto filterFiles = [&]() {
+        chain.setImage(image.constData(), LINES, COLUMNS, lineProperties);
+        chain.process();
+        QStringList files;
+        for (const auto &spot : chain.hotSpots()) {
+            files << spot.staticCast<RegExpFilter::HotSpot>()->capturedTexts().first();
+        }
+        return files;
+    };
+    QCOMPARE(filterFiles(), QStringList({QStringLiteral("first.txt")}));
+    QVERIFY(!filter->isOutdated());
+
+    // the lines were filtered already, but the names on them refer to
+    // other files once the session changes directory
+    session.setSessionAttribute(Session::CurrentDirectory, second.path());
+    QTRY_COMPARE(outdatedSpy.count(), 1);
+    QVERIFY(filter->isOutdated());
+    QCOMPARE(filterFiles(), QStringList({QStringLiteral("second.txt")}));
+
+    // and a name may become a file when it is created
+    createFile(second.filePath(QStringLiteral("third.txt")));
+    QTRY_COMPARE(outdatedSpy.count(), 2);
+    QVERIFY(filter->isOutdated());
+    QCOMPARE(filterFiles(), QStringList({QStringLiteral("second.txt"), QStringLiteral("third.txt")}));
+    QCOMPARE(outdatedSpy.count(), 2);
+}
+
+QTEST_MAIN(FilterTest)
@@ -0,0 +1,147 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "GlyphCacheTest.h"
+
+// Qt
+#include <QFontDatabase>
+#include <QFontMetrics>
+
+// KDE
+#include <qtest.h>
+
+#include "../GlyphCache.h"
+
+using namespace Konsole;
+
+static const QRgb FOREGROUND = qRgb(0xff, 0xff, 0xff);
+static const QRgb BACKGROUND = qRgb(0x00, 0x00, 0x00);
+
+static QFont testFont()
+{
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPixelSize(16);
+    return font;
+}
+
+// a cache with cells which fit every narrow glyph of the font
+static void setUpCells(GlyphCache &cache, const QFont &font)
+{
+    const QFontMetrics metrics(font);
+    cache.setCellSize(metrics.horizontalAdvance(QLatin1Char('W')) * 2, metrics.height(), metrics.ascent());
+}
+
+void GlyphCacheTest::testIsCacheable()
+{
+    QVERIFY(GlyphCache::isCacheable('a'));
+    QVERIFY(GlyphCache::isCacheable(0x00E9)); // e with acute accent
+    QVERIFY(GlyphCache::isCacheable(0x0416)); // Cyrillic Zhe
+    QVERIFY(GlyphCache::isCacheable(0x2500)); // box drawing
+
+    QVERIFY(!GlyphCache::isCacheable('\t'));
+    QVERIFY(!GlyphCache::isCacheable(0x0301)); // combining acute accent
+    QVERIFY(!GlyphCache::isCacheable(0x200D)); // zero width joiner
+    QVERIFY(!GlyphCache::isCacheable(0x0627)); // Arabic needs shaping
+    QVERIFY(!GlyphCache::isCacheable(0x65E5)); // CJK
+    QVERIFY(!GlyphCache::isCacheable(0x1F600)); // emoji, outside the BMP
+}
+
+void GlyphCacheTest::testCachedGlyphs()
+{
+    const QFont font = testFont();
+    GlyphCache cache;
+    setUpCells(cache, font);
+    const QFontMetrics metrics(font);
+    const QSize cellSize(metrics.horizontalAdvance(QLatin1Char('W')) * 2, metrics.height());
+
+    // a glyph is rasterized once into an image of a cell ...
+    const QImage first = cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 1.0);
+    QVERIFY(!first.isNull());
+    QCOMPARE(first.size(), cellSize);
+    QCOMPARE(cache.size(), 1);
+
+    // ... and used again after that
+    QCOMPARE(cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 1.0).cacheKey(), first.cacheKey());
+    QCOMPARE(cache.size(), 1);
+
+    // other colors and variants are cached separately
+    QVERIFY(cache.glyph('a', font, GlyphCache::Bold, FOREGROUND, BACKGROUND, 1.0).cacheKey() != first.cacheKey());
+    QVERIFY(cache.glyph('a', font, 0, qRgb(0xff, 0, 0), BACKGROUND, 1.0).cacheKey() != first.cacheKey());
+    QCOMPARE(cache.size(), 3);
+
+    // characters which need shaping are not cached at all
+    QVERIFY(cache.glyph(0x0301, font, 0, FOREGROUND, BACKGROUND, 1.0).isNull());
+    QVERIFY(cache.glyph(0x1F600, font, 0, FOREGROUND, BACKGROUND, 1.0).isNull());
+    QCOMPARE(cache.size(), 3);
+}
+
+void GlyphCacheTest::testWideGlyphs()
+{
+    const QFont font = testFont();
+    GlyphCache cache;
+    const QFontMetrics metrics(font);
+
+    // glyphs wider than a cell would be cut off, so they are left to
+    // QPainter::drawText() instead
+    cache.setCellSize(1, metrics.height(), metrics.ascent());
+    QVERIFY(cache.glyph('W', font, 0, FOREGROUND, BACKGROUND, 1.0).isNull());
+    QVERIFY(cache.glyph('W', font, 0, FOREGROUND, BACKGROUND, 1.0).isNull());
+    QCOMPARE(cache.size(), 0);
+
+    // and are cached once the cells are wide enough
+    setUpCells(cache, font);
+    QVERIFY(!cache.glyph('W', font, 0, FOREGROUND, BACKGROUND, 1.0).isNull());
+    QCOMPARE(cache.size(), 1);
+}
+
+void GlyphCacheTest::testClear()
+{
+    const QFont font = testFont();
+    GlyphCache cache;
+    setUpCells(cache, font);
+    const QFontMetrics metrics(font);
+
+    const qint64 key = cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 1.0).cacheKey();
+
+    // setting the same antialiasing again keeps the glyphs ...
+    cache.setAntialias(true);
+    QCOMPARE(cache.size(), 1);
+    QCOMPARE(cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 1.0).cacheKey(), key);
+
+    // ... changing it discards them
+    cache.setAntialias(false);
+    QCOMPARE(cache.size(), 0);
+    QVERIFY(cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 1.0).cacheKey() != key);
+
+    // a new cell size discards them, and the glyphs are drawn in the new size
+    cache.setCellSize(metrics.horizontalAdvance(QLatin1Char('W')) * 3, metrics.height() + 2, metrics.ascent());
+    QCOMPARE(cache.size(), 0);
+    QCOMPARE(cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 1.0).height(), metrics.height() + 2);
+
+    // as does a different device pixel ratio
+    const QImage scaled = cache.glyph('a', font, 0, FOREGROUND, BACKGROUND, 2.0);
+    QCOMPARE(cache.size(), 1);
+    QCOMPARE(scaled.height(), (metrics.height() + 2) * 2);
+    QCOMPARE(scaled.devicePixelRatio(), 2.0);
+}
+
+QTEST_MAIN(GlyphCacheTest)
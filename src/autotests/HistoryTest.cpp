@@ -140,4 +140,126 @@ void HistoryTest::testHistoryScroll()
     delete historyScroll;
 }
 
+// line 'lineno' of the history written by testHistoryFileLines()
+static QVector<Character> historyLine(int lineno)
+{
+    QVector<Character> line(lineno % 50 + 1);
+    for (int column = 0; column < line.size(); column++) {
+        line[column].character = 'a' + (lineno + column) % 26;
+    }
+    return line;
+}
+
+static void verifyHistoryLine(HistoryScroll &history, int lineno)
+{
+    const QVector<Character> expected = historyLine(lineno);
+    QCOMPARE(history.getLineLen(lineno), expected.size());
+    QCOMPARE(history.isWrappedLine(lineno), lineno % 3 == 0);
+
+    QVector<Character> cells(expected.size());
+    history.getCells(lineno, 0, cells.size(), cells.data());
+    for (int column = 0; column < cells.size(); column++) {
+        QCOMPARE(cells[column].character, expected[column].character);
+    }
+
+    // part of the line
+    if (expected.size() > 2) {
+        history.getCells(lineno, 1, 1, cells.data());
+        QCOMPARE(cells[0].character, expected[1].character);
+    }
+}
+
+void HistoryTest::testHistoryFileLines()
+{
+    // enough lines for several blocks of the line cache and some more,
+    // which are read from the files directly
+    const int lines = HistoryLineCache::BLOCK_LINES * 4 + 10;
+
+    HistoryScrollFile history;
+    for (int lineno = 0; lineno < lines; lineno++) {
+        history.addCellsVector(historyLine(lineno));
+        history.addLine(lineno % 3 == 0);
+    }
+    QCOMPARE(history.getLines(), lines);
+
+    // scrolling up through the history, then down again
+    for (int lineno = lines - 1; lineno >= 0; lineno--) {
+        verifyHistoryLine(history, lineno);
+    }
+    for (int lineno = 0; lineno < lines; lineno++) {
+        verifyHistoryLine(history, lineno);
+    }
+
+    // lines added after the history was read
+    const int moreLines = lines + HistoryLineCache::BLOCK_LINES;
+    for (int lineno = lines; lineno < moreLines; lineno++) {
+        history.addCellsVector(historyLine(lineno));
+        history.addLine(lineno % 3 == 0);
+    }
+    QCOMPARE(history.getLines(), moreLines);
+    for (int lineno = moreLines - 1; lineno >= 0; lineno -= 7) {
+        verifyHistoryLine(history, lineno);
+    }
+}
+
+void HistoryTest::testHistoryFileLinesLoaded()
+{
+    const int lines = HistoryLineCache::BLOCK_LINES * 2 + 10;
+
+    HistoryScrollFile history;
+    QAtomicInt loaded(0);
+    history.setLoadedCallback([&loaded]() { loaded.ref(); });
+    for (int lineno = 0; lineno < lines; lineno++) {
+        history.addCellsVector(historyLine(lineno));
+        history.addLine(lineno % 3 == 0);
+    }
+
+    // the lines which are not cached yet are read from the files
+    QVERIFY(history.isLineLoaded(lines - 1));
+
+    // a block which has not been read is loaded in the background, which
+    // is announced once
+    QVERIFY(!history.isLineLoaded(0));
+    QTRY_VERIFY(history.isLineLoaded(0));
+    QCOMPARE(loaded.load(), 1);
+    verifyHistoryLine(history, 0);
+    verifyHistoryLine(history, HistoryLineCache::BLOCK_LINES - 1);
+
+    // reading a line loads its block right away, without announcing it
+    verifyHistoryLine(history, HistoryLineCache::BLOCK_LINES);
+    QVERIFY(history.isLineLoaded(HistoryLineCache::BLOCK_LINES));
+    QCOMPARE(loaded.load(), 1);
+}
+
+void HistoryTest::testHistoryFileReader()
+{
+    const int lines = HistoryLineCache::BLOCK_LINES * 3 + 10;
+
+    auto *history = new HistoryScrollFile();
+    for (int lineno = 0; lineno < lines; lineno++) {
+        history->addCellsVector(historyLine(lineno));
+        history->addLine(lineno % 3 == 0);
+    }
+
+    // the reader covers the complete blocks at the time it was created,
+    // and keeps reading them after the history is gone
+    const HistoryLineCache::Reader reader = history->lineReader();
+    QCOMPARE(reader.lines(), HistoryLineCache::BLOCK_LINES * 3);
+    for (int lineno = 0; lineno < lines; lineno++) {
+        history->addCellsVector(historyLine(lineno));
+        history->addLine();
+    }
+    QVERIFY(reader.block(reader.lines()).isNull());
+    delete history;
+
+    for (int lineno = reader.lines() - 1; lineno >= 0; lineno -= 5) {
+        const auto block = reader.block(lineno);
+        QVERIFY(!block.isNull());
+        const QVector<Character> expected = historyLine(lineno);
+        QCOMPARE(block->lineLength(lineno), expected.size());
+        QCOMPARE(block->isWrapped(lineno), lineno % 3 == 0);
+        QCOMPARE(block->line(lineno)[expected.size() - 1].character, expected.last().character);
+    }
+}
+
 QTEST_MAIN(HistoryTest)
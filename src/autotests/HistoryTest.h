@@ -35,6 +35,9 @@ private Q_SLOTS:
     void testCompactHistory();
     void testEmulationHistory();
     void testHistoryScroll();
+    void testHistoryFileLines();
+    void testHistoryFileLinesLoaded();
+    void testHistoryFileReader();
 
 private:
 };
@@ -21,6 +21,7 @@
 #include "PtyTest.h"
 
 // Qt
+#include <QSignalSpy>
 #include <QSize>
 #include <QStringList>
 
@@ -89,4 +90,48 @@ void PtyTest::testRunProgram()
     QCOMPARE(pty.foregroundProcessGroup(), pty.pid());
 }
 
+void PtyTest::testReceiveData()
+{
+    Pty pty;
+    QByteArray received;
+    connect(&pty, &Pty::receivedData, this, [&received](const char *buffer, int length) {
+        received.append(buffer, length);
+    });
+
+    // more output than fits into the reader's ring buffer at once
+    const QString program = QStringLiteral("sh");
+    const QStringList arguments = {program, QStringLiteral("-c"),
+                                   QStringLiteral("head -c 1000000 /dev/zero | tr '\\0' x; echo; echo done")};
+    QCOMPARE(pty.start(program, arguments, QStringList()), 0);
+
+    QTRY_VERIFY_WITH_TIMEOUT(received.contains("done"), 10000);
+    QCOMPARE(received.count('x'), 1000000);
+}
+
+void PtyTest::testReceiveDataNested()
+{
+    Pty pty;
+    QByteArray received;
+    bool nested = false;
+    connect(&pty, &Pty::receivedData, this, [&received, &nested](const char *buffer, int length) {
+        received.append(buffer, length);
+
+        // a receiver running a nested event loop, like the zmodem dialog,
+        // gets the output which follows, and none of it twice
+        if (!nested) {
+            nested = true;
+            QTest::qWait(200);
+        }
+    });
+
+    const QString program = QStringLiteral("sh");
+    const QStringList arguments = {program, QStringLiteral("-c"),
+                                   QStringLiteral("head -c 1000000 /dev/zero | tr '\\0' x; echo; echo done")};
+    QCOMPARE(pty.start(program, arguments, QStringList()), 0);
+
+    QTRY_VERIFY_WITH_TIMEOUT(received.contains("done"), 10000);
+    QVERIFY(nested);
+    QCOMPARE(received.count('x'), 1000000);
+}
+
 QTEST_GUILESS_MAIN(PtyTest)
@@ -0,0 +1,219 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "SearchHistoryTaskTest.h"
+
+// Qt
+#include <QSignalSpy>
+
+// KDE
+#include <qtest.h>
+
+#include "../Emulation.h"
+#include "../ScreenWindow.h"
+#include "../SearchHistoryTask.h"
+#include "../Session.h"
+
+using namespace Konsole;
+
+// several of the blocks the history is searched in
+static const int HISTORY_LINES = 30000;
+// the first of the lines of a line which wraps twice; searching forwards from
+// line 0 or backwards from line 20002, its second line is where two of the
+// blocks meet
+static const int WRAPPED_LINE = 10000;
+
+// puts "line 0" to "line 29999" into the history of @p session, one per line,
+// except for lines 10000 to 10002.  Those hold a line of 200 characters with
+// "needle" across the end of its second line and "thimble" on its third.
+static ScreenWindow *fillHistory(Session &session, bool indexed = false)
+{
+    session.setHistorySize(-1);
+    session.setHistoryIndexEnabled(indexed);
+    ScreenWindow *window = session.emulation()->createWindow();
+
+    QByteArray wrapped(200, '.');
+    wrapped.replace(158, 6, "needle");
+    wrapped.replace(170, 7, "thimble");
+
+    QByteArray output;
+    for (int line = 0; line < HISTORY_LINES; line++) {
+        if (line == WRAPPED_LINE) {
+            output += wrapped + "\r\n";
+        } else if (line < WRAPPED_LINE || line > WRAPPED_LINE + 2) {
+            output += "line " + QByteArray::number(line) + "\r\n";
+        }
+    }
+    session.emulation()->receiveData(output.constData(), output.size());
+
+    return window;
+}
+
+static SearchHistoryTask *createTask(Session &session, ScreenWindow *window, const QString &pattern,
+                                     Enum::SearchDirection direction, int startLine)
+{
+    auto task = new SearchHistoryTask();
+    task->setAutoDelete(true);
+    task->addScreenWindow(&session, window);
+    task->setRegExp(QRegularExpression(pattern));
+    task->setSearchDirection(direction);
+    task->setStartLine(startLine);
+    return task;
+}
+
+// returns the line of the match found, -1 if there is none, or -2 if the
+// search did not complete
+static int search(Session &session, ScreenWindow *window, const QString &pattern,
+                  Enum::SearchDirection direction, int startLine)
+{
+    SearchHistoryTask *task = createTask(session, window, pattern, direction, startLine);
+    QSignalSpy completedSpy(task, &SessionTask::completed);
+    task->execute();
+
+    if (!QTest::qWaitFor([&completedSpy]() { return completedSpy.count() == 1; }, 10000)) {
+        return -2;
+    }
+    return completedSpy.first().first().toBool() ? window->currentResultLine() : -1;
+}
+
+void SearchHistoryTaskTest::testSearch_data()
+{
+    QTest::addColumn<int>("direction");
+    QTest::addColumn<int>("startLine");
+    QTest::addColumn<int>("line");
+
+    QTest::newRow("forwards") << int(Enum::ForwardsSearch) << 100 << 25000;
+    QTest::newRow("backwards") << int(Enum::BackwardsSearch) << 29000 << 5000;
+    QTest::newRow("forwards past the end") << int(Enum::ForwardsSearch) << 26000 << 25000;
+    QTest::newRow("backwards past the start") << int(Enum::BackwardsSearch) << 4000 << 5000;
+    // in a block which is partly read from the files of the history and
+    // partly from the screen
+    QTest::newRow("on the screen") << int(Enum::ForwardsSearch) << 100 << HISTORY_LINES - 10;
+}
+
+void SearchHistoryTaskTest::testSearch()
+{
+    QFETCH(int, direction);
+    QFETCH(int, startLine);
+    QFETCH(int, line);
+
+    Session session;
+    ScreenWindow *window = fillHistory(session);
+    QVERIFY(window->lineCount() > HISTORY_LINES);
+
+    QPointer<SearchHistoryTask> task = createTask(session, window, QStringLiteral("\\bline %1\\b").arg(line),
+                                                  Enum::SearchDirection(direction), startLine);
+    QSignalSpy completedSpy(task.data(), &SessionTask::completed);
+    task->execute();
+
+    QTRY_COMPARE(completedSpy.count(), 1);
+    QCOMPARE(completedSpy.first().first().toBool(), true);
+    QCOMPARE(window->currentResultLine(), line);
+    QTRY_VERIFY(task.isNull());
+}
+
+void SearchHistoryTaskTest::testCancel()
+{
+    Session session;
+    ScreenWindow *window = fillHistory(session);
+
+    // the first block is being searched when the task is cancelled, and
+    // the match is in a later one
+    QPointer<SearchHistoryTask> task = createTask(session, window, QStringLiteral("\\bline 25000\\b"),
+                                                  Enum::ForwardsSearch, 0);
+    QSignalSpy completedSpy(task.data(), &SessionTask::completed);
+    task->execute();
+    task->cancel();
+
+    QTRY_VERIFY(task.isNull());
+    QTest::qWait(500);
+    QCOMPARE(completedSpy.count(), 0);
+    QCOMPARE(window->currentResultLine(), -1);
+}
+
+void SearchHistoryTaskTest::testClearHistory()
+{
+    Session session;
+    ScreenWindow *window = fillHistory(session);
+
+    // the match is in the first block, which is being searched while the
+    // history is cleared
+    QPointer<SearchHistoryTask> task = createTask(session, window, QStringLiteral("\\bline 25000\\b"),
+                                                  Enum::BackwardsSearch, 29000);
+    QSignalSpy completedSpy(task.data(), &SessionTask::completed);
+    task->execute();
+    session.clearHistory();
+    QVERIFY(window->lineCount() < HISTORY_LINES);
+
+    QTRY_COMPARE(completedSpy.count(), 1);
+    QCOMPARE(completedSpy.first().first().toBool(), false);
+    QCOMPARE(window->currentResultLine(), -1);
+    QTRY_VERIFY(task.isNull());
+}
+
+void SearchHistoryTaskTest::testIndexedSearch_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("direction");
+    QTest::addColumn<int>("startLine");
+    QTest::addColumn<int>("line");
+
+    QTest::newRow("across the end of a block") << QStringLiteral("needle")
+                                               << int(Enum::ForwardsSearch) << 0 << WRAPPED_LINE + 1;
+    QTest::newRow("past the end of a block") << QStringLiteral("thimble")
+                                             << int(Enum::ForwardsSearch) << 0 << WRAPPED_LINE + 2;
+    QTest::newRow("across the start of a block") << QStringLiteral("needle")
+                                                 << int(Enum::BackwardsSearch) << 20002 << WRAPPED_LINE + 1;
+    QTest::newRow("past the start of a block") << QStringLiteral("thimble")
+                                               << int(Enum::BackwardsSearch) << 20002 << WRAPPED_LINE + 2;
+    QTest::newRow("forwards") << QStringLiteral("\\bline 25000\\b")
+                              << int(Enum::ForwardsSearch) << 100 << 25000;
+    QTest::newRow("backwards past the start") << QStringLiteral("\\bline 5000\\b")
+                                              << int(Enum::BackwardsSearch) << 4000 << 5000;
+    QTest::newRow("case insensitive") << QStringLiteral("(?i)LINE 12345\\b")
+                                      << int(Enum::ForwardsSearch) << 0 << 12345;
+    QTest::newRow("no match") << QStringLiteral("nowhere")
+                              << int(Enum::ForwardsSearch) << 0 << -1;
+}
+
+void SearchHistoryTaskTest::testIndexedSearch()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, direction);
+    QFETCH(int, startLine);
+    QFETCH(int, line);
+
+    // the index only decides which lines are read, never what is found
+    Session session;
+    ScreenWindow *window = fillHistory(session);
+    QVERIFY(!session.historyIndexEnabled());
+    QVERIFY(window->screen()->historyIndex() == nullptr);
+    QCOMPARE(search(session, window, pattern, Enum::SearchDirection(direction), startLine), line);
+
+    Session indexedSession;
+    ScreenWindow *indexedWindow = fillHistory(indexedSession, true);
+    QVERIFY(indexedSession.historyIndexEnabled());
+    QVERIFY(indexedWindow->screen()->historyIndex() != nullptr);
+    QCOMPARE(search(indexedSession, indexedWindow, pattern, Enum::SearchDirection(direction), startLine), line);
+}
+
+QTEST_MAIN(SearchHistoryTaskTest)
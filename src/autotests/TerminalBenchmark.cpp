@@ -0,0 +1,398 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "TerminalBenchmark.h"
+
+// Qt
+#include <QTextCodec>
+#include <QTextStream>
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../CharacterWidth.h"
+#include "../Filter.h"
+#include "../History.h"
+#include "../Screen.h"
+#include "../TerminalCharacterDecoder.h"
+#include "../Vt102Emulation.h"
+
+using namespace Konsole;
+
+static const int COLUMNS = 80;
+static const int LINES = 24;
+static const int HISTORY_LINES = 10000;
+
+// A line of text as a program like ls or a compiler would print it, with
+// the colors changing every few words
+static TextLine makeLine(int index)
+{
+    static const char TEXT[] = "drwxr-xr-x 2 konsole konsole 4096 Jun  1 12:00 ";
+
+    TextLine line(COLUMNS);
+    for (int column = 0; column < COLUMNS; column++) {
+        line[column].character = static_cast<uchar>(TEXT[(index + column) % (sizeof(TEXT) - 1)]);
+        line[column].foregroundColor = CharacterColor(COLOR_SPACE_SYSTEM, (index + column / 8) % 8);
+        line[column].rendition = (column / 8) % 3 == 0 ? RE_BOLD : DEFAULT_RENDITION;
+    }
+    return line;
+}
+
+static void fillHistory(HistoryScroll &history, int count)
+{
+    for (int i = 0; i < count; i++) {
+        history.addCellsVector(makeLine(i));
+        history.addLine(i % 10 == 0);
+    }
+}
+
+static void readHistory(HistoryScroll &history)
+{
+    Character buffer[COLUMNS];
+    const int lines = history.getLines();
+    for (int i = 0; i < lines; i++) {
+        history.getCells(i, 0, qMin(history.getLineLen(i), COLUMNS), buffer);
+        history.isWrappedLine(i);
+    }
+}
+
+void TerminalBenchmark::benchCompactHistoryAppend()
+{
+    const TextLine line = makeLine(0);
+
+    QBENCHMARK {
+        CompactHistoryScroll history(HISTORY_LINES);
+        for (int i = 0; i < HISTORY_LINES; i++) {
+            history.addCellsVector(line);
+            history.addLine();
+        }
+    }
+}
+
+void TerminalBenchmark::benchCompactHistoryRead()
+{
+    CompactHistoryScroll history(HISTORY_LINES);
+    fillHistory(history, HISTORY_LINES);
+    QCOMPARE(history.getLines(), HISTORY_LINES);
+
+    QBENCHMARK {
+        readHistory(history);
+    }
+}
+
+void TerminalBenchmark::benchCompactHistoryEvict()
+{
+    // once the history is full, every new line drops the oldest one
+    const int maximumLines = 1000;
+    const TextLine line = makeLine(0);
+    CompactHistoryScroll history(maximumLines);
+    fillHistory(history, maximumLines);
+
+    QBENCHMARK {
+        for (int i = 0; i < HISTORY_LINES; i++) {
+            history.addCellsVector(line);
+            history.addLine();
+        }
+    }
+
+    QCOMPARE(history.getLines(), maximumLines);
+}
+
+void TerminalBenchmark::benchHistoryFileAppend()
+{
+    const TextLine line = makeLine(0);
+    HistoryScrollFile history;
+
+    QBENCHMARK {
+        for (int i = 0; i < HISTORY_LINES; i++) {
+            history.addCellsVector(line);
+            history.addLine();
+        }
+    }
+}
+
+void TerminalBenchmark::benchHistoryFileRead()
+{
+    HistoryScrollFile history;
+    fillHistory(history, HISTORY_LINES);
+    QCOMPARE(history.getLines(), HISTORY_LINES);
+
+    QBENCHMARK {
+        readHistory(history);
+    }
+}
+
+void TerminalBenchmark::benchDisplayCharacter_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("ascii") << QStringLiteral("The quick brown fox jumps over the lazy dog. ");
+    QTest::newRow("latin and cyrillic") << QStringLiteral("Größenmaßstäbe Съешь же ещё этих мягких булок. ");
+    QTest::newRow("wide") << QStringLiteral("終端エミュレータの性能測定。");
+    QTest::newRow("combining") << QStringLiteral("a\u0301e\u0301i\u0301o\u0301u\u0301 ");
+}
+
+void TerminalBenchmark::benchDisplayCharacter()
+{
+    QFETCH(QString, text);
+
+    // one screen full of characters
+    const QVector<uint> codePoints = text.toUcs4();
+    QVector<uint> screenText;
+    while (screenText.size() < LINES * COLUMNS) {
+        screenText += codePoints;
+    }
+    screenText.resize(LINES * COLUMNS);
+
+    Screen screen(LINES, COLUMNS);
+
+    QBENCHMARK {
+        screen.setCursorYX(1, 1);
+        for (uint c : qAsConst(screenText)) {
+            screen.displayCharacter(c);
+        }
+    }
+}
+
+void TerminalBenchmark::benchScrollUp()
+{
+    // writes a line at the bottom of the screen and moves on to the next,
+    // which scrolls the screen and moves the top line into the history
+    const TextLine line = makeLine(0);
+    Screen screen(LINES, COLUMNS);
+    screen.setScroll(CompactHistoryType(HISTORY_LINES));
+
+    QBENCHMARK {
+        for (int i = 0; i < 1000; i++) {
+            screen.setCursorYX(LINES, 1);
+            for (const Character &character : line) {
+                screen.displayCharacter(character.character);
+            }
+            screen.index();
+        }
+    }
+}
+
+void TerminalBenchmark::benchSgrParsing()
+{
+    // output of a colorful ls or a syntax highlighting pager: most words
+    // come with their own 16, 256 color or true color attributes
+    QByteArray data;
+    for (int line = 0; line < 2000; line++) {
+        for (int word = 0; word < 8; word++) {
+            const int n = line + word;
+            switch (word % 3) {
+            case 0:
+                data += "\033[1;" + QByteArray::number(30 + n % 8) + 'm';
+                break;
+            case 1:
+                data += "\033[38;5;" + QByteArray::number(n % 256) + ";48;5;" + QByteArray::number((n * 7) % 256) + 'm';
+                break;
+            case 2:
+                data += "\033[38;2;" + QByteArray::number(n % 256) + ';' + QByteArray::number((n * 3) % 256) + ';'
+                        + QByteArray::number((n * 5) % 256) + 'm';
+                break;
+            }
+            data += "word";
+            data += "\033[0m ";
+        }
+        data += "\r\n";
+    }
+
+    Vt102Emulation emulation;
+    emulation.setCodec(QTextCodec::codecForName("UTF-8"));
+    emulation.setImageSize(LINES, COLUMNS);
+
+    QBENCHMARK {
+        emulation.receiveData(data.constData(), data.size());
+    }
+}
+
+// a screen of compiler output with a link every few lines
+static QVector<Character> compilerOutputImage(int lines, int columns)
+{
+    QVector<Character> image(lines * columns);
+    for (int line = 0; line < lines; line++) {
+        const QString text = line % 4 == 0
+                             ? QStringLiteral("see https://bugs.kde.org/show_bug.cgi?id=%1 or mail konsole-devel@kde.org").arg(line)
+                             : QStringLiteral("src/Filter.cpp:%1:5: warning: unused variable 'hotspot' [-Wunused-variable]").arg(line);
+        for (int column = 0; column < qMin(columns, text.size()); column++) {
+            image[line * columns + column].character = text.at(column).unicode();
+        }
+    }
+    return image;
+}
+
+void TerminalBenchmark::benchUrlFilter()
+{
+    const int lines = 50;
+    const int columns = 120;
+    const QVector<Character> image = compilerOutputImage(lines, columns);
+    const QVector<LineProperty> lineProperties(lines, LINE_DEFAULT);
+
+    TerminalImageFilterChain chain;
+    chain.addFilter(new UrlFilter());
+
+    QBENCHMARK {
+        // forget the previous image, so that every line is examined
+        chain.reset();
+        chain.setImage(image.constData(), lines, columns, lineProperties);
+        chain.process();
+    }
+
+    QCOMPARE(chain.hotSpots().size(), 2 * ((lines + 3) / 4));
+}
+
+void TerminalBenchmark::benchUrlFilterOneLine()
+{
+    // typing at the prompt changes only the last line
+    const int lines = 50;
+    const int columns = 120;
+    QVector<Character> image = compilerOutputImage(lines, columns);
+    const QVector<LineProperty> lineProperties(lines, LINE_DEFAULT);
+
+    TerminalImageFilterChain chain;
+    chain.addFilter(new UrlFilter());
+    chain.setImage(image.constData(), lines, columns, lineProperties);
+    chain.process();
+
+    uint key = 'a';
+    QBENCHMARK {
+        image[(lines - 1) * columns].character = key;
+        key = key == 'z' ? 'a' : key + 1;
+        chain.setImage(image.constData(), lines, columns, lineProperties);
+        chain.process();
+    }
+
+    QCOMPARE(chain.hotSpots().size(), 2 * ((lines + 3) / 4));
+}
+
+void TerminalBenchmark::benchHotSpotAt()
+{
+    // what moving the mouse across the whole screen asks of the filters
+    const int lines = 50;
+    const int columns = 120;
+    const QVector<Character> image = compilerOutputImage(lines, columns);
+    const QVector<LineProperty> lineProperties(lines, LINE_DEFAULT);
+
+    TerminalImageFilterChain chain;
+    chain.addFilter(new UrlFilter());
+    chain.setImage(image.constData(), lines, columns, lineProperties);
+    chain.process();
+
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        for (int line = 0; line < lines; line++) {
+            for (int column = 0; column < columns; column++) {
+                if (chain.hotSpotAt(line, column) != nullptr) {
+                    found++;
+                }
+            }
+        }
+    }
+    QVERIFY(found > 0);
+
+    // "see " comes before the link on the first line
+    QVERIFY(chain.hotSpotAt(0, 3).isNull());
+    const auto spot = chain.hotSpotAt(0, 4);
+    QVERIFY(!spot.isNull());
+    QCOMPARE(spot->startColumn(), 4);
+    QVERIFY(chain.hotSpotAt(1, 4).isNull());
+
+    int spotsOnLine = 0;
+    chain.visitHotSpotsAtLine(0, [&](const QSharedPointer<Filter::HotSpot> &spot, int index) {
+        QCOMPARE(chain.hotSpots().at(index), spot);
+        spotsOnLine++;
+    });
+    QCOMPARE(spotsOnLine, 2);
+    QCOMPARE(chain.hotSpotCount(), chain.hotSpots().size());
+}
+
+static void decodeHistory(TerminalCharacterDecoder &decoder, const QVector<TextLine> &lines)
+{
+    QString result;
+    QTextStream stream(&result);
+    decoder.begin(&stream);
+    for (const TextLine &line : lines) {
+        decoder.decodeLine(line.constData(), line.size(), LINE_DEFAULT);
+    }
+    decoder.end();
+}
+
+void TerminalBenchmark::benchPlainTextDecoder()
+{
+    QVector<TextLine> lines;
+    for (int i = 0; i < 1000; i++) {
+        lines.append(makeLine(i));
+    }
+
+    PlainTextDecoder decoder;
+
+    QBENCHMARK {
+        decodeHistory(decoder, lines);
+    }
+}
+
+void TerminalBenchmark::benchHTMLDecoder()
+{
+    QVector<TextLine> lines;
+    for (int i = 0; i < 1000; i++) {
+        lines.append(makeLine(i));
+    }
+
+    HTMLDecoder decoder;
+
+    QBENCHMARK {
+        decodeHistory(decoder, lines);
+    }
+}
+
+void TerminalBenchmark::benchCharacterWidth_data()
+{
+    QTest::addColumn<uint>("first");
+    QTest::addColumn<uint>("last");
+
+    QTest::newRow("ascii") << 0x20u << 0x7Eu;
+    QTest::newRow("basic multilingual plane") << 0x0u << 0xFFFFu;
+    QTest::newRow("emoji") << 0x1F300u << 0x1FAFFu;
+}
+
+void TerminalBenchmark::benchCharacterWidth()
+{
+    QFETCH(uint, first);
+    QFETCH(uint, last);
+
+    int total = 0;
+    QBENCHMARK {
+        for (uint c = first; c <= last; c++) {
+            total += characterWidth(c);
+        }
+    }
+
+    // use the result so that the loop is not optimized away
+    QVERIFY(total != 0);
+}
+
+QTEST_GUILESS_MAIN(TerminalBenchmark)
@@ -0,0 +1,68 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+#ifndef TERMINALBENCHMARK_H
+#define TERMINALBENCHMARK_H
+
+#include <QObject>
+
+namespace Konsole
+{
+
+/**
+ * Micro-benchmarks for the data structures on the output path.
+ *
+ * Run the "benchmark" build target to get the results as CSV and XML,
+ * or the executable itself with any of QTest's output options.
+ */
+class TerminalBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void benchCompactHistoryAppend();
+    void benchCompactHistoryRead();
+    void benchCompactHistoryEvict();
+    void benchHistoryFileAppend();
+    void benchHistoryFileRead();
+
+    void benchDisplayCharacter_data();
+    void benchDisplayCharacter();
+    void benchScrollUp();
+
+    void benchSgrParsing();
+
+    void benchUrlFilter();
+    void benchUrlFilterOneLine();
+    void benchHotSpotAt();
+
+    void benchPlainTextDecoder();
+    void benchHTMLDecoder();
+
+    void benchCharacterWidth_data();
+    void benchCharacterWidth();
+
+};
+
+}
+
+#endif // TERMINALBENCHMARK_H
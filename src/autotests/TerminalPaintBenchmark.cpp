@@ -0,0 +1,101 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "TerminalPaintBenchmark.h"
+
+// Qt
+#include <QFontDatabase>
+#include <QImage>
+
+// KDE
+#include <qtest.h>
+
+// Konsole
+#include "../Screen.h"
+#include "../ScreenWindow.h"
+#include "../TerminalDisplay.h"
+
+using namespace Konsole;
+
+// the size of a maximized window on a 4K monitor
+static const int WIDTH = 3840;
+static const int HEIGHT = 2160;
+
+// Fills the screen with text as a program like ls would print it, with
+// the colors changing every few words
+static void fillScreen(Screen &screen)
+{
+    static const char TEXT[] = "drwxr-xr-x 2 konsole konsole 4096 Jun  1 12:00 ";
+
+    screen.setCursorYX(1, 1);
+    for (int line = 0; line < screen.getLines(); line++) {
+        for (int column = 0; column < screen.getColumns(); column++) {
+            if (column % 8 == 0) {
+                screen.setForeColor(COLOR_SPACE_SYSTEM, (line + column / 8) % 8);
+                if ((column / 8) % 3 == 0) {
+                    screen.setRendition(RE_BOLD);
+                } else {
+                    screen.resetRendition(RE_BOLD);
+                }
+            }
+            screen.displayCharacter(static_cast<uchar>(TEXT[(line + column) % (sizeof(TEXT) - 1)]));
+        }
+    }
+}
+
+void TerminalPaintBenchmark::benchFullRepaint_data()
+{
+    QTest::addColumn<bool>("threaded");
+
+    QTest::newRow("single thread") << false;
+    QTest::newRow("threaded") << true;
+}
+
+void TerminalPaintBenchmark::benchFullRepaint()
+{
+    QFETCH(bool, threaded);
+
+    TerminalDisplay display(nullptr);
+    display.setAttribute(Qt::WA_DontShowOnScreen);
+    display.setVTFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    display.setThreadedRendering(threaded);
+    display.resize(WIDTH, HEIGHT);
+    display.show();
+
+    Screen screen(display.lines(), display.columns());
+    ScreenWindow window(&screen);
+    window.setWindowLines(display.lines());
+    display.setScreenWindow(&window);
+    fillScreen(screen);
+    display.updateImage();
+
+    QImage image(display.size(), QImage::Format_ARGB32_Premultiplied);
+
+    QBENCHMARK {
+        display.render(&image);
+    }
+
+    display.setScreenWindow(nullptr);
+}
+
+QTEST_MAIN(TerminalPaintBenchmark)
@@ -20,12 +20,20 @@
 // Own
 #include "TerminalTest.h"
 
+// Qt
+#include <QFontDatabase>
+#include <QImage>
+
 #include "qtest.h"
 
 // Konsole
 #include "../TerminalDisplay.h"
 #include "../CharacterColor.h"
 #include "../ColorScheme.h"
+#include "../Filter.h"
+#include "../Screen.h"
+#include "../ScreenWindow.h"
+#include "../Vt102Emulation.h"
 
 using namespace Konsole;
 
@@ -89,4 +97,112 @@ void TerminalTest::testSize()
     delete display;
 }
 
+void TerminalTest::testFloodMode()
+{
+    // a display which is not shown has a single line
+    Vt102Emulation emulation;
+    emulation.setImageSize(1, 80);
+    emulation.receiveData("http://example.com", 18);
+
+    auto display = new TerminalDisplay(nullptr);
+    display->filterChain()->addFilter(new UrlFilter());
+    display->setScreenWindow(emulation.createWindow());
+    display->processFilters();
+    QTRY_COMPARE(display->filterChain()->hotSpotCount(), 1);
+
+    // the links found so far are dropped when the output starts flooding,
+    // as the text under them is about to scroll away ...
+    display->setFloodMode(true);
+    QCOMPARE(display->filterChain()->hotSpotCount(), 0);
+    QVERIFY(display->filterChain()->hotSpotAt(0, 0).isNull());
+
+    // ... and no new ones are found while it lasts
+    emulation.receiveData(" www.example.org", 16);
+    QTest::qWait(100);
+    display->processFilters();
+    QTest::qWait(100);
+    QCOMPARE(display->filterChain()->hotSpotCount(), 0);
+
+    // once the output calms down, all of the text is searched again
+    display->setFloodMode(false);
+    display->processFilters();
+    QTRY_COMPARE(display->filterChain()->hotSpotCount(), 2);
+
+    delete display;
+}
+
+void TerminalTest::testThreadedRendering()
+{
+    if (!QFontDatabase::supportsThreadedFontRendering()) {
+        QSKIP("The platform cannot render text outside of the GUI thread");
+    }
+
+    TerminalDisplay display(nullptr);
+    display.setAttribute(Qt::WA_DontShowOnScreen);
+    display.setVTFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    display.resize(1280, 800);
+    display.show();
+
+    // enough lines to be split into several bands
+    QVERIFY(display.lines() >= 32);
+
+    Screen screen(display.lines(), display.columns());
+    ScreenWindow window(&screen);
+    window.setWindowLines(display.lines());
+    display.setScreenWindow(&window);
+
+    // colored, bold, italic and reversed text on colored backgrounds, with
+    // a few wide characters in between.  Italic glyphs overhang their
+    // cells, also across the boundaries of the bands.
+    static const char TEXT[] = "drwxr-xr-x 2 konsole konsole 4096 Jun  1 12:00 ";
+    screen.setCursorYX(1, 1);
+    for (int line = 0; line < screen.getLines(); line++) {
+        for (int column = 0; column < screen.getColumns() - 1; column++) {
+            if (column % 8 == 0) {
+                screen.setForeColor(COLOR_SPACE_SYSTEM, (line + column / 8) % 8);
+                screen.setBackColor(COLOR_SPACE_SYSTEM, (line + column / 16) % 8);
+                if ((column / 8) % 3 == 0) {
+                    screen.setRendition(RE_BOLD);
+                } else {
+                    screen.resetRendition(RE_BOLD);
+                }
+                if ((column / 8) % 4 == 1) {
+                    screen.setRendition(RE_ITALIC);
+                } else {
+                    screen.resetRendition(RE_ITALIC);
+                }
+                if ((column / 8) % 5 == 0) {
+                    screen.setRendition(RE_REVERSE);
+                } else {
+                    screen.resetRendition(RE_REVERSE);
+                }
+            }
+            if (column % 24 == 0) {
+                screen.displayCharacter(0x4E2D);
+                column++;
+            } else {
+                screen.displayCharacter(static_cast<uchar>(TEXT[(line + column) % (sizeof(TEXT) - 1)]));
+            }
+        }
+        screen.setCursorYX(line + 2, 1);
+    }
+    display.updateImage();
+
+    const auto render = [&display](bool threaded) {
+        display.setThreadedRendering(threaded);
+        QImage image(display.size(), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        display.render(&image);
+        return image;
+    };
+
+    // the bands painted by the pool threads must add up to the same
+    // picture as painting all of the display on the GUI thread
+    const QImage direct = render(false);
+    const QImage threaded = render(true);
+    QCOMPARE(threaded, direct);
+
+    display.setScreenWindow(nullptr);
+}
+
 QTEST_MAIN(TerminalTest)
@@ -33,6 +33,8 @@ private Q_SLOTS:
     void testScrollBarPositions();
     void testColorTable();
     void testSize();
+    void testFloodMode();
+    void testThreadedRendering();
 
 private:
 };
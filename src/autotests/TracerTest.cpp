@@ -0,0 +1,135 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+
+// Own
+#include "TracerTest.h"
+
+// Qt
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+// KDE
+#include <qtest.h>
+
+#include "../Tracer.h"
+
+using namespace Konsole;
+
+void TracerTest::testTraceEvents()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("trace.json"));
+
+    Tracer tracer;
+    QVERIFY(tracer.start(fileName, QStringLiteral("Session \"1\"")));
+    QVERIFY(tracer.isTracing());
+    {
+        TraceScope trace(&tracer, Tracer::ParseStage);
+    }
+    tracer.addEvent(Tracer::PaintStage, 2000000, 2500000);
+    tracer.stop();
+    QVERIFY(!tracer.isTracing());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(document.isArray());
+
+    // the process name, the name of this thread and the two events
+    const QJsonArray events = document.array();
+    QCOMPARE(events.size(), 4);
+
+    QCOMPARE(events.at(0).toObject().value(QStringLiteral("name")).toString(), QStringLiteral("process_name"));
+    QCOMPARE(events.at(0).toObject().value(QStringLiteral("args")).toObject().value(QStringLiteral("name")).toString(),
+             QStringLiteral("Session \"1\""));
+    QCOMPARE(events.at(1).toObject().value(QStringLiteral("name")).toString(), QStringLiteral("thread_name"));
+
+    const QJsonObject parse = events.at(2).toObject();
+    QCOMPARE(parse.value(QStringLiteral("name")).toString(), QStringLiteral("parse"));
+    QCOMPARE(parse.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+    QVERIFY(parse.value(QStringLiteral("dur")).toDouble() >= 0);
+
+    const QJsonObject paint = events.at(3).toObject();
+    QCOMPARE(paint.value(QStringLiteral("name")).toString(), QStringLiteral("paint"));
+    QCOMPARE(paint.value(QStringLiteral("ts")).toDouble(), 2000.0);
+    QCOMPARE(paint.value(QStringLiteral("dur")).toDouble(), 500.0);
+    QCOMPARE(paint.value(QStringLiteral("tid")), events.at(1).toObject().value(QStringLiteral("tid")));
+}
+
+void TracerTest::testDisabled()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("trace.json"));
+
+    Tracer tracer;
+    QVERIFY(!tracer.isTracing());
+    {
+        // no events are recorded before the trace starts
+        TraceScope trace(&tracer, Tracer::ParseStage);
+        QVERIFY(tracer.start(fileName, QStringLiteral("Session")));
+    }
+    tracer.stop();
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    QCOMPARE(document.array().size(), 1);
+
+    // a null tracer is allowed
+    TraceScope trace(nullptr, Tracer::PaintStage);
+}
+
+void TracerTest::testTotals()
+{
+    Tracer tracer;
+    QVERIFY(!tracer.isActive());
+
+    // nothing is summed up before a collector is added
+    tracer.addEvent(Tracer::ParseStage, 0, 1000);
+
+    tracer.addCollector();
+    QVERIFY(tracer.isActive());
+    QVERIFY(!tracer.isTracing());
+
+    tracer.addEvent(Tracer::ParseStage, 0, 1000);
+    tracer.addEvent(Tracer::ParseStage, 5000, 7000);
+    tracer.addCount(Tracer::ReceivedBytesCounter, 4096);
+    tracer.addCount(Tracer::ReceivedBytesCounter, 100);
+
+    const Tracer::Totals totals = tracer.totals();
+    QCOMPARE(totals.time[Tracer::ParseStage], qint64(3000));
+    QCOMPARE(totals.runs[Tracer::ParseStage], qint64(2));
+    QCOMPARE(totals.time[Tracer::PaintStage], qint64(0));
+    QCOMPARE(totals.counters[Tracer::ReceivedBytesCounter], qint64(4196));
+    QCOMPARE(totals.counters[Tracer::DirtyLinesCounter], qint64(0));
+
+    tracer.removeCollector();
+    QVERIFY(!tracer.isActive());
+}
+
+QTEST_GUILESS_MAIN(TracerTest)
@@ -0,0 +1,208 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TrigramIndexTest.h"
+
+// Qt
+#include <QRegularExpression>
+
+// KDE
+#include <qtest.h>
+
+#include "../History.h"
+#include "../Screen.h"
+#include "../TrigramIndex.h"
+
+using namespace Konsole;
+
+static void addLine(TrigramIndex &index, const QString &text, bool wrapped = false)
+{
+    QVector<Character> line;
+    for (const uint ch : text.toUcs4()) {
+        line.append(Character(ch));
+    }
+    index.addLine(line.constData(), line.size(), wrapped);
+}
+
+void TrigramIndexTest::testCandidateLines()
+{
+    TrigramIndex index(2);
+    addLine(index, QStringLiteral("make: Entering directory"));
+    addLine(index, QStringLiteral("gcc -c main.cpp"));
+    addLine(index, QStringLiteral("main.cpp:12: error: expected ';'"));
+    addLine(index, QStringLiteral("make: *** [Makefile:3: all] Error 1"));
+
+    QCOMPARE(index.lineCount(), 6);
+    QCOMPARE(index.firstIndexedLine(), 2);
+
+    // the two lines which were there before are always candidates, and so
+    // are the lines after the history
+    QCOMPARE(index.candidateLines(QStringLiteral("error"), 0, 7), QVector<int>({0, 1, 4, 5, 6, 7}));
+    QCOMPARE(index.candidateLines(QStringLiteral("main.cpp"), 2, 5), QVector<int>({3, 4}));
+    QCOMPARE(index.candidateLines(QStringLiteral("MAKE:"), 2, 5), QVector<int>({2, 5}));
+    QCOMPARE(index.candidateLines(QStringLiteral("make: E"), 2, 5), QVector<int>({2}));
+    QCOMPARE(index.candidateLines(QStringLiteral("nowhere"), 2, 5), QVector<int>());
+    QCOMPARE(index.candidateLines(QStringLiteral("main"), 4, 4), QVector<int>({4}));
+
+    // too short to have a trigram
+    QCOMPARE(index.candidateLines(QStringLiteral("ma"), 2, 5), QVector<int>({2, 3, 4, 5}));
+}
+
+void TrigramIndexTest::testWrappedLines()
+{
+    TrigramIndex index;
+    addLine(index, QStringLiteral("first"));
+    addLine(index, QStringLiteral("a very long li"), true);
+    addLine(index, QStringLiteral("ne which wra"), true);
+    addLine(index, QStringLiteral("ps twice"));
+    addLine(index, QStringLiteral("last"));
+
+    // text across the ends of wrapped lines is found on their first line
+    QCOMPARE(index.candidateLines(QStringLiteral("long line which wraps"), 0, 4), QVector<int>({1}));
+    QCOMPARE(index.candidateLines(QStringLiteral("twice"), 0, 4), QVector<int>({1}));
+    QCOMPARE(index.candidateLines(QStringLiteral("last"), 0, 4), QVector<int>({4}));
+
+    // a wrapped line which starts before the lines asked about is found on
+    // the first of them
+    QCOMPARE(index.candidateLines(QStringLiteral("twice"), 2, 4), QVector<int>({2}));
+    QCOMPARE(index.candidateLines(QStringLiteral("twice"), 3, 4), QVector<int>({3}));
+    QCOMPARE(index.candidateLines(QStringLiteral("last"), 2, 4), QVector<int>({4}));
+
+    // the last line of the history may continue beyond it, where the text
+    // is not indexed
+    addLine(index, QStringLiteral("the end of the hist"), true);
+    QCOMPARE(index.lineCount(), 6);
+    QCOMPARE(index.candidateLines(QStringLiteral("history"), 0, 5), QVector<int>());
+    QCOMPARE(index.candidateLines(QStringLiteral("history"), 0, 6), QVector<int>({5, 6}));
+    QCOMPARE(index.candidateLines(QStringLiteral("twice"), 2, 6), QVector<int>({2, 5, 6}));
+}
+
+void TrigramIndexTest::testRemoveLines()
+{
+    TrigramIndex index;
+    addLine(index, QStringLiteral("start of a wrapped li"), true);
+    addLine(index, QStringLiteral("ne and its end"));
+    for (int i = 0; i < 10; i++) {
+        addLine(index, QStringLiteral("line %1").arg(i));
+    }
+
+    // once the first line is gone, the rest of the wrapped line is no longer indexed
+    index.removeLines(1);
+    QCOMPARE(index.lineCount(), 11);
+    QCOMPARE(index.firstIndexedLine(), 1);
+    QCOMPARE(index.candidateLines(QStringLiteral("line 3"), 0, 10), QVector<int>({0, 4}));
+
+    index.removeLines(5);
+    QCOMPARE(index.lineCount(), 6);
+    QCOMPARE(index.firstIndexedLine(), 0);
+    QCOMPARE(index.candidateLines(QStringLiteral("line 3"), 0, 5), QVector<int>());
+    QCOMPARE(index.candidateLines(QStringLiteral("line 7"), 0, 5), QVector<int>({3}));
+
+    index.reset(3);
+    QCOMPARE(index.lineCount(), 3);
+    QCOMPARE(index.firstIndexedLine(), 3);
+    QCOMPARE(index.memoryUsage(), qint64(0));
+}
+
+void TrigramIndexTest::testMemoryCap()
+{
+    TrigramIndex index;
+    index.setMaximumMemoryUsage(64 * 1024);
+
+    const int lines = 5000;
+    for (int i = 0; i < lines; i++) {
+        addLine(index, QStringLiteral("line %1 of %2").arg(i).arg(lines));
+        QVERIFY(index.memoryUsage() <= index.maximumMemoryUsage());
+    }
+
+    // the oldest lines were dropped, the newest are still indexed
+    QCOMPARE(index.lineCount(), lines);
+    QVERIFY(index.firstIndexedLine() > 0);
+    QVERIFY(index.firstIndexedLine() < lines - 1);
+    const QString last = QStringLiteral("line %1 of %2").arg(lines - 1).arg(lines);
+    QCOMPARE(index.candidateLines(last, index.firstIndexedLine(), lines - 1), QVector<int>({lines - 1}));
+}
+
+void TrigramIndexTest::testScreenHistory()
+{
+    // the screen indexes each line it moves into the history, and forgets
+    // those which the history drops once it is full
+    Screen screen(4, 20);
+    screen.setScroll(CompactHistoryType(10));
+    screen.setHistoryIndexEnabled(true);
+    for (int line = 0; line < 30; line++) {
+        for (const QChar &ch : QStringLiteral("line %1").arg(line)) {
+            screen.displayCharacter(ch.unicode());
+        }
+        screen.toStartOfLine();
+        screen.newLine();
+    }
+
+    // lines 17 to 26 are in the history, the others on the screen
+    const TrigramIndex *index = screen.historyIndex();
+    QVERIFY(index != nullptr);
+    QCOMPARE(screen.getHistLines(), 10);
+    QCOMPARE(index->lineCount(), 10);
+    QCOMPARE(index->firstIndexedLine(), 0);
+    QCOMPARE(index->candidateLines(QStringLiteral("line 17"), 0, 9), QVector<int>({0}));
+    QCOMPARE(index->candidateLines(QStringLiteral("line 25"), 0, 9), QVector<int>({8}));
+    QCOMPARE(index->candidateLines(QStringLiteral("line 5"), 0, 9), QVector<int>());
+    QCOMPARE(index->candidateLines(QStringLiteral("line 16"), 0, 9), QVector<int>());
+    QCOMPARE(index->candidateLines(QStringLiteral("line 28"), 0, 13), QVector<int>({10, 11, 12, 13}));
+
+    // clearing the history empties the index
+    screen.setScroll(CompactHistoryType(10), false);
+    QCOMPARE(index->lineCount(), 0);
+    QCOMPARE(index->candidateLines(QStringLiteral("line 25"), 0, 3), QVector<int>({0, 1, 2, 3}));
+}
+
+void TrigramIndexTest::testRequiredLiteral_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("literal");
+
+    QTest::newRow("plain") << QStringLiteral("error") << QStringLiteral("error");
+    QTest::newRow("escaped") << QRegularExpression::escape(QStringLiteral("a.b (c)|d"))
+                             << QStringLiteral("a.b (c)|d");
+    QTest::newRow("longest run") << QStringLiteral("ab.cdef\\d+gh") << QStringLiteral("cdef");
+    QTest::newRow("optional character") << QStringLiteral("colou?r") << QStringLiteral("colo");
+    QTest::newRow("repeated character") << QStringLiteral("xx+yy") << QStringLiteral("xx");
+    QTest::newRow("counted") << QStringLiteral("abcd{0,2}") << QStringLiteral("abc");
+    QTest::newRow("literal brace") << QStringLiteral("a{b}cd") << QStringLiteral("a{b}cd");
+    QTest::newRow("group") << QStringLiteral("(foo)?barbaz") << QStringLiteral("barbaz");
+    QTest::newRow("class") << QStringLiteral("[a-z]]+word") << QStringLiteral("word");
+    QTest::newRow("alternation") << QStringLiteral("foo|bar") << QString();
+    QTest::newRow("alternation in group") << QStringLiteral("(a|b)input") << QStringLiteral("input");
+    QTest::newRow("back reference") << QStringLiteral("(a)\\1abc") << QString();
+    QTest::newRow("extended") << QStringLiteral("(?x) a b c") << QString();
+    QTest::newRow("posix class") << QStringLiteral("[[:alpha:]]xyz") << QString();
+}
+
+void TrigramIndexTest::testRequiredLiteral()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, literal);
+
+    QCOMPARE(TrigramIndex::requiredLiteral(QRegularExpression(pattern)), literal);
+}
+
+QTEST_GUILESS_MAIN(TrigramIndexTest)
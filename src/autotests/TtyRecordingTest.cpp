@@ -0,0 +1,98 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "TtyRecordingTest.h"
+
+// Qt
+#include <QDateTime>
+#include <QTemporaryDir>
+
+// KDE
+#include <qtest.h>
+
+#include "../TtyRecording.h"
+
+using namespace Konsole;
+
+void TtyRecordingTest::testRoundTrip()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("session.ttyrec"));
+
+    const QList<QByteArray> blocks = {
+        QByteArrayLiteral("$ ls\r\n"),
+        QByteArray("\033[1;31mred\033[0m\r\n").repeated(1000),
+        QByteArray("\0binary\0data\0", 13),
+    };
+
+    const qint64 before = QDateTime::currentMSecsSinceEpoch() * 1000;
+    TtyRecorder recorder;
+    QVERIFY(recorder.open(fileName));
+    for (const QByteArray &block : blocks) {
+        recorder.record(block.constData(), block.size());
+    }
+    // empty blocks are not recorded
+    recorder.record("", 0);
+    recorder.close();
+    const qint64 after = (QDateTime::currentMSecsSinceEpoch() + 1) * 1000;
+
+    TtyRecordingReader reader;
+    QVERIFY(reader.open(fileName));
+    TtyRecordingReader::Frame frame;
+    qint64 previousTime = 0;
+    for (const QByteArray &block : blocks) {
+        QVERIFY(reader.readFrame(frame));
+        QCOMPARE(frame.data, block);
+        QVERIFY(frame.time >= before && frame.time <= after);
+        QVERIFY(frame.time >= previousTime);
+        previousTime = frame.time;
+    }
+    QVERIFY(!reader.readFrame(frame));
+    QVERIFY(reader.errorString().isEmpty());
+}
+
+void TtyRecordingTest::testTruncatedRecording()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("truncated.ttyrec"));
+
+    TtyRecorder recorder;
+    QVERIFY(recorder.open(fileName));
+    recorder.record("complete", 8);
+    recorder.record("incomplete", 10);
+    recorder.close();
+
+    QFile file(fileName);
+    QVERIFY(file.resize(file.size() - 2));
+
+    TtyRecordingReader reader;
+    QVERIFY(reader.open(fileName));
+    TtyRecordingReader::Frame frame;
+    QVERIFY(reader.readFrame(frame));
+    QCOMPARE(frame.data, QByteArrayLiteral("complete"));
+    QVERIFY(!reader.readFrame(frame));
+    QVERIFY(!reader.errorString().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TtyRecordingTest)
@@ -0,0 +1,111 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Own
+#include "Utf8DecoderTest.h"
+
+// Qt
+#include <QFile>
+#include <QTextCodec>
+
+// KDE
+#include <qtest.h>
+
+#include "../Utf8Decoder.h"
+
+using namespace Konsole;
+
+void Utf8DecoderTest::testDecode_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<QVector<uint> >("expected");
+
+    QTest::newRow("ascii") << QByteArray("abc\r\n") << QVector<uint>{'a', 'b', 'c', '\r', '\n'};
+    QTest::newRow("two bytes") << QByteArray("\xc3\xa9") << QVector<uint>{0xE9};
+    QTest::newRow("three bytes") << QByteArray("\xe2\x82\xac") << QVector<uint>{0x20AC};
+    QTest::newRow("four bytes") << QByteArray("\xf0\x9f\x98\x80") << QVector<uint>{0x1F600};
+    QTest::newRow("leading BOM") << QByteArray("\xef\xbb\xbfx") << QVector<uint>{'x'};
+    QTest::newRow("later BOM") << QByteArray("x\xef\xbb\xbf") << QVector<uint>{'x', 0xFEFF};
+    QTest::newRow("stray continuation") << QByteArray("a\x80z") << QVector<uint>{'a', 0xFFFD, 'z'};
+    QTest::newRow("truncated sequence") << QByteArray("\xe2\x28\xa1") << QVector<uint>{0xFFFD, '(', 0xFFFD};
+    QTest::newRow("overlong") << QByteArray("\xe0\x80\xaf") << QVector<uint>{0xFFFD};
+    QTest::newRow("surrogate") << QByteArray("\xed\xa0\x80") << QVector<uint>{0xFFFD};
+    QTest::newRow("beyond U+10FFFF") << QByteArray("\xf4\x90\x80\x80") << QVector<uint>{0xFFFD};
+    QTest::newRow("invalid lead byte") << QByteArray("\xc0\xff") << QVector<uint>{0xFFFD, 0xFFFD};
+}
+
+void Utf8DecoderTest::testDecode()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(QVector<uint>, expected);
+
+    Utf8Decoder decoder;
+    QVector<uint> output;
+    decoder.decode(input.constData(), input.size(), output);
+
+    QCOMPARE(output, expected);
+}
+
+void Utf8DecoderTest::testSplitSequences()
+{
+    const QByteArray input("a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80z");
+    const QVector<uint> expected{'a', 0xE9, 0x20AC, 0x1F600, 'z'};
+
+    // feed the input one byte at a time, as a slow pty might deliver it
+    Utf8Decoder decoder;
+    QVector<uint> output;
+    QVector<uint> decoded;
+    for (const char c : input) {
+        decoder.decode(&c, 1, output);
+        decoded += output;
+    }
+    QCOMPARE(decoded, expected);
+
+    // a pending sequence is discarded by reset()
+    decoder.decode(input.constData(), 2, output);
+    QCOMPARE(output, QVector<uint>{'a'});
+    decoder.reset();
+    decoder.decode("b", 1, output);
+    QCOMPARE(output, QVector<uint>{'b'});
+}
+
+void Utf8DecoderTest::testMatchesQTextCodec()
+{
+    QFile file(QFINDTESTDATA(QStringLiteral("../../tests/UTF-8-demo.txt")));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray input = file.readAll();
+
+    const QVector<uint> expected = QTextCodec::codecForName("UTF-8")->toUnicode(input).toUcs4();
+
+    Utf8Decoder decoder;
+    QVector<uint> output;
+    QVector<uint> decoded;
+    // use an odd chunk size so that multi-byte sequences straddle reads
+    const int chunkSize = 61;
+    for (int pos = 0; pos < input.size(); pos += chunkSize) {
+        decoder.decode(input.constData() + pos, qMin(chunkSize, input.size() - pos), output);
+        decoded += output;
+    }
+
+    QCOMPARE(decoded, expected);
+}
+
+QTEST_GUILESS_MAIN(Utf8DecoderTest)
@@ -20,8 +20,12 @@
 // Own
 #include "Vt102EmulationTest.h"
 
+#include <QKeyEvent>
+#include <QSignalSpy>
 #include "qtest.h"
 
+#include "../Vt102Emulation.h"
+
 // The below is to verify the old #defines match the new constexprs
 // Just copy/paste for now from Vt102Emulation.cpp
 #define TY_CONSTRUCT(T,A,N) ( ((((int)(N)) & 0xffff) << 16) | ((((int)(A)) & 0xff) << 8) | (((int)(T)) & 0xff) )
@@ -117,4 +121,82 @@ void Vt102EmulationTest::testTokenFunctions()
     QCOMPARE(token_vt52('>'), TY_VT52('>'));
 }
 
+void Vt102EmulationTest::testSynchronizedUpdate()
+{
+    Vt102Emulation emulation;
+    QSignalSpy replySpy(&emulation, &Emulation::sendData);
+    QSignalSpy outputSpy(&emulation, &Emulation::outputChanged);
+
+    // far longer than the waits below, so that a slow machine does not
+    // end the frame early
+    emulation.setSynchronizedUpdateTimeout(60000);
+
+    // DECRQM reports the mode as supported and currently reset
+    emulation.receiveData("\033[?2026$p", 10);
+    QCOMPARE(replySpy.count(), 1);
+    QCOMPARE(replySpy.takeFirst().at(0).toByteArray(), QByteArray("\033[?2026;2$y"));
+
+    // let the update scheduled by the query above go through
+    QTRY_COMPARE(outputSpy.count(), 1);
+    outputSpy.clear();
+
+    // no views are updated while the frame is being drawn ...
+    emulation.receiveData("\033[?2026h", 8);
+    emulation.receiveData("\033[?2026$p", 10);
+    QCOMPARE(replySpy.takeFirst().at(0).toByteArray(), QByteArray("\033[?2026;1$y"));
+    emulation.receiveData("frame", 5);
+    QTest::qWait(100);
+    QCOMPARE(outputSpy.count(), 0);
+
+    // ... and they are updated straight away once it is complete
+    emulation.receiveData("\033[?2026l", 8);
+    QCOMPARE(outputSpy.count(), 1);
+    QTest::qWait(100);
+    QCOMPARE(outputSpy.count(), 1);
+    outputSpy.clear();
+
+    // a frame which is never completed is shown after a timeout, and the
+    // mode is reported as reset from then on
+    emulation.setSynchronizedUpdateTimeout(10);
+    emulation.receiveData("\033[?2026h", 8);
+    emulation.receiveData("unfinished", 10);
+    QTRY_COMPARE_WITH_TIMEOUT(outputSpy.count(), 1, 10000);
+    emulation.receiveData("\033[?2026$p", 10);
+    QCOMPARE(replySpy.takeFirst().at(0).toByteArray(), QByteArray("\033[?2026;2$y"));
+
+    // modes which are not known are reported as such
+    emulation.receiveData("\033[?9999$p", 10);
+    QCOMPARE(replySpy.takeFirst().at(0).toByteArray(), QByteArray("\033[?9999;0$y"));
+}
+
+void Vt102EmulationTest::testFramePacing()
+{
+    Vt102Emulation emulation;
+    emulation.setKeyBindings(QString());
+    QSignalSpy outputSpy(&emulation, &Emulation::outputChanged);
+
+    // a screen refreshing far less often than the test could take
+    emulation.setMinimumFrameInterval(60000);
+
+    // output which does not follow user input is only batched for a short
+    // time, not for the whole frame interval
+    emulation.receiveData("output", 6);
+    QTRY_COMPARE_WITH_TIMEOUT(outputSpy.count(), 1, 10000);
+
+    // the echo of a key press is shown as soon as the screen can display
+    // it, so not again until the refresh interval since the last frame
+    // has passed
+    QKeyEvent keyPress(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, QStringLiteral("a"));
+    emulation.sendKeyEvent(&keyPress);
+    emulation.receiveData("a", 1);
+    QTest::qWait(200);
+    QCOMPARE(outputSpy.count(), 1);
+
+    // once it has passed, the echo is shown straight away
+    emulation.setMinimumFrameInterval(1);
+    emulation.sendKeyEvent(&keyPress);
+    emulation.receiveData("b", 1);
+    QTRY_COMPARE_WITH_TIMEOUT(outputSpy.count(), 2, 10000);
+}
+
 QTEST_GUILESS_MAIN(Vt102EmulationTest)
@@ -5,6 +5,9 @@
 
 #cmakedefine01 HAVE_X11
 
+/* Defined if epoll is available to read the ptys in a background thread */
+#cmakedefine01 HAVE_SYS_EPOLL_H
+
 /* If defined, remove public access to dbus sendInput/runCommand */
 #cmakedefine REMOVE_SENDTEXT_RUNCOMMAND_DBUS_METHODS
 
@@ -0,0 +1,163 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Feeds a byte stream through the terminal emulation, without any views,
+// and prints the resulting screen.  Useful to profile the parser and the
+// screen model, and to compare their output between versions.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QTextCodec>
+#include <QTextStream>
+
+#include "History.h"
+#include "TerminalCharacterDecoder.h"
+#include "Vt102Emulation.h"
+
+using namespace Konsole;
+
+// amount of input passed to the emulation at a time, about what the
+// pty delivers with each read when a program writes a lot of output
+static const int BLOCK_SIZE = 4096;
+
+static bool feedFile(Emulation &emulation, QFile &file)
+{
+    char buffer[BLOCK_SIZE];
+    forever {
+        const qint64 count = file.read(buffer, BLOCK_SIZE);
+        if (count < 0) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+        emulation.receiveData(buffer, static_cast<int>(count));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("vtdump"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Runs terminal output through Konsole's emulation and prints the final screen.")
+    );
+    parser.addHelpOption();
+    parser.addOptions({
+        {{QStringLiteral("c"), QStringLiteral("columns")},
+            QStringLiteral("Width of the screen."),
+            QStringLiteral("columns"), QStringLiteral("80")},
+        {{QStringLiteral("l"), QStringLiteral("lines")},
+            QStringLiteral("Height of the screen."),
+            QStringLiteral("lines"), QStringLiteral("24")},
+        {QStringLiteral("history"),
+            QStringLiteral("Number of history lines to keep, -1 for unlimited."),
+            QStringLiteral("lines"), QStringLiteral("1000")},
+        {QStringLiteral("encoding"),
+            QStringLiteral("Encoding of the input."),
+            QStringLiteral("name"), QStringLiteral("UTF-8")},
+        {{QStringLiteral("a"), QStringLiteral("all")},
+            QStringLiteral("Print the history as well as the screen.")},
+        {QStringLiteral("html"),
+            QStringLiteral("Print HTML with the colors and attributes of the text.")},
+        {QStringLiteral("trim"),
+            QStringLiteral("Leave out trailing whitespace.")},
+    });
+    parser.addPositionalArgument(QStringLiteral("files"),
+                                 QStringLiteral("Files to read, in order (standard input if none is given)."),
+                                 QStringLiteral("[files...]"));
+    parser.process(app);
+
+    QTextStream err(stderr, QIODevice::WriteOnly);
+
+    bool columnsOk = false;
+    bool linesOk = false;
+    bool historyOk = false;
+    const int columns = parser.value(QStringLiteral("columns")).toInt(&columnsOk);
+    const int lines = parser.value(QStringLiteral("lines")).toInt(&linesOk);
+    const int history = parser.value(QStringLiteral("history")).toInt(&historyOk);
+    if (!columnsOk || !linesOk || !historyOk || columns < 1 || lines < 1) {
+        err << QStringLiteral("Invalid screen or history size.") << endl;
+        return 1;
+    }
+
+    const QTextCodec *codec = QTextCodec::codecForName(parser.value(QStringLiteral("encoding")).toLatin1());
+    if (codec == nullptr) {
+        err << QStringLiteral("Unknown encoding: ") << parser.value(QStringLiteral("encoding")) << endl;
+        return 1;
+    }
+
+    Vt102Emulation emulation;
+    emulation.setCodec(codec);
+    emulation.setImageSize(lines, columns);
+    if (history < 0) {
+        emulation.setHistory(HistoryTypeFile());
+    } else if (history == 0) {
+        emulation.setHistory(HistoryTypeNone());
+    } else {
+        emulation.setHistory(CompactHistoryType(history));
+    }
+
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        files << QStringLiteral("-");
+    }
+    for (const QString &fileName : qAsConst(files)) {
+        QFile file;
+        bool opened;
+        if (fileName == QLatin1String("-")) {
+            opened = file.open(stdin, QIODevice::ReadOnly);
+        } else {
+            file.setFileName(fileName);
+            opened = file.open(QIODevice::ReadOnly);
+        }
+        if (!opened || !feedFile(emulation, file)) {
+            err << QStringLiteral("Could not read ") << fileName << QStringLiteral(": ") << file.errorString() << endl;
+            return 1;
+        }
+    }
+
+    PlainTextDecoder plainTextDecoder;
+    plainTextDecoder.setTrailingWhitespace(!parser.isSet(QStringLiteral("trim")));
+    HTMLDecoder htmlDecoder;
+    TerminalCharacterDecoder *decoder = &plainTextDecoder;
+    if (parser.isSet(QStringLiteral("html"))) {
+        decoder = &htmlDecoder;
+    }
+
+    const int lastLine = emulation.lineCount() - 1;
+    const int firstLine = parser.isSet(QStringLiteral("all")) ? 0 : lastLine - emulation.imageSize().height() + 1;
+
+    QString text;
+    QTextStream stream(&text);
+    decoder->begin(&stream);
+    emulation.writeToStream(decoder, firstLine, lastLine);
+    decoder->end();
+
+    QTextStream out(stdout, QIODevice::WriteOnly);
+    out.setCodec("UTF-8");
+    out << text << endl;
+
+    return 0;
+}
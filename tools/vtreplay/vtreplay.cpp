@@ -0,0 +1,292 @@
+/*
+    This file is part of Konsole, a terminal emulator for KDE.
+
+    Copyright 2020 by the Konsole Developers
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301  USA.
+*/
+
+// Replays terminal output through the emulation and measures how fast it
+// is processed.  The input is either a recording made with
+// Session::startRecording() or, with --raw, a plain byte stream such as
+// the files in the tests/ directory.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextCodec>
+#include <QTextStream>
+#include <QThread>
+
+#include "History.h"
+#include "ScreenWindow.h"
+#include "TtyRecording.h"
+#include "Utf8Decoder.h"
+#include "Vt102Emulation.h"
+
+using namespace Konsole;
+
+// size of the blocks a raw byte stream is cut into, about what the pty
+// delivers with each read when a program writes a lot of output
+static const int RAW_BLOCK_SIZE = 4096;
+
+struct Workload {
+    QList<TtyRecordingReader::Frame> frames;
+    qint64 bytes;
+};
+
+static bool loadWorkload(const QString &fileName, bool raw, Workload &workload, QString &error)
+{
+    workload.bytes = 0;
+
+    if (raw) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            error = file.errorString();
+            return false;
+        }
+        TtyRecordingReader::Frame frame;
+        frame.time = 0;
+        while (!(frame.data = file.read(RAW_BLOCK_SIZE)).isEmpty()) {
+            workload.frames.append(frame);
+            workload.bytes += frame.data.size();
+        }
+        return true;
+    }
+
+    TtyRecordingReader reader;
+    if (!reader.open(fileName)) {
+        error = reader.errorString();
+        return false;
+    }
+    TtyRecordingReader::Frame frame;
+    while (reader.readFrame(frame)) {
+        workload.frames.append(frame);
+        workload.bytes += frame.data.size();
+    }
+    error = reader.errorString();
+    return error.isEmpty();
+}
+
+struct Statistics {
+    qint64 bytes = 0;
+    qint64 scrolledLines = 0;
+    int frames = 0;
+    // wall time of the whole replay, including any waiting
+    qint64 totalTime = 0;
+    // time spent in Emulation::receiveData(), which decodes, parses and
+    // updates the screen
+    qint64 emulationTime = 0;
+    // time spent decoding, measured in a separate pass
+    qint64 decodeTime = 0;
+    // time spent updating the views: Emulation::showBulk() and
+    // ScreenWindow::getImage()
+    qint64 frameTime = 0;
+};
+
+// updates the window as a view would and counts the lines it scrolled by
+static void updateView(Emulation &emulation, ScreenWindow *window, Statistics &stats)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QMetaObject::invokeMethod(&emulation, "showBulk", Qt::DirectConnection);
+    window->getImage();
+    stats.frameTime += timer.nsecsElapsed();
+
+    stats.scrolledLines += qAbs(window->scrollCount());
+    window->resetScrollCount();
+    stats.frames++;
+}
+
+static qint64 measureDecoding(const Workload &workload, int repeat)
+{
+    Utf8Decoder decoder;
+    QVector<uint> output;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < repeat; i++) {
+        for (const TtyRecordingReader::Frame &frame : workload.frames) {
+            decoder.decode(frame.data.constData(), frame.data.size(), output);
+        }
+    }
+    return timer.nsecsElapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("vtreplay"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Replays terminal output through Konsole's emulation and reports the throughput.")
+    );
+    parser.addHelpOption();
+    parser.addOptions({
+        {QStringLiteral("raw"),
+            QStringLiteral("The input is a plain byte stream rather than a recording.")},
+        {QStringLiteral("realtime"),
+            QStringLiteral("Keep to the timing of the recording instead of replaying as fast as possible.")},
+        {QStringLiteral("speed"),
+            QStringLiteral("Speed up (or slow down) the replay with --realtime by this factor."),
+            QStringLiteral("factor"), QStringLiteral("1")},
+        {QStringLiteral("repeat"),
+            QStringLiteral("Replay the input this many times."),
+            QStringLiteral("count"), QStringLiteral("1")},
+        {QStringLiteral("frame-bytes"),
+            QStringLiteral("Update the view after this many bytes when replaying as fast as possible."),
+            QStringLiteral("bytes"), QStringLiteral("65536")},
+        {{QStringLiteral("c"), QStringLiteral("columns")},
+            QStringLiteral("Width of the screen."),
+            QStringLiteral("columns"), QStringLiteral("80")},
+        {{QStringLiteral("l"), QStringLiteral("lines")},
+            QStringLiteral("Height of the screen."),
+            QStringLiteral("lines"), QStringLiteral("24")},
+        {QStringLiteral("history"),
+            QStringLiteral("Number of history lines to keep, -1 for unlimited."),
+            QStringLiteral("lines"), QStringLiteral("1000")},
+        {QStringLiteral("json"),
+            QStringLiteral("Print the results as a JSON object.")},
+    });
+    parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Recording or byte stream to replay."));
+    parser.process(app);
+
+    QTextStream out(stdout, QIODevice::WriteOnly);
+    QTextStream err(stderr, QIODevice::WriteOnly);
+
+    if (parser.positionalArguments().count() != 1) {
+        parser.showHelp(1);
+    }
+    const QString fileName = parser.positionalArguments().at(0);
+
+    bool ok = true;
+    bool valid = true;
+    const bool realtime = parser.isSet(QStringLiteral("realtime"));
+    const double speed = parser.value(QStringLiteral("speed")).toDouble(&ok);
+    valid = valid && ok && speed > 0;
+    const int repeat = parser.value(QStringLiteral("repeat")).toInt(&ok);
+    valid = valid && ok && repeat > 0;
+    const int frameBytes = parser.value(QStringLiteral("frame-bytes")).toInt(&ok);
+    valid = valid && ok && frameBytes > 0;
+    const int columns = parser.value(QStringLiteral("columns")).toInt(&ok);
+    valid = valid && ok && columns > 0;
+    const int lines = parser.value(QStringLiteral("lines")).toInt(&ok);
+    valid = valid && ok && lines > 0;
+    const int history = parser.value(QStringLiteral("history")).toInt(&ok);
+    valid = valid && ok;
+    if (!valid) {
+        err << QStringLiteral("Invalid option value.") << endl;
+        return 1;
+    }
+
+    Workload workload;
+    QString error;
+    if (!loadWorkload(fileName, parser.isSet(QStringLiteral("raw")), workload, error)) {
+        err << QStringLiteral("Could not read ") << fileName << QStringLiteral(": ") << error << endl;
+        return 1;
+    }
+    if (workload.frames.isEmpty()) {
+        err << fileName << QStringLiteral(" is empty.") << endl;
+        return 1;
+    }
+
+    Vt102Emulation emulation;
+    emulation.setCodec(QTextCodec::codecForName("UTF-8"));
+    emulation.setImageSize(lines, columns);
+    if (history < 0) {
+        emulation.setHistory(HistoryTypeFile());
+    } else if (history == 0) {
+        emulation.setHistory(HistoryTypeNone());
+    } else {
+        emulation.setHistory(CompactHistoryType(history));
+    }
+    ScreenWindow *window = emulation.createWindow();
+    window->setWindowLines(lines);
+    window->setTrackOutput(true);
+
+    // a view updates at most this often when keeping to the recorded timing
+    static const qint64 FRAME_INTERVAL = 16 * 1000 * 1000;
+
+    Statistics stats;
+    QElapsedTimer total;
+    QElapsedTimer timer;
+    total.start();
+    for (int i = 0; i < repeat; i++) {
+        const qint64 startTime = workload.frames.first().time;
+        const qint64 replayStart = total.nsecsElapsed();
+        qint64 pendingBytes = 0;
+        qint64 lastFrame = replayStart;
+
+        for (const TtyRecordingReader::Frame &frame : qAsConst(workload.frames)) {
+            if (realtime) {
+                // wait until the block is due according to the recording
+                const qint64 due = replayStart + static_cast<qint64>((frame.time - startTime) * 1000 / speed);
+                while (total.nsecsElapsed() < due) {
+                    QThread::usleep(static_cast<unsigned long>(qMin<qint64>(due - total.nsecsElapsed(), FRAME_INTERVAL) / 1000));
+                }
+            }
+
+            timer.start();
+            emulation.receiveData(frame.data.constData(), frame.data.size());
+            stats.emulationTime += timer.nsecsElapsed();
+            stats.bytes += frame.data.size();
+            pendingBytes += frame.data.size();
+
+            const bool frameDue = realtime ? total.nsecsElapsed() - lastFrame >= FRAME_INTERVAL
+                                           : pendingBytes >= frameBytes;
+            if (frameDue) {
+                updateView(emulation, window, stats);
+                pendingBytes = 0;
+                lastFrame = total.nsecsElapsed();
+            }
+        }
+        updateView(emulation, window, stats);
+    }
+    stats.totalTime = total.nsecsElapsed();
+
+    stats.decodeTime = measureDecoding(workload, repeat);
+
+    const double seconds = stats.totalTime / 1e9;
+    const double busySeconds = (stats.emulationTime + stats.frameTime) / 1e9;
+    const double megabytesPerSecond = stats.bytes / (1024.0 * 1024.0) / busySeconds;
+    const double linesPerSecond = stats.scrolledLines / busySeconds;
+    const qint64 parseTime = qMax<qint64>(0, stats.emulationTime - stats.decodeTime);
+
+    if (parser.isSet(QStringLiteral("json"))) {
+        out << QStringLiteral("{\"file\": \"%1\", ").arg(fileName)
+            << QStringLiteral("\"bytes\": %1, \"lines\": %2, \"frames\": %3, ")
+               .arg(stats.bytes).arg(stats.scrolledLines).arg(stats.frames)
+            << QStringLiteral("\"seconds\": %1, \"megabytesPerSecond\": %2, \"linesPerSecond\": %3, ")
+               .arg(seconds, 0, 'f', 6).arg(megabytesPerSecond, 0, 'f', 3).arg(linesPerSecond, 0, 'f', 1)
+            << QStringLiteral("\"stages\": {\"decode\": %1, \"parse\": %2, \"frame\": %3}}")
+               .arg(stats.decodeTime / 1e6, 0, 'f', 3).arg(parseTime / 1e6, 0, 'f', 3)
+               .arg(stats.frameTime / 1e6, 0, 'f', 3)
+            << endl;
+        return 0;
+    }
+
+    out << fileName << QStringLiteral(": ") << stats.bytes << QStringLiteral(" bytes, ")
+        << stats.scrolledLines << QStringLiteral(" lines, ") << stats.frames << QStringLiteral(" frames in ")
+        << QString::number(seconds, 'f', 3) << QStringLiteral(" s") << endl;
+    out << QStringLiteral("  throughput: ") << QString::number(megabytesPerSecond, 'f', 2) << QStringLiteral(" MB/s, ")
+        << QString::number(linesPerSecond, 'f', 0) << QStringLiteral(" lines/s") << endl;
+    out << QStringLiteral("  decode:     ") << QString::number(stats.decodeTime / 1e6, 'f', 2) << QStringLiteral(" ms") << endl;
+    out << QStringLiteral("  parse:      ") << QString::number(parseTime / 1e6, 'f', 2) << QStringLiteral(" ms") << endl;
+    out << QStringLiteral("  frame:      ") << QString::number(stats.frameTime / 1e6, 'f', 2) << QStringLiteral(" ms") << endl;
+
+    return 0;
+}